@@ -0,0 +1,496 @@
+// edna_bench.cpp
+//
+// Offline replay benchmark: feeds WAV files through the same
+// VAD -> Endpointer -> WhisperASR -> LlamaBrain -> CoquiTTS path as edna
+// (minus the microphone) and reports latency distributions, tokens/sec and
+// real-time factors, so builds and model choices can be compared on a fixed
+// corpus instead of by talking at the ReSpeaker.
+//
+//   edna_bench [options] <file.wav | directory> ...
+//
+// Utterances are processed one at a time. With --realtime the audio is fed
+// at 1x and the audio clock pauses while a turn runs (as the mic gate does
+// while Edna is speaking); otherwise it is fed as fast as the stages go.
+#include <fvad.h>
+
+#include "asr_whisper.hpp"
+#include "llm_llama.hpp"
+#include "tts_coqui.hpp"
+#include "text_util.hpp"
+#include "circular_buffer.hpp"
+#include "pcm_convert.hpp"
+#include "endpointer.hpp"
+#include "wav_io.hpp"
+#ifdef EDNA_HAVE_PIPER
+#include "piper_tts.hpp"
+#endif
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+struct Options {
+    std::vector<std::string> inputs;
+    bool realtime = false;
+    bool use_llm = true;
+    bool use_tts = true;
+    bool require_invocation = false;
+    int  repeat = 1;
+    std::string sink = "null";
+    std::string whisper_model;
+    std::string llama_model;
+    std::string draft_model;
+    std::string kv_type = "f16";
+    int n_ctx = 1024;
+    bool asr_full = false;
+    std::string piper_model;
+    std::string json_path;
+};
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: edna_bench [options] <file.wav | directory> ...\n"
+        "  --realtime            feed audio at 1x (default: as fast as possible)\n"
+        "  --sink DEV            TTS output: null (default), file:<out.wav> or an ALSA device\n"
+        "  --no-tts              stop after the LLM\n"
+        "  --no-llm              ASR only (implies --no-tts)\n"
+        "  --require-invocation  only transcripts that start with the wake word reach the LLM\n"
+        "  --repeat N            replay the corpus N times\n"
+        "  --whisper PATH        Whisper model (default: base.en under $EDNA_TOP_DIR)\n"
+        "  --llama PATH          LLM model (default: the edna model under $EDNA_TOP_DIR)\n"
+        "  --draft PATH          draft model for speculative decoding\n"
+        "  --kv-type T           LLM KV cache type: f16 (default), q8_0, q4_0\n"
+        "  --n-ctx N             LLM context size (default 1024)\n"
+        "  --asr-full            no silence trimming, full 30 s encoder window (baseline)\n"
+#ifdef EDNA_HAVE_PIPER
+        "  --piper PATH          synthesize in process with this Piper voice (.onnx)\n"
+#endif
+        "  --json PATH           also write the summary as JSON\n");
+}
+
+static bool parse_args(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const std::string a = argv[i];
+        auto value = [&](std::string& dst) {
+            if (i + 1 >= argc) return false;
+            dst = argv[++i];
+            return true;
+        };
+        if (a == "--realtime") o.realtime = true;
+        else if (a == "--no-tts") o.use_tts = false;
+        else if (a == "--no-llm") { o.use_llm = false; o.use_tts = false; }
+        else if (a == "--require-invocation") o.require_invocation = true;
+        else if (a == "--sink") { if (!value(o.sink)) return false; }
+        else if (a == "--whisper") { if (!value(o.whisper_model)) return false; }
+        else if (a == "--llama") { if (!value(o.llama_model)) return false; }
+        else if (a == "--draft") { if (!value(o.draft_model)) return false; }
+        else if (a == "--kv-type") { if (!value(o.kv_type)) return false; }
+        else if (a == "--asr-full") o.asr_full = true;
+        else if (a == "--n-ctx") {
+            std::string v;
+            if (!value(v)) return false;
+            o.n_ctx = std::max(256, std::atoi(v.c_str()));
+        }
+#ifdef EDNA_HAVE_PIPER
+        else if (a == "--piper") { if (!value(o.piper_model)) return false; }
+#endif
+        else if (a == "--json") { if (!value(o.json_path)) return false; }
+        else if (a == "--repeat") {
+            std::string v;
+            if (!value(v)) return false;
+            o.repeat = std::max(1, std::atoi(v.c_str()));
+        }
+        else if (a == "-h" || a == "--help") return false;
+        else if (!a.empty() && a[0] == '-') {
+            std::fprintf(stderr, "unknown option %s\n", a.c_str());
+            return false;
+        }
+        else o.inputs.push_back(a);
+    }
+    return !o.inputs.empty();
+}
+
+// Expand directories to their *.wav files (sorted, so runs are comparable).
+static std::vector<std::string> collect_wavs(const std::vector<std::string>& inputs) {
+    std::vector<std::string> out;
+    for (const auto& in : inputs) {
+        struct stat st{};
+        if (stat(in.c_str(), &st) != 0) {
+            std::fprintf(stderr, "[bench] skipping %s: not found\n", in.c_str());
+            continue;
+        }
+        if (!S_ISDIR(st.st_mode)) {
+            out.push_back(in);
+            continue;
+        }
+        std::vector<std::string> files;
+        if (DIR* d = opendir(in.c_str())) {
+            while (dirent* e = readdir(d)) {
+                const std::string name = e->d_name;
+                if (name.size() > 4 && name.compare(name.size() - 4, 4, ".wav") == 0) {
+                    files.push_back(in + "/" + name);
+                }
+            }
+            closedir(d);
+        }
+        std::sort(files.begin(), files.end());
+        out.insert(out.end(), files.begin(), files.end());
+    }
+    return out;
+}
+
+// A latency / rate distribution over all turns.
+struct Dist {
+    std::vector<double> v;
+
+    void add(double x) { v.push_back(x); }
+
+    double pct(double q) const {
+        if (v.empty()) return 0.0;
+        std::vector<double> s = v;
+        std::sort(s.begin(), s.end());
+        const size_t k = std::min(s.size() - 1, (size_t)(q * (double)(s.size() - 1) + 0.5));
+        return s[k];
+    }
+
+    double mean() const {
+        double acc = 0.0;
+        for (double x : v) acc += x;
+        return v.empty() ? 0.0 : acc / (double)v.size();
+    }
+};
+
+struct Report {
+    // Insertion order = print order.
+    std::vector<std::pair<std::string, Dist>> metrics;
+
+    Dist& operator[](const std::string& name) {
+        for (auto& m : metrics) {
+            if (m.first == name) return m.second;
+        }
+        metrics.emplace_back(name, Dist{});
+        return metrics.back().second;
+    }
+
+    int turns = 0;
+    int skipped = 0;          // blank transcript / no invocation
+    double audio_secs = 0.0;
+    double wall_secs = 0.0;
+};
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+
+    const char* top_env = std::getenv("EDNA_TOP_DIR");
+    const std::string TOP = top_env ? top_env : ".";
+    if (opt.whisper_model.empty())
+        opt.whisper_model = TOP + "/third_party/whisper.cpp/models/ggml-base.en.bin";
+    if (opt.llama_model.empty())
+        opt.llama_model = TOP + "/models/Qwen2.5-2B-Instruct.Q6_K.gguf";
+
+    const std::vector<std::string> files = collect_wavs(opt.inputs);
+    if (files.empty()) {
+        std::fprintf(stderr, "[bench] no WAV files to replay\n");
+        return 1;
+    }
+
+    const unsigned sr = 16000;
+    const int frame_ms = 20;
+    const int frame_samples = (int)(sr * frame_ms / 1000);
+    const int preroll_frames = 15;
+
+    /* ===================== Engines (same settings as edna) ===================== */
+    WhisperASR::Params asr_p;
+    asr_p.use_gpu = true;
+    asr_p.n_threads = 4;
+    asr_p.single_segment = true;
+    asr_p.no_context = true;
+    asr_p.language = "en";
+    if (opt.asr_full) asr_p.scale_audio_ctx = asr_p.scale_max_tokens = false;
+    WhisperASR asr(opt.whisper_model, asr_p);
+
+    std::unique_ptr<LlamaBrain> brain;
+    LlamaBrain::Params llm_p;
+    if (opt.use_llm) {
+        llm_p.n_gpu_layers = 999;
+        llm_p.n_ctx = opt.n_ctx;
+        llm_p.kv_type = opt.kv_type;
+        llm_p.n_threads = 4;
+        llm_p.n_batch = 256;
+        llm_p.max_new_tokens = 96;
+        llm_p.draft_model_path = opt.draft_model;
+        brain.reset(new LlamaBrain(opt.llama_model, llm_p));
+    }
+
+    std::unique_ptr<CoquiTTS> tts;
+    std::atomic<int64_t> first_audio_ns{0};   // first play_at of the current reply
+    if (opt.use_tts) {
+        CoquiTTS::Params tts_p;
+        tts_p.out_device = opt.sink;
+        std::unique_ptr<TtsEngine> engine;
+#ifdef EDNA_HAVE_PIPER
+        if (!opt.piper_model.empty()) {
+            PiperTTS::Params pp;
+            pp.model_path = opt.piper_model;
+            engine.reset(new PiperTTS(pp));
+        }
+#endif
+        tts.reset(new CoquiTTS(tts_p, std::move(engine)));
+        tts->set_playback_tap([&](const int16_t*, size_t, unsigned, unsigned, Clock::time_point play_at) {
+            int64_t expected = 0;
+            const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                play_at.time_since_epoch()).count();
+            first_audio_ns.compare_exchange_strong(expected, ns);
+        });
+        if (!tts->ensure_worker()) {
+            std::fprintf(stderr, "[bench] TTS unavailable (%s); continuing without it\n",
+                         tts->last_error().c_str());
+            tts.reset();
+        }
+    }
+
+    std::fprintf(stderr, "[bench] files=%zu repeat=%d realtime=%d llm=%d tts=%d sink=%s kernel=%s\n",
+                 files.size(), opt.repeat, opt.realtime ? 1 : 0, brain ? 1 : 0, tts ? 1 : 0,
+                 opt.sink.c_str(), pcm_s16_to_f32_kernel());
+
+    Report rep;
+    std::vector<float> pcmf;
+    const auto wall0 = Clock::now();
+
+    // One finished utterance through ASR -> LLM -> TTS. t_end is when the
+    // endpoint was decided; endpoint_ms is the silence it waited for.
+    // Same trimming as edna's ASR stage (trim_lead_ms / trim_trail_ms).
+    auto run_turn = [&](const std::vector<int16_t>& utt, const VoicedSpan& voiced,
+                        int endpoint_ms, Clock::time_point t_end) {
+        const double utt_ms = (double)utt.size() * 1000.0 / sr;
+        if (utt_ms < 200.0) return;
+
+        size_t b = 0, e = utt.size();
+        if (!opt.asr_full) voiced.bounds(utt.size(), 120 * 16, 200 * 16, b, e);
+        pcmf.resize(e - b);
+        pcm_s16_to_f32(utt.data() + b, pcmf.data(), e - b);
+
+        const auto a0 = Clock::now();
+        std::string txt = trim_ws(asr.transcribe_16k_mono_f32(pcmf.data(), pcmf.size()));
+        const auto a1 = Clock::now();
+        const double asr_ms = ms_since(a0, a1);
+        const WhisperASR::Stats ws = asr.last_stats();
+
+        rep["endpoint_ms"].add(endpoint_ms);
+        rep["asr_queue_ms"].add(ms_since(t_end, a0));
+        rep["asr_ms"].add(asr_ms);
+        rep["asr_rtf"].add(asr_ms / utt_ms);
+        rep["asr_trimmed_ms"].add(utt_ms - ws.audio_ms);
+        rep["asr_audio_ctx"].add(ws.audio_ctx);
+        if (ws.encode_ms > 0.0) rep["asr_encode_ms"].add(ws.encode_ms);
+
+        std::fprintf(stderr, "[bench] secs=%.2f decoded_secs=%.2f audio_ctx=%d asr_ms=%.0f encode_ms=%.1f text='%s'\n",
+                     utt_ms / 1000.0, ws.audio_ms / 1000.0, ws.audio_ctx, asr_ms, ws.encode_ms, txt.c_str());
+
+        std::string cmd = txt;
+        const bool invoked = strip_invocation(cmd);
+        cmd = trim_ws(cmd);
+        if (txt.size() < 2 || txt == "[BLANK_AUDIO]" || cmd.empty() ||
+            (opt.require_invocation && !invoked)) {
+            rep.skipped++;
+            return;
+        }
+        rep.turns++;
+        if (!brain) return;
+
+        first_audio_ns.store(0);
+        SentenceSplitter splitter;
+        std::vector<std::string> sentences;
+        bool have_token = false, have_sentence = false;
+        Clock::time_point t_token{}, t_sentence{};
+
+        auto hand_off = [&]() {
+            for (auto& s : sentences) {
+                if (!have_sentence) {
+                    have_sentence = true;
+                    t_sentence = Clock::now();
+                }
+                if (tts) tts->enqueue(s);
+            }
+            sentences.clear();
+        };
+
+        const auto l0 = Clock::now();
+        brain->reply_stream(cmd, [&](const std::string& piece) {
+            if (!have_token) {
+                have_token = true;
+                t_token = Clock::now();
+            }
+            splitter.feed(piece, sentences);
+            hand_off();
+        });
+        splitter.flush(sentences);
+        hand_off();
+        const auto l1 = Clock::now();
+
+        const LlamaBrain::Stats ls = brain->last_stats();
+        rep["llm_ms"].add(ms_since(l0, l1));
+        rep["prefill_tps"].add(ls.prefill_tps());
+        rep["gen_tps"].add(ls.gen_tps());
+        rep["gen_tokens"].add(ls.gen_tokens);
+        if (ls.draft_tokens > 0) rep["draft_accept"].add(ls.accept_rate());
+        if (have_token) {
+            rep["llm_ttft_ms"].add(ms_since(l0, t_token));
+            rep["e2e_first_token_ms"].add(endpoint_ms + ms_since(t_end, t_token));
+        }
+        if (have_sentence) rep["llm_first_sentence_ms"].add(ms_since(l0, t_sentence));
+
+        if (!tts || !have_sentence) return;
+        const bool ok = tts->wait_idle();
+        const auto t1 = Clock::now();
+        rep["tts_ms"].add(ms_since(t_sentence, t1));
+        const int64_t ns = first_audio_ns.load();
+        if (ok && ns) {
+            const Clock::time_point t_audio{std::chrono::nanoseconds(ns)};
+            rep["tts_first_audio_ms"].add(ms_since(t_sentence, t_audio));
+            rep["e2e_first_audio_ms"].add(endpoint_ms + ms_since(t_end, t_audio));
+        }
+    };
+
+    for (int r = 0; r < opt.repeat; r++) {
+        for (const auto& path : files) {
+            WavData wav;
+            std::string err;
+            if (!read_wav(path, wav, err)) {
+                std::fprintf(stderr, "[bench] %s\n", err.c_str());
+                continue;
+            }
+            const std::vector<int16_t> audio = wav_to_mono(wav, sr);
+            rep.audio_secs += (double)audio.size() / sr;
+            std::fprintf(stderr, "[bench] %s secs=%.2f rate=%u ch=%u\n",
+                         path.c_str(), wav.seconds(), wav.sample_rate, wav.channels);
+
+            // Each file is its own conversation.
+            if (brain) brain->reset_history();
+
+            Fvad* vad = fvad_new();
+            if (!vad || fvad_set_sample_rate(vad, sr) != 0) {
+                std::fprintf(stderr, "[bench] fvad init failed\n");
+                return 1;
+            }
+            fvad_set_mode(vad, 2);
+
+            Endpointer::Params ep_p;
+            ep_p.frame_ms = frame_ms;
+            Endpointer ep(ep_p);
+            CircularBuffer<int16_t> preroll((size_t)preroll_frames * frame_samples);
+            CircularBuffer<uint8_t> preroll_voiced((size_t)preroll_frames);
+            std::vector<int16_t> utt;
+            VoicedSpan voiced;
+            uint64_t utt_id = 0;
+            size_t utt_frames = 0;
+
+            auto next_frame = Clock::now();
+            for (size_t off = 0; off + (size_t)frame_samples <= audio.size(); off += (size_t)frame_samples) {
+                if (opt.realtime) {
+                    std::this_thread::sleep_until(next_frame);
+                    next_frame += std::chrono::milliseconds(frame_ms);
+                }
+                const int16_t* frame = audio.data() + off;
+                const int v = fvad_process(vad, frame, (size_t)frame_samples);
+
+                // Frame and verdict together, every frame (edna's update_preroll).
+                preroll.push(frame, (size_t)frame_samples);
+                const uint8_t pv = v > 0 ? 1 : 0;
+                preroll_voiced.push(&pv, 1);
+
+                const bool was_in_speech = ep.in_speech();
+                const Endpointer::Decision dec = ep.push(v, frame, (size_t)frame_samples);
+
+                if (!was_in_speech) {
+                    if (dec == Endpointer::Decision::Start) {
+                        ep.start(++utt_id);
+                        utt.resize(preroll.size());
+                        preroll.copy_out(0, utt.data(), preroll.size());
+                        voiced.reset();
+                        for (size_t k = 0; k < preroll_voiced.size(); k++) {
+                            uint8_t fv = 0;
+                            preroll_voiced.copy_out(k, &fv, 1);
+                            voiced.add(k * (size_t)frame_samples, (size_t)frame_samples, fv != 0);
+                        }
+                        utt_frames = 0;
+                    }
+                    continue;
+                }
+
+                voiced.add(utt.size(), (size_t)frame_samples, ep.voiced());
+                utt.insert(utt.end(), frame, frame + frame_samples);
+                utt_frames++;
+                if (dec == Endpointer::Decision::End) {
+                    run_turn(utt, voiced, ep.last_endpoint().trailing_ms, Clock::now());
+                    utt.clear();
+                    next_frame = Clock::now();   // audio clock paused during the turn
+                }
+            }
+            // File ended mid-utterance: decode what there is.
+            if (ep.in_speech() && utt_frames > 0) run_turn(utt, voiced, 0, Clock::now());
+
+            fvad_free(vad);
+        }
+    }
+    rep.wall_secs = ms_since(wall0, Clock::now()) / 1000.0;
+
+    /* ===================== Report ===================== */
+    std::printf("%-24s %6s %9s %9s %9s %9s %9s\n", "metric", "n", "mean", "p50", "p90", "p99", "max");
+    for (const auto& m : rep.metrics) {
+        const Dist& d = m.second;
+        std::printf("%-24s %6zu %9.1f %9.1f %9.1f %9.1f %9.1f\n", m.first.c_str(), d.v.size(),
+                    d.mean(), d.pct(0.50), d.pct(0.90), d.pct(0.99), d.pct(1.0));
+    }
+    const double rtf = rep.audio_secs > 0.0 ? rep.wall_secs / rep.audio_secs : 0.0;
+    std::printf("turns=%d skipped=%d audio_secs=%.1f wall_secs=%.1f rtf=%.3f\n",
+                rep.turns, rep.skipped, rep.audio_secs, rep.wall_secs, rtf);
+
+    if (!opt.json_path.empty()) {
+        std::FILE* f = std::fopen(opt.json_path.c_str(), "w");
+        if (!f) {
+            std::fprintf(stderr, "[bench] cannot write %s\n", opt.json_path.c_str());
+            return 1;
+        }
+        std::fprintf(f, "{\n  \"config\": {\"whisper\": \"%s\", \"llama\": \"%s\", \"draft\": \"%s\", \"realtime\": %s, "
+                        "\"llm\": %s, \"tts\": %s, \"asr_full\": %s, \"files\": %zu, \"repeat\": %d, \"kernel\": \"%s\"},\n",
+                     opt.whisper_model.c_str(), opt.llama_model.c_str(), opt.draft_model.c_str(), opt.realtime ? "true" : "false",
+                     brain ? "true" : "false", tts ? "true" : "false", opt.asr_full ? "true" : "false",
+                     files.size(), opt.repeat, pcm_s16_to_f32_kernel());
+        std::fprintf(f, "  \"turns\": %d, \"skipped\": %d, \"audio_secs\": %.3f, \"wall_secs\": %.3f, \"rtf\": %.4f,\n",
+                     rep.turns, rep.skipped, rep.audio_secs, rep.wall_secs, rtf);
+        std::fprintf(f, "  \"metrics\": {");
+        for (size_t i = 0; i < rep.metrics.size(); i++) {
+            const Dist& d = rep.metrics[i].second;
+            std::fprintf(f, "%s\n    \"%s\": {\"n\": %zu, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+                            "\"p99\": %.3f, \"max\": %.3f}",
+                         i ? "," : "", rep.metrics[i].first.c_str(), d.v.size(), d.mean(),
+                         d.pct(0.50), d.pct(0.90), d.pct(0.99), d.pct(1.0));
+        }
+        std::fprintf(f, "\n  }\n}\n");
+        std::fclose(f);
+    }
+    return 0;
+}
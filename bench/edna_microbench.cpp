@@ -0,0 +1,355 @@
+// edna_microbench.cpp
+//
+// Micro-benchmarks for the per-turn hot path: transcript cleanup and
+// invocation matching, sentence chunking of streamed LLM output, PCM
+// conversion and the per-frame capture helpers, detokenization, plus
+// isolated Whisper and llama.cpp round trips on fixed inputs.
+//
+//   edna_microbench [--filter substr] [--min-time seconds]
+//
+// Engine cases need models; they are skipped unless found at
+//   EDNA_BENCH_WHISPER / EDNA_BENCH_LLAMA, or the edna defaults under
+//   $EDNA_TOP_DIR.
+// EDNA_BENCH_WAV picks the clip for the Whisper case (default: 3 s of
+// synthetic audio, which only measures the encoder and a short decode).
+#include "microbench.hpp"
+
+#include "asr_whisper.hpp"
+#include "llm_llama.hpp"
+#include "llm_common.hpp"
+#include "text_util.hpp"
+#include "pcm_convert.hpp"
+#include "circular_buffer.hpp"
+#include "aec.hpp"
+#include "endpointer.hpp"
+#include "wav_io.hpp"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+static const std::string kTranscript = "  Hey, Edna! What's the weather going to be like in Boston tomorrow?  ";
+static const std::string kReply =
+    "Tomorrow in Boston expect a high of 18 degrees with light rain in the morning. "
+    "It should clear up by the afternoon, so an umbrella for the commute is enough. "
+    "Winds stay calm, around ten kilometers per hour.";
+
+// The reply as the LLM streams it: a few bytes per piece.
+static std::vector<std::string> reply_pieces() {
+    std::vector<std::string> out;
+    for (size_t i = 0; i < kReply.size(); i += 4) out.push_back(kReply.substr(i, 4));
+    return out;
+}
+
+static std::vector<int16_t> test_signal(size_t n, uint32_t seed = 1) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0.0f, 300.0f);
+    std::vector<int16_t> v(n);
+    for (size_t i = 0; i < n; i++) {
+        const float tone = 4000.0f * std::sin(2.0f * 3.14159265f * 220.0f * (float)i / 16000.0f);
+        v[i] = (int16_t)std::max(-32768.0f, std::min(32767.0f, tone + noise(rng)));
+    }
+    return v;
+}
+
+/* ===================== Text helpers ===================== */
+
+static void BM_trim_ws(mb::State& st) {
+    for (auto _ : st) mb::do_not_optimize(trim_ws(kTranscript));
+    st.set_items_processed(st.iterations());
+}
+MB_BENCH(BM_trim_ws);
+
+static void BM_normalize(mb::State& st) {
+    for (auto _ : st) mb::do_not_optimize(normalize(kTranscript));
+    st.set_items_processed(st.iterations());
+    st.set_bytes_processed(st.iterations() * (int64_t)kTranscript.size());
+}
+MB_BENCH(BM_normalize);
+
+static void BM_strip_invocation(mb::State& st) {
+    for (auto _ : st) {
+        std::string s = kTranscript;
+        mb::do_not_optimize(strip_invocation(s));
+        mb::do_not_optimize(s);
+    }
+    st.set_items_processed(st.iterations());
+}
+MB_BENCH(BM_strip_invocation);
+
+static void BM_has_invocation_miss(mb::State& st) {
+    // The common case: room chatter that never mentions Edna.
+    const std::string chatter = "so I told him we would be there around seven or so";
+    for (auto _ : st) mb::do_not_optimize(has_invocation(chatter));
+    st.set_items_processed(st.iterations());
+}
+MB_BENCH(BM_has_invocation_miss);
+
+static void BM_looks_complete(mb::State& st) {
+    for (auto _ : st) mb::do_not_optimize(looks_complete(kTranscript));
+    st.set_items_processed(st.iterations());
+}
+MB_BENCH(BM_looks_complete);
+
+static void BM_split_sentences(mb::State& st) {
+    for (auto _ : st) mb::do_not_optimize(split_sentences(kReply));
+    st.set_items_processed(st.iterations());
+    st.set_bytes_processed(st.iterations() * (int64_t)kReply.size());
+}
+MB_BENCH(BM_split_sentences);
+
+static void BM_SentenceSplitter_stream(mb::State& st) {
+    const std::vector<std::string> pieces = reply_pieces();
+    std::vector<std::string> out;
+    SentenceSplitter sp;
+    for (auto _ : st) {
+        sp.reset();
+        out.clear();
+        for (const auto& p : pieces) sp.feed(p, out);
+        sp.flush(out);
+        mb::do_not_optimize(out.data());
+    }
+    st.set_items_processed(st.iterations() * (int64_t)pieces.size());   // pieces/s
+    st.set_label("per reply");
+}
+MB_BENCH(BM_SentenceSplitter_stream);
+
+/* ===================== Audio helpers ===================== */
+
+static void BM_pcm_s16_to_f32_frame(mb::State& st) {
+    const std::vector<int16_t> in = test_signal(320);
+    std::vector<float> out(in.size());
+    for (auto _ : st) {
+        pcm_s16_to_f32(in.data(), out.data(), in.size());
+        mb::clobber_memory();
+    }
+    st.set_bytes_processed(st.iterations() * (int64_t)(in.size() * sizeof(int16_t)));
+    st.set_label(pcm_s16_to_f32_kernel());
+}
+MB_BENCH(BM_pcm_s16_to_f32_frame);
+
+static void BM_pcm_s16_to_f32_30s(mb::State& st) {
+    const std::vector<int16_t> in = test_signal(16000 * 30);
+    std::vector<float> out(in.size());
+    for (auto _ : st) {
+        pcm_s16_to_f32(in.data(), out.data(), in.size());
+        mb::clobber_memory();
+    }
+    st.set_bytes_processed(st.iterations() * (int64_t)(in.size() * sizeof(int16_t)));
+    st.set_label(pcm_s16_to_f32_kernel());
+}
+MB_BENCH(BM_pcm_s16_to_f32_30s);
+
+static void BM_CircularBuffer_utterance(mb::State& st) {
+    // ASR stage: convert 20 ms frames straight into the utterance ring.
+    const std::vector<int16_t> frame = test_signal(320);
+    CircularBuffer<float> audio(16000 * 30);
+    for (auto _ : st) {
+        audio.clear();
+        for (int i = 0; i < 250; i++) {   // 5 s utterance
+            audio.push_fill(frame.size(), [&](float* dst, size_t k, size_t at) {
+                pcm_s16_to_f32(frame.data() + at, dst, k);
+            });
+        }
+        mb::do_not_optimize(audio.linearize());
+    }
+    st.set_items_processed(st.iterations() * 250);   // frames/s
+}
+MB_BENCH(BM_CircularBuffer_utterance);
+
+static void BM_Endpointer_push(mb::State& st) {
+    const std::vector<int16_t> frame = test_signal(320);
+    Endpointer ep{Endpointer::Params{}};
+    int i = 0;
+    for (auto _ : st) {
+        // Alternate talk and silence so both paths run.
+        const int vad = ((i++ / 50) & 1) ? 0 : 1;
+        mb::do_not_optimize(ep.push(vad, frame.data(), frame.size()));
+    }
+    st.set_items_processed(st.iterations());
+}
+MB_BENCH(BM_Endpointer_push);
+
+static void BM_EchoCanceller_process(mb::State& st) {
+    // Reference playing, mic = attenuated echo: the adaptive filter runs.
+    EchoCanceller::Params p;
+    p.sample_rate = 16000;
+    EchoCanceller aec(p);
+    const std::vector<int16_t> ref = test_signal(16000, 2);
+    std::vector<int16_t> mic(320);
+    auto now = EchoCanceller::Clock::now();
+    aec.push_reference(ref.data(), ref.size(), 16000, 1, now);
+    size_t off = 0;
+    for (auto _ : st) {
+        st.pause_timing();
+        if (off + 320 > ref.size()) {
+            off = 0;
+            now = EchoCanceller::Clock::now();
+            aec.push_reference(ref.data(), ref.size(), 16000, 1, now);
+        }
+        for (size_t i = 0; i < 320; i++) mic[i] = (int16_t)(ref[off + i] / 2);
+        const auto at = now + std::chrono::microseconds((int64_t)off * 1000000 / 16000);
+        off += 320;
+        st.resume_timing();
+        aec.process(mic.data(), mic.size(), at);
+    }
+    st.set_items_processed(st.iterations());   // 20 ms frames/s
+}
+MB_BENCH(BM_EchoCanceller_process);
+
+/* ===================== Engines ===================== */
+
+static bool file_exists(const std::string& p) {
+    struct stat sb{};
+    return !p.empty() && stat(p.c_str(), &sb) == 0;
+}
+
+static std::string model_path(const char* env, const char* rel) {
+    if (const char* v = std::getenv(env)) return v;
+    const char* top = std::getenv("EDNA_TOP_DIR");
+    return top ? std::string(top) + rel : std::string();
+}
+
+// Engines are loaded once and reused across the harness's reruns.
+static WhisperASR* whisper() {
+    static std::unique_ptr<WhisperASR> asr;
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        const std::string path = model_path("EDNA_BENCH_WHISPER", "/third_party/whisper.cpp/models/ggml-base.en.bin");
+        if (file_exists(path)) {
+            WhisperASR::Params p;
+            p.n_threads = 4;
+            p.single_segment = true;
+            p.no_context = true;
+            asr.reset(new WhisperASR(path, p));
+        }
+    }
+    return asr.get();
+}
+
+static LlamaBrain* llama() {
+    static std::unique_ptr<LlamaBrain> brain;
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        const std::string path = model_path("EDNA_BENCH_LLAMA", "/models/Qwen2.5-2B-Instruct.Q6_K.gguf");
+        if (file_exists(path)) {
+            LlamaBrain::Params p;
+            p.n_gpu_layers = 999;
+            p.n_ctx = 1024;
+            p.n_threads = 4;
+            p.n_batch = 256;
+            p.max_new_tokens = 48;
+            p.keep_history = false;     // every iteration sees the same prompt
+            p.stop_on_newline = false;
+            brain.reset(new LlamaBrain(path, p));
+        }
+    }
+    return brain.get();
+}
+
+// Just the tokenizer of the edna model (vocab_only: no weights, no GPU).
+static const llama_vocab* llama_vocab_only() {
+    static llama_model* model = nullptr;
+    static bool tried = false;
+    if (!tried) {
+        tried = true;
+        const std::string path = model_path("EDNA_BENCH_LLAMA", "/models/Qwen2.5-2B-Instruct.Q6_K.gguf");
+        if (file_exists(path)) {
+            llm::backend_acquire();
+            llama_model_params mp = llama_model_default_params();
+            mp.vocab_only = true;
+            model = llama_model_load_from_file(path.c_str(), mp);
+        }
+    }
+    return model ? llama_model_get_vocab(model) : nullptr;
+}
+
+static void BM_WhisperASR_transcribe_s16(mb::State& st) {
+    WhisperASR* asr = whisper();
+    if (!asr) return st.skip("no whisper model (EDNA_BENCH_WHISPER)");
+
+    std::vector<int16_t> pcm;
+    if (const char* wav_path = std::getenv("EDNA_BENCH_WAV")) {
+        WavData wav;
+        std::string err;
+        if (!read_wav(wav_path, wav, err)) return st.skip(err);
+        pcm = wav_to_mono(wav, 16000);
+    } else {
+        pcm = test_signal(16000 * 3);
+    }
+
+    for (auto _ : st) mb::do_not_optimize(asr->transcribe_16k_mono_s16(pcm));
+    const double audio_s = (double)pcm.size() / 16000.0;
+    st.counter("audio_s", audio_s);
+    st.set_items_processed(st.iterations());
+}
+MB_BENCH(BM_WhisperASR_transcribe_s16);
+
+// Long prompt, prefill dominates (tokens/s of the batched path).
+static void BM_LlamaBrain_reply_prefill(mb::State& st) {
+    LlamaBrain* brain = llama();
+    if (!brain) return st.skip("no llama model (EDNA_BENCH_LLAMA)");
+
+    std::string prompt = "Summarize this in one sentence: ";
+    for (int i = 0; i < 8; i++) prompt += kReply + " ";
+    double tps = 0.0;
+    for (auto _ : st) {
+        mb::do_not_optimize(brain->reply(prompt));
+        tps = brain->last_stats().prefill_tps();
+    }
+    const LlamaBrain::Stats s = brain->last_stats();
+    st.counter("prompt_tok", s.prompt_tokens);
+    st.counter("prefill_tps", tps);
+    st.counter("ttft_ms", s.ttft_ms);
+}
+MB_BENCH(BM_LlamaBrain_reply_prefill);
+
+// Short prompt, the token-by-token decode loop (sampling + detokenize) dominates.
+static void BM_LlamaBrain_reply_decode(mb::State& st) {
+    LlamaBrain* brain = llama();
+    if (!brain) return st.skip("no llama model (EDNA_BENCH_LLAMA)");
+
+    double tps = 0.0;
+    for (auto _ : st) {
+        mb::do_not_optimize(brain->reply("Tell me about the history of Boston."));
+        tps = brain->last_stats().gen_tps();
+    }
+    const LlamaBrain::Stats s = brain->last_stats();
+    st.counter("gen_tok", s.gen_tokens);
+    st.counter("gen_tps", tps);
+}
+MB_BENCH(BM_LlamaBrain_reply_decode);
+
+// Detokenize on its own (the per-token step of the decode loop), over the
+// token ids of a fixed reply. One reused string, as in reply_stream().
+static void BM_token_to_piece(mb::State& st) {
+    const llama_vocab* vocab = llama_vocab_only();
+    if (!vocab) return st.skip("no llama model (EDNA_BENCH_LLAMA)");
+
+    const std::vector<llama_token> toks = llm::tokenize_prompt(vocab, kReply, /*add_special=*/false);
+    std::string piece;
+    size_t bytes = 0;
+    for (auto _ : st) {
+        for (llama_token t : toks) {
+            llm::token_to_piece(vocab, t, piece);
+            bytes += piece.size();
+        }
+        mb::do_not_optimize(bytes);
+    }
+    st.counter("tokens", (double)toks.size());
+    st.set_items_processed(st.iterations() * (int64_t)toks.size());   // tokens/s
+}
+MB_BENCH(BM_token_to_piece);
+
+int main(int argc, char** argv) {
+    return mb::run_all(argc, argv);
+}
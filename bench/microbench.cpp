@@ -0,0 +1,109 @@
+// microbench.cpp
+#include "microbench.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace mb {
+
+namespace {
+
+struct Case {
+    const char* name;
+    Fn fn;
+};
+
+std::vector<Case>& registry() {
+    static std::vector<Case> r;
+    return r;
+}
+
+// 1234567 -> "1.23M"
+std::string human(double v) {
+    char buf[32];
+    if (v >= 1e9)      std::snprintf(buf, sizeof(buf), "%.2fG", v / 1e9);
+    else if (v >= 1e6) std::snprintf(buf, sizeof(buf), "%.2fM", v / 1e6);
+    else if (v >= 1e3) std::snprintf(buf, sizeof(buf), "%.2fk", v / 1e3);
+    else               std::snprintf(buf, sizeof(buf), "%.2f", v);
+    return buf;
+}
+
+std::string per_op(double ns) {
+    char buf[32];
+    if (ns >= 1e9)      std::snprintf(buf, sizeof(buf), "%.3f s", ns / 1e9);
+    else if (ns >= 1e6) std::snprintf(buf, sizeof(buf), "%.3f ms", ns / 1e6);
+    else if (ns >= 1e3) std::snprintf(buf, sizeof(buf), "%.3f us", ns / 1e3);
+    else                std::snprintf(buf, sizeof(buf), "%.1f ns", ns);
+    return buf;
+}
+
+} // namespace
+
+int register_bench(const char* name, Fn fn) {
+    registry().push_back({name, fn});
+    return (int)registry().size();
+}
+
+int run_all(int argc, char** argv) {
+    std::string filter;
+    double min_time = 0.5;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc) {
+            min_time = std::max(0.001, std::atof(argv[++i]));
+        } else if (!std::strcmp(argv[i], "--list")) {
+            for (const Case& c : registry()) std::printf("%s\n", c.name);
+            return 0;
+        } else {
+            std::fprintf(stderr, "usage: %s [--filter substr] [--min-time seconds] [--list]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::printf("%-36s %14s %12s %12s  %s\n", "benchmark", "time/op", "iterations", "items/s", "extra");
+    for (const Case& c : registry()) {
+        if (!filter.empty() && !std::strstr(c.name, filter.c_str())) continue;
+
+        int64_t iters = 1;
+        while (true) {
+            State st(iters);
+            c.fn(st);
+            const double secs = std::chrono::duration<double>(st.elapsed_).count();
+
+            if (!st.skipped_.empty()) {
+                std::printf("%-36s %14s  (%s)\n", c.name, "skipped", st.skipped_.c_str());
+                break;
+            }
+
+            // Grow towards min_time, at most 10x per step (like gbench).
+            if (secs < min_time && iters < (int64_t)1e9) {
+                const double scale = secs > 0.0 ? min_time * 1.4 / secs : 10.0;
+                iters = std::max(iters + 1, (int64_t)((double)iters * std::min(10.0, scale)));
+                continue;
+            }
+
+            std::string extra = st.label_;
+            if (st.bytes_ > 0) {
+                extra += (extra.empty() ? "" : " ") + human((double)st.bytes_ / secs) + "B/s";
+            }
+            for (const auto& kv : st.counters_) {
+                char buf[64];
+                std::snprintf(buf, sizeof(buf), "%s%s=%.1f", extra.empty() ? "" : " ",
+                              kv.first.c_str(), kv.second);
+                extra += buf;
+            }
+            std::printf("%-36s %14s %12lld %12s  %s\n", c.name,
+                        per_op(secs * 1e9 / (double)iters).c_str(), (long long)iters,
+                        st.items_ > 0 ? human((double)st.items_ / secs).c_str() : "-",
+                        extra.c_str());
+            std::fflush(stdout);
+            break;
+        }
+    }
+    return 0;
+}
+
+} // namespace mb
@@ -0,0 +1,127 @@
+// microbench.hpp
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Minimal micro-benchmark harness, shaped like Google Benchmark so cases
+ * read the same and could move over unchanged:
+ *
+ *   static void BM_normalize(mb::State& st) {
+ *       for (auto _ : st) mb::do_not_optimize(normalize(text));
+ *       st.set_items_processed(st.iterations());
+ *   }
+ *   MB_BENCH(BM_normalize);
+ *
+ * Each case is rerun with a growing iteration count until one run takes at
+ * least --min-time; the last run is reported. Cases whose single iteration
+ * is already that long (engine round trips) run once. No dependencies, so
+ * it builds wherever edna does.
+ */
+namespace mb {
+
+class State {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Value {
+        Value() {}
+        ~Value() {}   // non-trivial: `for (auto _ : st)` does not warn
+    };
+
+    class Iterator {
+    public:
+        Iterator(State* s, int64_t left) : s_(s), left_(left) {}
+        bool operator!=(const Iterator&) {
+            if (left_ > 0) return true;
+            s_->stop_timer();
+            return false;
+        }
+        void operator++() { --left_; }
+        Value operator*() const { return Value(); }
+
+    private:
+        State* s_;
+        int64_t left_;
+    };
+
+    explicit State(int64_t iterations) : iters_(iterations) {}
+
+    Iterator begin() {
+        start_timer();
+        return Iterator(this, iters_);
+    }
+    Iterator end() { return Iterator(this, 0); }
+
+    int64_t iterations() const { return iters_; }
+
+    // Exclude setup done inside the loop from the measurement.
+    void pause_timing() { stop_timer(); }
+    void resume_timing() { start_timer(); }
+
+    void set_items_processed(int64_t n) { items_ = n; }
+    void set_bytes_processed(int64_t n) { bytes_ = n; }
+    void set_label(std::string l) { label_ = std::move(l); }
+
+    // Extra per-case figure printed next to the timing (e.g. tokens/sec).
+    void counter(const std::string& name, double v) { counters_.emplace_back(name, v); }
+
+    // Mark the case as not runnable here (missing model, ...).
+    void skip(std::string why) { skipped_ = std::move(why); }
+
+private:
+    friend int run_all(int argc, char** argv);
+
+    void start_timer() {
+        if (!running_) {
+            running_ = true;
+            t0_ = Clock::now();
+        }
+    }
+    void stop_timer() {
+        if (running_) {
+            running_ = false;
+            elapsed_ += Clock::now() - t0_;
+        }
+    }
+
+    int64_t iters_;
+    int64_t items_ = 0;
+    int64_t bytes_ = 0;
+    std::string label_;
+    std::string skipped_;
+    std::vector<std::pair<std::string, double>> counters_;
+    bool running_ = false;
+    Clock::time_point t0_{};
+    Clock::duration elapsed_{};
+};
+
+using Fn = void (*)(State&);
+
+// Registration happens from static initializers (MB_BENCH).
+int register_bench(const char* name, Fn fn);
+
+// Runs every registered case whose name contains --filter <substr>.
+// --min-time <seconds> (default 0.5) sets the per-case time budget.
+int run_all(int argc, char** argv);
+
+// Keep the compiler from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(T const& v) {
+    asm volatile("" : : "r,m"(v) : "memory");
+}
+
+inline void clobber_memory() {
+    asm volatile("" : : : "memory");
+}
+
+} // namespace mb
+
+#define MB_CONCAT_(a, b) a##b
+#define MB_CONCAT(a, b) MB_CONCAT_(a, b)
+#define MB_BENCH(fn) \
+    static const int MB_CONCAT(mb_registered_, fn) = ::mb::register_bench(#fn, fn)
@@ -0,0 +1,231 @@
+// aec.cpp
+#include "aec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+struct EchoCanceller::Impl {
+    Params p{};
+    size_t taps = 0;
+    int64_t extra_delay = 0;          // samples
+
+    // --- Reference timeline (ref_m_) ---
+    // ring holds reference samples by absolute index; ref_end is the index
+    // of the next sample to be written and ref_end_t the time it plays.
+    std::vector<float> ring;
+    size_t mask = 0;
+    int64_t ref_end = 0;
+    Clock::time_point ref_end_t{};
+    bool ref_valid = false;
+
+    // Scratch for push_reference (only ever called from the playback thread).
+    std::vector<float> mono, out;
+
+    // Linear resampler state (input rate -> p.sample_rate).
+    unsigned rs_rate = 0;
+    double rs_pos = 0.0;              // read position relative to the next input sample
+    float rs_prev = 0.0f;             // last input sample of the previous chunk
+
+    // --- Filter state (capture thread) ---
+    std::vector<float> w;             // taps, w[0] = most recent reference sample
+    std::vector<float> x;             // reference window for one frame
+    int dtd_hold = 0;                 // samples left with adaptation frozen
+    double pd = 0.0, pe = 0.0;        // near / residual power for ERLE
+
+    Stats stats{};
+
+    void write_ref(const float* v, size_t n);
+    void fill_zeros(int64_t n);
+};
+
+EchoCanceller::EchoCanceller(const Params& p) : impl_(new Impl) {
+    Impl& im = *impl_;
+    im.p = p;
+    im.taps = (size_t)std::max(1, p.filter_ms) * p.sample_rate / 1000;
+    im.extra_delay = (int64_t)p.extra_delay_ms * p.sample_rate / 1000;
+
+    size_t cap = 1;
+    const size_t want = (size_t)std::max(p.ref_history_ms, p.filter_ms * 2) * p.sample_rate / 1000;
+    while (cap < want) cap <<= 1;
+    im.ring.assign(cap, 0.0f);
+    im.mask = cap - 1;
+
+    im.w.assign(im.taps, 0.0f);
+
+    std::fprintf(stderr, "[aec] taps=%zu (%d ms) mu=%.2f extra_delay_ms=%d\n",
+                 im.taps, p.filter_ms, p.mu, p.extra_delay_ms);
+}
+
+EchoCanceller::~EchoCanceller() {
+    delete impl_;
+    impl_ = nullptr;
+}
+
+void EchoCanceller::Impl::write_ref(const float* v, size_t n) {
+    for (size_t i = 0; i < n; i++) ring[(size_t)(ref_end + (int64_t)i) & mask] = v[i];
+    ref_end += (int64_t)n;
+}
+
+void EchoCanceller::Impl::fill_zeros(int64_t n) {
+    // Past one ring length the contents are all zero anyway.
+    const int64_t z = std::min<int64_t>(n, (int64_t)ring.size());
+    for (int64_t i = 0; i < z; i++) ring[(size_t)(ref_end + (n - z) + i) & mask] = 0.0f;
+    ref_end += n;
+}
+
+void EchoCanceller::push_reference(const int16_t* pcm, size_t frames, unsigned sample_rate,
+                                   unsigned channels, Clock::time_point play_at) {
+    if (!impl_ || !pcm || frames == 0 || sample_rate == 0 || channels == 0) return;
+    Impl& im = *impl_;
+    const double sr = (double)im.p.sample_rate;
+
+    // Downmix outside the lock; resampling needs the shared resampler state.
+    const double step = (double)sample_rate / sr;
+    std::vector<float>& mono = im.mono;
+    std::vector<float>& out = im.out;
+    mono.resize(frames);
+    for (size_t i = 0; i < frames; i++) {
+        int acc = 0;
+        for (unsigned c = 0; c < channels; c++) acc += pcm[i * channels + c];
+        mono[i] = (float)acc / (32768.0f * (float)channels);
+    }
+
+    std::lock_guard<std::mutex> lk(ref_m_);
+
+    // Re-anchor on the first chunk, after a gap, or on a rate change; small
+    // jitter between consecutive chunks of one burst is ignored.
+    const auto gap = play_at - im.ref_end_t;
+    const bool discontinuous = !im.ref_valid || im.rs_rate != sample_rate ||
+                               gap > std::chrono::milliseconds(20) ||
+                               gap < std::chrono::milliseconds(-200);
+    if (discontinuous) {
+        const double gap_s = std::chrono::duration<double>(gap).count();
+        if (im.ref_valid && gap_s > 0.0) im.fill_zeros((int64_t)(gap_s * sr));
+        im.ref_end_t = play_at;
+        im.rs_rate = sample_rate;
+        im.rs_pos = 0.0;
+        im.rs_prev = mono[0];
+        im.ref_valid = true;
+    }
+
+    out.clear();
+    double pos = im.rs_pos;
+    while (pos < (double)frames - 1.0) {
+        const double fl = std::floor(pos);
+        const float frac = (float)(pos - fl);
+        const long i0 = (long)fl;
+        const float a = i0 < 0 ? im.rs_prev : mono[(size_t)i0];
+        const float b = mono[(size_t)(i0 + 1)];
+        out.push_back(a + (b - a) * frac);
+        pos += step;
+    }
+    im.rs_pos = pos - (double)frames;
+    im.rs_prev = mono[frames - 1];
+
+    im.write_ref(out.data(), out.size());
+    im.ref_end_t += std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>((double)frames / (double)sample_rate));
+}
+
+void EchoCanceller::process(int16_t* frame, size_t n, Clock::time_point captured_at) {
+    if (!impl_ || !frame || n == 0) return;
+    Impl& im = *impl_;
+    im.stats.frames++;
+
+    const size_t L = im.taps;
+    const size_t span = L - 1 + n;   // x[k] = reference for time (frame start - (L-1) + k)
+
+    // Copy the aligned reference window out of the timeline.
+    bool active = false;
+    {
+        std::lock_guard<std::mutex> lk(ref_m_);
+        if (!im.ref_valid) return;
+
+        const double behind_s = std::chrono::duration<double>(im.ref_end_t - captured_at).count();
+        const int64_t start = im.ref_end - (int64_t)std::llround(behind_s * im.p.sample_rate)
+                              - im.extra_delay - (int64_t)(L - 1);
+        const int64_t end = start + (int64_t)span;
+        const int64_t oldest = im.ref_end - (int64_t)im.ring.size();
+
+        // Entirely after the last reference sample: playback has stopped.
+        if (start >= im.ref_end) return;
+
+        im.x.resize(span);
+        for (size_t k = 0; k < span; k++) {
+            const int64_t idx = start + (int64_t)k;
+            im.x[k] = (idx >= oldest && idx < im.ref_end) ? im.ring[(size_t)idx & im.mask] : 0.0f;
+        }
+        active = end > oldest;
+    }
+    if (!active) return;
+
+    float xmax = 0.0f;
+    double xe = 0.0;                                  // energy of the current tap window
+    for (size_t k = 0; k < L; k++) {
+        xe += (double)im.x[k] * im.x[k];
+        xmax = std::max(xmax, std::fabs(im.x[k]));
+    }
+    if (xmax < 1e-4f) {
+        // Silence in the reference: nothing to cancel, nothing to learn.
+        return;
+    }
+    im.stats.active_frames++;
+
+    const float mu = im.p.mu;
+    const int hold = im.p.dtd_hold_ms * (int)im.p.sample_rate / 1000;
+    const float eps = 1e-6f * (float)L;
+    double pd = 0.0, pe = 0.0;
+    bool froze = false;
+
+    for (size_t i = 0; i < n; i++) {
+        // Tap window for output sample i: newest reference sample first.
+        const float* xi = im.x.data() + i;            // xi[L-1] is the newest
+        if (i > 0) {
+            const float in = xi[L - 1], outv = xi[-1];
+            xe += (double)in * in - (double)outv * outv;
+            xmax = std::max(xmax, std::fabs(in));
+        }
+
+        float y = 0.0f;
+        for (size_t k = 0; k < L; k++) y += im.w[k] * xi[L - 1 - k];
+
+        const float d = (float)frame[i] / 32768.0f;
+        const float e = d - y;
+
+        // Geigel double-talk detector.
+        if (std::fabs(d) > im.p.dtd_threshold * xmax) im.dtd_hold = hold;
+        if (im.dtd_hold > 0) {
+            im.dtd_hold--;
+            froze = true;
+        } else {
+            const float g = mu * e / ((float)std::max(0.0, xe) + eps);
+            for (size_t k = 0; k < L; k++) im.w[k] += g * xi[L - 1 - k];
+        }
+
+        pd += (double)d * d;
+        pe += (double)e * e;
+        const float s = std::clamp(e * 32768.0f, -32768.0f, 32767.0f);
+        frame[i] = (int16_t)std::lrint(s);
+    }
+
+    if (froze) im.stats.dtd_frames++;
+    im.pd = 0.95 * im.pd + 0.05 * pd;
+    im.pe = 0.95 * im.pe + 0.05 * pe;
+    if (im.pe > 0.0 && im.pd > 0.0) im.stats.erle_db = 10.0 * std::log10(im.pd / im.pe);
+}
+
+void EchoCanceller::reset() {
+    if (!impl_) return;
+    std::fill(impl_->w.begin(), impl_->w.end(), 0.0f);
+    impl_->dtd_hold = 0;
+    impl_->pd = impl_->pe = 0.0;
+    std::lock_guard<std::mutex> lk(ref_m_);
+    impl_->ref_valid = false;
+}
+
+EchoCanceller::Stats EchoCanceller::stats() const {
+    if (!impl_) return Stats{};
+    return impl_->stats;
+}
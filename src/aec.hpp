@@ -0,0 +1,77 @@
+// aec.hpp
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+ * EchoCanceller
+ *
+ * Acoustic echo cancellation for the capture path: whatever the TTS plays
+ * goes in as the far-end reference (push_reference, from the playback
+ * thread), and each 16 kHz capture frame has the estimated echo subtracted
+ * in place (process, from the capture thread) before VAD and Whisper see it.
+ *
+ * Time-domain NLMS adaptive filter over filter_ms of echo tail, aligned by
+ * timestamps: the playback side reports when each chunk reaches the
+ * speaker, the capture side when each frame left the microphone, so the
+ * bulk device latency does not have to be covered by filter taps. A Geigel
+ * detector freezes adaptation while the user talks over playback
+ * (double-talk), which is what keeps barge-in speech from being cancelled.
+ *
+ * Work is skipped entirely when there is no recent reference, so idle
+ * listening costs nothing. At 16 kHz with 64 ms of taps this is ~33 M
+ * multiply-adds per second of playback: well within one core.
+ */
+class EchoCanceller {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Params {
+        unsigned sample_rate = 16000;   // capture rate; reference is resampled to it
+        int   filter_ms      = 64;      // echo tail modeled by the filter
+        int   extra_delay_ms = 10;      // acoustic path + converter latency not in the timestamps
+        float mu             = 0.3f;    // NLMS step size (0..1)
+        float dtd_threshold  = 0.6f;    // Geigel: near |d| > thr * max|x| => double-talk
+        int   dtd_hold_ms    = 60;      // keep adaptation frozen this long after double-talk
+        int   ref_history_ms = 2000;    // reference kept for late capture frames
+    };
+
+    struct Stats {
+        uint64_t frames         = 0;    // process() calls
+        uint64_t active_frames  = 0;    // frames with reference present
+        uint64_t dtd_frames     = 0;    // active frames with adaptation frozen
+        double   erle_db        = 0.0;  // smoothed echo return loss enhancement
+    };
+
+    explicit EchoCanceller(const Params& p);
+    ~EchoCanceller();
+
+    EchoCanceller(const EchoCanceller&) = delete;
+    EchoCanceller& operator=(const EchoCanceller&) = delete;
+
+    // Far-end audio as written to the speaker. Any rate / channel count;
+    // downmixed and resampled to sample_rate. play_at = when frame 0 plays.
+    void push_reference(const int16_t* pcm, size_t frames, unsigned sample_rate,
+                        unsigned channels, Clock::time_point play_at);
+
+    // Cancel echo from one mono capture frame in place. captured_at = when
+    // sample 0 of the frame hit the microphone.
+    void process(int16_t* frame, size_t n, Clock::time_point captured_at);
+
+    // Forget the adapted filter (e.g. after the output device changed).
+    void reset();
+
+    // Capture thread only (same thread as process()).
+    Stats stats() const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+
+    // Guards the reference timeline only; filter state belongs to the
+    // capture thread.
+    mutable std::mutex ref_m_;
+};
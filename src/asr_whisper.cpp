@@ -1,16 +1,23 @@
 #include "asr_whisper.hpp"
+#include "pcm_convert.hpp"
+#include "gpu_arbiter.hpp"
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <cctype>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <mutex>
 #include <string>
 #include <vector>
 
 extern "C" {
 // Forward-declare opaque types so we don't need whisper.h at link time.
 struct whisper_context;
+struct whisper_state;
 
 // Minimal struct layout is ABI-sensitive, so we do NOT re-declare structs here.
 // Instead we only traffic in pointers and plain-old-data returned by functions.
@@ -44,6 +51,24 @@ struct WhisperApi {
     int (*full)(whisper_context*, whisper_full_params, const float*, int);
     int (*full_n_segments)(whisper_context*);
     const char* (*full_get_segment_text)(whisper_context*, int);
+    int64_t (*full_get_segment_t1)(whisper_context*, int);
+
+    // Optional (not in every libwhisper): per-context encode/decode timings.
+    whisper_timings* (*get_timings)(whisper_context*) = nullptr;
+    void (*reset_timings)(whisper_context*) = nullptr;
+
+    // Optional: shared model + per-decoder state (WhisperPool).
+    whisper_context* (*init_no_state)(const char*, whisper_context_params) = nullptr;
+    whisper_state* (*init_state)(whisper_context*) = nullptr;
+    void (*free_state)(whisper_state*) = nullptr;
+    int (*full_with_state)(whisper_context*, whisper_state*, whisper_full_params, const float*, int) = nullptr;
+    int (*full_n_segments_from_state)(whisper_state*) = nullptr;
+    const char* (*full_get_segment_text_from_state)(whisper_state*, int) = nullptr;
+
+    bool has_state_api() const {
+        return init_no_state && init_state && free_state && full_with_state &&
+               full_n_segments_from_state && full_get_segment_text_from_state;
+    }
 
     bool loaded() const {
         return handle &&
@@ -53,7 +78,8 @@ struct WhisperApi {
                full_default_params &&
                full &&
                full_n_segments &&
-               full_get_segment_text;
+               full_get_segment_text &&
+               full_get_segment_t1;
     }
 };
 
@@ -95,6 +121,26 @@ static WhisperApi load_whisper_api() {
         (int (*)(whisper_context*)) must_sym(api.handle, "whisper_full_n_segments");
     api.full_get_segment_text =
         (const char* (*)(whisper_context*, int)) must_sym(api.handle, "whisper_full_get_segment_text");
+    api.full_get_segment_t1 =
+        (int64_t (*)(whisper_context*, int)) must_sym(api.handle, "whisper_full_get_segment_t1");
+
+    api.get_timings =
+        (whisper_timings* (*)(whisper_context*)) dlsym(api.handle, "whisper_get_timings");
+    api.reset_timings =
+        (void (*)(whisper_context*)) dlsym(api.handle, "whisper_reset_timings");
+
+    api.init_no_state =
+        (whisper_context* (*)(const char*, whisper_context_params)) dlsym(api.handle, "whisper_init_from_file_with_params_no_state");
+    api.init_state =
+        (whisper_state* (*)(whisper_context*)) dlsym(api.handle, "whisper_init_state");
+    api.free_state =
+        (void (*)(whisper_state*)) dlsym(api.handle, "whisper_free_state");
+    api.full_with_state =
+        (int (*)(whisper_context*, whisper_state*, whisper_full_params, const float*, int)) dlsym(api.handle, "whisper_full_with_state");
+    api.full_n_segments_from_state =
+        (int (*)(whisper_state*)) dlsym(api.handle, "whisper_full_n_segments_from_state");
+    api.full_get_segment_text_from_state =
+        (const char* (*)(whisper_state*, int)) dlsym(api.handle, "whisper_full_get_segment_text_from_state");
 
     if (!api.loaded()) {
         std::fprintf(stderr, "WhisperASR: failed to load whisper API\n");
@@ -106,13 +152,68 @@ static WhisperApi load_whisper_api() {
 
 // ------------------------------------------------------------
 
+namespace {
+struct Segment {
+    std::string text;
+    size_t end_sample = 0;   // relative to the decoded window
+};
+} // namespace
+
 struct WhisperASR::Impl {
     WhisperApi api{};
     whisper_context* ctx = nullptr;
+    whisper_context* fast_ctx = nullptr;   // Params::fast_model_path
+    bool use_fast = false;                 // set per call by the entry points
+    bool prefer_fast = false;
     Params p{};
+    Stats stats{};
     std::string language_stable;
+
+    // Streaming state for the current utterance.
+    std::string s_committed;
+    size_t s_commit_sample = 0;      // audio before this is already committed
+    std::vector<Segment> s_prev;     // previous hypothesis for the same window start
+    Partial s_last;
+
+    // Float staging for the int16 entry points; grows to the longest
+    // utterance seen and is then reused.
+    std::vector<float> pcmf;
+    std::vector<Segment> segs;
+
+    // Shared GPU scheduling; the class is set by each public entry point.
+    GpuArbiter* gpu = nullptr;
+    GpuArbiter::Class gpu_class = GpuArbiter::Class::AsrFinal;
+
+    // Converts pcm16[from, n) into pcmf at the same offsets; samples before
+    // `from` are left stale (callers only read the window after them).
+    const float* to_f32(const int16_t* pcm16, size_t n, size_t from = 0);
+
+    void pick_model_for_final();
+    bool run(const float* pcm, size_t n, bool single_segment,
+             const std::string& prompt, std::vector<Segment>& segs,
+             int audio_ctx = 0, int max_tokens = 0);
 };
 
+static std::string join_segments(const std::vector<Segment>& segs,
+                                 size_t from, size_t to) {
+    std::string out;
+    for (size_t i = from; i < to && i < segs.size(); i++) {
+        if (!out.empty()) out += " ";
+        out += segs[i].text;
+    }
+    return out;
+}
+
+// Whisper drifts less if the tail of what's already committed is passed
+// back as the prompt.
+static std::string prompt_tail(const std::string& committed) {
+    const size_t max_chars = 200;
+    if (committed.size() <= max_chars) return committed;
+    size_t cut = committed.find(' ', committed.size() - max_chars);
+    if (cut == std::string::npos) cut = committed.size() - max_chars;
+    return committed.substr(cut + 1);
+}
+
 WhisperASR::WhisperASR(const std::string& model_path, const Params& p)
     : impl_(new Impl) {
     impl_->p = p;
@@ -122,17 +223,34 @@ WhisperASR::WhisperASR(const std::string& model_path, const Params& p)
 
     whisper_context_params wp = impl_->api.context_default_params();
     wp.use_gpu = p.use_gpu;
+    wp.gpu_device = p.gpu_device;
+    if (p.use_gpu && p.gpu_arbitrate) impl_->gpu = &GpuArbiter::for_device(p.gpu_device);
 
     impl_->ctx = impl_->api.init_from_file_with_params(model_path.c_str(), wp);
     if (!impl_->ctx) {
         std::fprintf(stderr, "WhisperASR: failed to init model: %s\n", model_path.c_str());
         std::exit(1);
     }
+
+    if (!p.fast_model_path.empty()) {
+        impl_->fast_ctx = impl_->api.init_from_file_with_params(p.fast_model_path.c_str(), wp);
+        if (!impl_->fast_ctx) {
+            std::fprintf(stderr, "[asr] fast model %s failed to load; using the main model only\n",
+                         p.fast_model_path.c_str());
+        } else {
+            std::fprintf(stderr, "[asr] fast model %s (final decodes under load)\n",
+                         p.fast_model_path.c_str());
+        }
+    }
 }
 
 WhisperASR::~WhisperASR() {
     if (!impl_) return;
 
+    if (impl_->fast_ctx) {
+        impl_->api.free_ctx(impl_->fast_ctx);
+        impl_->fast_ctx = nullptr;
+    }
     if (impl_->ctx) {
         impl_->api.free_ctx(impl_->ctx);
         impl_->ctx = nullptr;
@@ -147,17 +265,9 @@ WhisperASR::~WhisperASR() {
     impl_ = nullptr;
 }
 
-std::string WhisperASR::transcribe_16k_mono_s16(const std::vector<int16_t>& pcm16) {
-    if (!impl_ || !impl_->ctx) return "";
-    if (pcm16.empty()) return "";
-
-    std::vector<float> pcmf;
-    pcmf.reserve(pcm16.size());
-    for (int16_t s : pcm16) {
-        pcmf.push_back((float) s / 32768.0f);
-    }
-
-    whisper_full_params fp = impl_->api.full_default_params(WHISPER_SAMPLING_GREEDY);
+static whisper_full_params base_params(const WhisperApi& api, const WhisperASR::Params& p,
+                                       const std::string& language) {
+    whisper_full_params fp = api.full_default_params(WHISPER_SAMPLING_GREEDY);
 
     fp.print_realtime   = false;
     fp.print_progress   = false;
@@ -165,28 +275,388 @@ std::string WhisperASR::transcribe_16k_mono_s16(const std::vector<int16_t>& pcm1
     fp.print_special    = false;
 
     fp.translate      = false;
-    fp.no_context     = impl_->p.no_context;
-    fp.single_segment = impl_->p.single_segment;
-    fp.n_threads      = impl_->p.n_threads;
+    fp.no_context     = p.no_context;
+    fp.single_segment = p.single_segment;
+    fp.n_threads      = p.n_threads;
 
-    if (!impl_->language_stable.empty()) {
-        fp.language = impl_->language_stable.c_str();
+    if (!language.empty()) {
+        fp.language = language.c_str();
     } else {
         fp.language = nullptr;
     }
+    return fp;
+}
 
-    const int rc = impl_->api.full(impl_->ctx, fp, pcmf.data(), (int)pcmf.size());
-    if (rc != 0) return "";
+// Length-aware decode (Params::scale_audio_ctx / scale_max_tokens) for n
+// samples; explicit audio_ctx / max_tokens > 0 win.
+static void apply_length_profile(const WhisperASR::Params& p, whisper_full_params& fp, size_t n,
+                                 int audio_ctx, int max_tokens) {
+    const double secs = (double)n / 16000.0;
+    if (audio_ctx <= 0 && p.scale_audio_ctx) {
+        // One encoder frame per 20 ms (320 samples), rounded up to 32.
+        const int need = (int)((n + 319) / 320) + p.audio_ctx_slack;
+        audio_ctx = std::min(1500, std::max(p.audio_ctx_min, (need + 31) / 32 * 32));
+    }
+    if (audio_ctx > 0) fp.audio_ctx = audio_ctx;
+    if (max_tokens > 0) {
+        fp.max_tokens = max_tokens;
+        fp.no_timestamps = true;
+    } else if (fp.single_segment && p.scale_max_tokens) {
+        fp.max_tokens = p.min_tokens + (int)(p.tokens_per_sec * secs);
+    }
+}
 
-    std::string out;
-    const int nseg = impl_->api.full_n_segments(impl_->ctx);
+const float* WhisperASR::Impl::to_f32(const int16_t* pcm16, size_t n, size_t from) {
+    if (pcmf.size() < n) pcmf.resize(n);
+    if (from < n) pcm_s16_to_f32(pcm16 + from, pcmf.data() + from, n - from);
+    return pcmf.data();
+}
+
+bool WhisperASR::Impl::run(const float* pcm, size_t n, bool single_segment,
+                           const std::string& prompt, std::vector<Segment>& segs,
+                           int audio_ctx, int max_tokens) {
+    segs.clear();
+
+    whisper_context* const c = (use_fast && fast_ctx) ? fast_ctx : ctx;
+    const double secs = (double)n / 16000.0;
+
+    whisper_full_params fp = base_params(api, p, language_stable);
+    fp.single_segment = single_segment;
+    if (!prompt.empty()) fp.initial_prompt = prompt.c_str();
+    apply_length_profile(p, fp, n, audio_ctx, max_tokens);
+
+    const auto t0 = std::chrono::steady_clock::now();
+    int rc;
+    {
+        GpuArbiter::Lease lease = gpu_lease(gpu, gpu_class);
+        if (api.reset_timings) api.reset_timings(c);
+        rc = api.full(c, fp, pcm, (int)n);
+    }
+    stats = Stats{};
+    stats.audio_ms = secs * 1000.0;
+    stats.audio_ctx = fp.audio_ctx > 0 ? fp.audio_ctx : 1500;
+    stats.max_tokens = fp.max_tokens;
+    stats.total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    stats.fast_model = c == fast_ctx;
+    if (api.get_timings) {
+        if (const whisper_timings* t = api.get_timings(c)) {
+            stats.encode_ms = t->encode_ms;
+            stats.decode_ms = t->decode_ms + t->batchd_ms + t->prompt_ms;
+        }
+    }
+    if (rc != 0) return false;
+
+    const int nseg = api.full_n_segments(c);
     for (int i = 0; i < nseg; i++) {
-        const char* t = impl_->api.full_get_segment_text(impl_->ctx, i);
-        if (t) out += t;
+        const char* t = api.full_get_segment_text(c, i);
+        std::string txt = trim_ws(t ? t : "");
+        if (txt.empty() || txt == "[BLANK_AUDIO]") continue;
+
+        // t1 is in 10 ms units. 16 kHz -> 160 samples each.
+        const int64_t t1 = api.full_get_segment_t1(c, i);
+        Segment seg;
+        seg.text = std::move(txt);
+        seg.end_sample = (size_t)std::max<int64_t>(0, t1) * 160;
+        segs.push_back(std::move(seg));
     }
+    return true;
+}
+
+std::string WhisperASR::transcribe_16k_mono_s16(const std::vector<int16_t>& pcm16) {
+    if (!impl_ || !impl_->ctx) return "";
+    if (pcm16.empty()) return "";
+    return transcribe_16k_mono_f32(impl_->to_f32(pcm16.data(), pcm16.size()), pcm16.size());
+}
+
+std::string WhisperASR::transcribe_16k_mono_f32(const float* pcm, size_t n) {
+    if (!impl_ || !impl_->ctx) return "";
+    if (n == 0) return "";
+
+    std::vector<Segment>& segs = impl_->segs;
+    impl_->gpu_class = GpuArbiter::Class::AsrFinal;
+    impl_->pick_model_for_final();
+    if (!impl_->run(pcm, n, impl_->p.single_segment, "", segs)) return "";
+
+    return join_segments(segs, 0, segs.size());
+}
+
+void WhisperASR::Impl::pick_model_for_final() {
+    // Under load a quick transcript beats waiting behind the LLM for the
+    // lease and then running the bigger encoder.
+    use_fast = fast_ctx && (prefer_fast || (gpu && gpu->busy()));
+}
+
+WhisperASR::Stats WhisperASR::last_stats() const {
+    return impl_ ? impl_->stats : Stats{};
+}
+
+void WhisperASR::prefer_fast(bool on) {
+    if (impl_) impl_->prefer_fast = on;
+}
+
+bool WhisperASR::has_fast_model() const {
+    return impl_ && impl_->fast_ctx;
+}
+
+static size_t prefix_samples(size_t n, int max_ms) {
+    return std::min(n, (size_t)std::max(100, max_ms) * 16);
+}
+
+std::string WhisperASR::transcribe_prefix(const int16_t* pcm, size_t n, int max_ms, int max_tokens) {
+    if (!impl_ || !impl_->ctx || n == 0) return "";
+    const size_t take = prefix_samples(n, max_ms);
+    return transcribe_prefix(impl_->to_f32(pcm, take), take, max_ms, max_tokens);
+}
+
+std::string WhisperASR::transcribe_prefix(const float* pcm, size_t n, int max_ms, int max_tokens) {
+    if (!impl_ || !impl_->ctx || n == 0) return "";
+
+    const size_t take = prefix_samples(n, max_ms);
 
-    out = trim_ws(out);
-    if (out == "[BLANK_AUDIO]") out.clear();
+    // The encoder normally runs a full 30 s window (1500 frames, 20 ms each).
+    // Shrink it to the audio we actually pass, plus some slack.
+    const int audio_ctx = std::min(1500, (int)(take / 320) + 64);
+
+    std::vector<Segment>& segs = impl_->segs;
+    impl_->gpu_class = GpuArbiter::Class::AsrFinal;   // gates the final decode
+    impl_->use_fast = false;
+    if (!impl_->run(pcm, take, /*single_segment=*/true, "", segs, audio_ctx, max_tokens)) return "";
+    return join_segments(segs, 0, segs.size());
+}
+
+void WhisperASR::stream_begin() {
+    if (!impl_) return;
+    impl_->s_committed.clear();
+    impl_->s_commit_sample = 0;
+    impl_->s_prev.clear();
+    impl_->s_last = Partial{};
+}
+
+WhisperASR::Partial WhisperASR::stream_update(const int16_t* pcm, size_t n) {
+    if (!impl_ || !impl_->ctx) return Partial{};
+    // Only the uncommitted window is read; leave the rest unconverted.
+    return stream_update(impl_->to_f32(pcm, n, impl_->s_commit_sample), n);
+}
+
+std::string WhisperASR::stream_finalize(const int16_t* pcm, size_t n) {
+    if (!impl_ || !impl_->ctx) return "";
+    return stream_finalize(impl_->to_f32(pcm, n, impl_->s_commit_sample), n);
+}
+
+WhisperASR::Partial WhisperASR::stream_update(const float* pcm, size_t n) {
+    if (!impl_ || !impl_->ctx) return Partial{};
+    Impl& im = *impl_;
+
+    const size_t min_window = (size_t)im.p.stream_min_window_ms * 16;
+    const size_t max_window = (size_t)im.p.stream_max_window_ms * 16;
+    if (n <= im.s_commit_sample || n - im.s_commit_sample < min_window) return im.s_last;
+
+    const size_t start = im.s_commit_sample;
+    const size_t len = n - start;
+
+    std::vector<Segment>& segs = im.segs;
+    im.gpu_class = GpuArbiter::Class::AsrPartial;
+    im.use_fast = false;
+    if (!im.run(pcm + start, len, /*single_segment=*/false, prompt_tail(im.s_committed), segs)) {
+        return im.s_last;
+    }
+
+    // Local agreement: commit the leading segments that match the previous
+    // hypothesis for the same window. The last segment is never committed
+    // (its end may still move). Past max_window, commit all but the last
+    // segment regardless so the window stays bounded.
+    size_t n_commit = 0;
+    const size_t limit = segs.empty() ? 0 : segs.size() - 1;
+    while (n_commit < limit) {
+        const bool agreed = n_commit < im.s_prev.size() && im.s_prev[n_commit].text == segs[n_commit].text;
+        if (!agreed && len < max_window) break;
+        n_commit++;
+    }
+
+    if (n_commit > 0) {
+        const std::string add = join_segments(segs, 0, n_commit);
+        if (!im.s_committed.empty()) im.s_committed += " ";
+        im.s_committed += add;
+        im.s_commit_sample = start + std::min(len, segs[n_commit - 1].end_sample);
+
+        segs.erase(segs.begin(), segs.begin() + (long)n_commit);
+        im.s_prev.clear();   // window start moved; old hypothesis no longer lines up
+    } else {
+        im.s_prev = segs;
+    }
+
+    im.s_last.committed = im.s_committed;
+    im.s_last.tentative = join_segments(segs, 0, segs.size());
+    return im.s_last;
+}
+
+std::string WhisperASR::stream_finalize(const float* pcm, size_t n) {
+    if (!impl_ || !impl_->ctx) return "";
+    Impl& im = *impl_;
+
+    std::string out = im.s_committed;
+    if (n > im.s_commit_sample) {
+        // Only the uncommitted tail is decoded at speech end.
+        std::vector<Segment>& segs = im.segs;
+        const size_t start = im.s_commit_sample;
+        im.gpu_class = GpuArbiter::Class::AsrFinal;
+        im.pick_model_for_final();
+        if (im.run(pcm + start, n - start, /*single_segment=*/false, prompt_tail(im.s_committed), segs)) {
+            const std::string tail = join_segments(segs, 0, segs.size());
+            if (!tail.empty()) {
+                if (!out.empty()) out += " ";
+                out += tail;
+            }
+        } else if (out.empty()) {
+            out = im.s_last.tentative;
+        }
+    }
+
+    stream_begin();
+    return trim_ws(out);
+}
+
+/* ------------------------------------------------------------ */
+/* WhisperPool                                                  */
+/* ------------------------------------------------------------ */
+
+struct WhisperPool::Impl {
+    WhisperApi api{};
+    Params p{};
+    std::string language_stable;
+    GpuArbiter* gpu = nullptr;
+
+    whisper_context* shared = nullptr;      // model for the states (state API)
+
+    struct Slot {
+        whisper_context* ctx = nullptr;     // owned when there is no shared model
+        whisper_state* state = nullptr;
+        std::vector<float> pcmf;
+        bool busy = false;
+    };
+    std::vector<Slot> slots;
+
+    std::mutex m;
+    std::condition_variable cv;
+};
+
+WhisperPool::WhisperPool(const std::string& model_path, const Params& params) : impl_(new Impl) {
+    Impl& im = *impl_;
+    im.p = params;
+    im.p.n_states = std::max(1, im.p.n_states);
+    im.language_stable = im.p.asr.language;
+    im.api = load_whisper_api();
+
+    whisper_context_params wp = im.api.context_default_params();
+    wp.use_gpu = im.p.asr.use_gpu;
+    wp.gpu_device = im.p.asr.gpu_device;
+    if (im.p.asr.use_gpu && im.p.asr.gpu_arbitrate) im.gpu = &GpuArbiter::for_device(im.p.asr.gpu_device);
+
+    im.slots.resize((size_t)im.p.n_states);
+    if (im.api.has_state_api()) {
+        im.shared = im.api.init_no_state(model_path.c_str(), wp);
+        if (!im.shared) {
+            std::fprintf(stderr, "WhisperPool: failed to init model: %s\n", model_path.c_str());
+            std::exit(1);
+        }
+        for (Impl::Slot& s : im.slots) {
+            s.state = im.api.init_state(im.shared);
+            if (!s.state) {
+                std::fprintf(stderr, "WhisperPool: failed to init decoder state\n");
+                std::exit(1);
+            }
+        }
+    } else {
+        std::fprintf(stderr, "[asr] libwhisper has no state API; pool uses %d full contexts\n", im.p.n_states);
+        for (Impl::Slot& s : im.slots) {
+            s.ctx = im.api.init_from_file_with_params(model_path.c_str(), wp);
+            if (!s.ctx) {
+                std::fprintf(stderr, "WhisperPool: failed to init model: %s\n", model_path.c_str());
+                std::exit(1);
+            }
+        }
+    }
+    std::fprintf(stderr, "[asr] whisper pool: %d decoders, %s\n", im.p.n_states,
+                 im.shared ? "shared model" : "one model each");
+}
+
+WhisperPool::~WhisperPool() {
+    if (!impl_) return;
+    Impl& im = *impl_;
+    for (Impl::Slot& s : im.slots) {
+        if (s.state) im.api.free_state(s.state);
+        if (s.ctx) im.api.free_ctx(s.ctx);
+    }
+    if (im.shared) im.api.free_ctx(im.shared);
+    if (im.api.handle) dlclose(im.api.handle);
+    delete impl_;
+    impl_ = nullptr;
+}
+
+std::string WhisperPool::transcribe(const int16_t* pcm, size_t n, Stats* stats) {
+    if (stats) *stats = Stats{};
+    if (!impl_ || n == 0) return "";
+    Impl& im = *impl_;
+
+    const auto w0 = std::chrono::steady_clock::now();
+    size_t idx = 0;
+    {
+        std::unique_lock<std::mutex> lk(im.m);
+        im.cv.wait(lk, [&]{
+            for (idx = 0; idx < im.slots.size(); idx++) {
+                if (!im.slots[idx].busy) return true;
+            }
+            return false;
+        });
+        im.slots[idx].busy = true;
+    }
+    Impl::Slot& s = im.slots[idx];
+    const auto t0 = std::chrono::steady_clock::now();
+
+    if (s.pcmf.size() < n) s.pcmf.resize(n);
+    pcm_s16_to_f32(pcm, s.pcmf.data(), n);
+
+    whisper_full_params fp = base_params(im.api, im.p.asr, im.language_stable);
+    apply_length_profile(im.p.asr, fp, n, 0, 0);
+
+    int rc;
+    {
+        GpuArbiter::Lease lease = gpu_lease(im.gpu, GpuArbiter::Class::AsrFinal);
+        rc = s.state ? im.api.full_with_state(im.shared, s.state, fp, s.pcmf.data(), (int)n)
+                     : im.api.full(s.ctx, fp, s.pcmf.data(), (int)n);
+    }
+
+    std::string out;
+    if (rc == 0) {
+        const int nseg = s.state ? im.api.full_n_segments_from_state(s.state) : im.api.full_n_segments(s.ctx);
+        for (int i = 0; i < nseg; i++) {
+            const char* t = s.state ? im.api.full_get_segment_text_from_state(s.state, i)
+                                    : im.api.full_get_segment_text(s.ctx, i);
+            const std::string txt = trim_ws(t ? t : "");
+            if (txt.empty() || txt == "[BLANK_AUDIO]") continue;
+            if (!out.empty()) out += " ";
+            out += txt;
+        }
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lk(im.m);
+        s.busy = false;
+    }
+    im.cv.notify_one();
+
+    if (stats) {
+        stats->asr.audio_ms = (double)n / 16.0;
+        stats->asr.audio_ctx = fp.audio_ctx > 0 ? fp.audio_ctx : 1500;
+        stats->asr.max_tokens = fp.max_tokens;
+        stats->asr.total_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        stats->wait_ms = std::chrono::duration<double, std::milli>(t0 - w0).count();
+        stats->state = (int)idx;
+    }
     return out;
 }
 
+int WhisperPool::size() const {
+    return impl_ ? (int)impl_->slots.size() : 0;
+}
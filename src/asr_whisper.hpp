@@ -10,7 +10,8 @@ public:
     struct Params {
         // Model/backend behavior
         bool use_gpu = true;      // whisper.cpp: enables GPU (e.g., cuBLAS) if built with it
-        int  gpu_device = 0;      // kept for future/multi-GPU sanity (harmless on Jetson)
+        int  gpu_device = 0;      // CUDA device for this engine (Jetson: always 0)
+        bool gpu_arbitrate = true; // take GpuArbiter leases for the device around each decode
 
         // Performance/latency
         int  n_threads = 6;       // Orin Nano: 6 CPU cores; tune alongside LLM threads
@@ -22,6 +23,52 @@ public:
 
         // Optional hygiene knobs
         int  max_len = 0;         // 0 = unlimited (whisper default). If supported by your whisper version.
+
+        // Streaming mode (stream_* calls)
+        int  stream_min_window_ms = 1000;   // don't bother decoding less new audio than this
+        int  stream_max_window_ms = 12000;  // force-commit older segments past this
+
+        // Length-aware decode. Whisper pads every call to its 30 s window
+        // and the encoder runs all 1500 frames (20 ms each) of it; a 2 s
+        // command only needs ~100. audio_ctx is sized to the audio plus
+        // slack (not below audio_ctx_min: very short windows start to hurt
+        // accuracy). Single-segment decodes also get a token budget for that
+        // much speech, which cuts off runaway repetition on noise.
+        bool  scale_audio_ctx = true;
+        int   audio_ctx_min   = 256;        // frames (5.1 s)
+        int   audio_ctx_slack = 64;         // frames (1.3 s) past the last sample
+        bool  scale_max_tokens = true;
+        float tokens_per_sec  = 8.0f;       // ~3x conversational speech
+        int   min_tokens      = 24;
+
+        // Optional smaller model (e.g. ggml-tiny.en next to base.en) for
+        // final decodes while the GPU is busy with other work, or while
+        // prefer_fast() is set. Streaming partials always use the main one.
+        std::string fast_model_path;
+    };
+
+    // Cost of the most recent decode (any entry point).
+    struct Stats {
+        double audio_ms   = 0.0;   // audio handed to whisper
+        int    audio_ctx  = 0;     // encoder frames run (1500 = the full window)
+        int    max_tokens = 0;     // 0 = unlimited
+        double encode_ms  = 0.0;   // whisper's own timings; 0 if the library lacks them
+        double decode_ms  = 0.0;
+        double total_ms   = 0.0;   // the whole whisper_full call, lease included
+        bool   fast_model = false;
+    };
+
+    // Streaming hypothesis: committed text never changes; tentative text is
+    // the current guess for the audio after the commit point.
+    struct Partial {
+        std::string committed;
+        std::string tentative;
+
+        std::string text() const {
+            if (committed.empty()) return tentative;
+            if (tentative.empty()) return committed;
+            return committed + " " + tentative;
+        }
     };
 
     WhisperASR(const std::string& model_path, const Params& p);
@@ -34,8 +81,78 @@ public:
     // Output: trimmed transcript (possibly empty)
     std::string transcribe_16k_mono_s16(const std::vector<int16_t>& pcm);
 
+    // Same, for callers that already hold float samples in [-1, 1) (what
+    // whisper consumes). The int16 entry points convert into a buffer owned
+    // by the engine, so either form avoids per-call allocation.
+    std::string transcribe_16k_mono_f32(const float* pcm, size_t n);
+
+    // Cheap look at the start of an utterance: decode at most max_ms of audio
+    // with a reduced encoder window and max_tokens output tokens. Meant for
+    // checking for the invocation phrase before paying for a full decode.
+    std::string transcribe_prefix(const int16_t* pcm, size_t n, int max_ms, int max_tokens);
+    std::string transcribe_prefix(const float* pcm, size_t n, int max_ms, int max_tokens);
+
+    // Streaming transcription of one utterance while it is still being spoken.
+    //   stream_begin()    at speech start
+    //   stream_update()   periodically, with the whole utterance so far
+    //   stream_finalize() at speech end; returns the final transcript
+    // Each call decodes only the audio after the committed point. Segments
+    // that two consecutive hypotheses agree on (and that are followed by
+    // another segment) are committed and never re-decoded.
+    void stream_begin();
+    Partial stream_update(const int16_t* pcm, size_t n);
+    std::string stream_finalize(const int16_t* pcm, size_t n);
+    Partial stream_update(const float* pcm, size_t n);
+    std::string stream_finalize(const float* pcm, size_t n);
+
+    Stats last_stats() const;
+
+    // Load hint from the caller (e.g. utterances queued behind this one):
+    // use the fast model for final decodes. No-op without fast_model_path.
+    void prefer_fast(bool on);
+    bool has_fast_model() const;
+
 private:
     struct Impl;
     Impl* impl_;
 };
 
+/*
+ * WhisperPool
+ *
+ * Final decodes for several sessions at once (edna_server): one copy of the
+ * model and n_states whisper_state decoders on top of it, each with its own
+ * KV cache and work buffers. transcribe() borrows a free state for one
+ * whisper_full and blocks while all of them are busy. Same greedy,
+ * length-aware decode as WhisperASR::transcribe_16k_mono_f32; no streaming
+ * and no fast model. With a libwhisper lacking the state API every slot is
+ * a full context instead (n_states copies of the weights).
+ */
+class WhisperPool {
+public:
+    struct Params {
+        WhisperASR::Params asr;    // stream_* and fast_model_path are not used
+        int n_states = 2;
+    };
+
+    struct Stats {
+        WhisperASR::Stats asr;     // encode_ms / decode_ms stay 0 (no per-state timings)
+        double wait_ms = 0.0;      // waiting for a free state
+        int    state = -1;         // which one decoded
+    };
+
+    WhisperPool(const std::string& model_path, const Params& p);
+    ~WhisperPool();
+
+    WhisperPool(const WhisperPool&) = delete;
+    WhisperPool& operator=(const WhisperPool&) = delete;
+
+    // Any thread. 16 kHz mono s16 in, trimmed transcript out.
+    std::string transcribe(const int16_t* pcm, size_t n, Stats* stats = nullptr);
+
+    int size() const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
@@ -0,0 +1,296 @@
+// audio_out.cpp
+#include "audio_out.hpp"
+#include "wav_io.hpp"
+
+#include <alsa/asoundlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AlsaPlayback::Impl {
+    enum class Sink { Alsa, Null, File };
+
+    Params p{};
+    Sink sink = Sink::Alsa;
+    snd_pcm_t* pcm = nullptr;
+    WavWriter wav;             // Sink::File
+
+    unsigned rate = 0;
+    unsigned channels = 0;
+    snd_pcm_uframes_t period = 0;
+    bool needs_prepare = false;
+
+    Stats stats{};
+    std::string last_err;
+
+    std::vector<int16_t> scaled;   // gain != 1: write() plays this copy
+};
+
+AlsaPlayback::AlsaPlayback(const Params& p) : impl_(new Impl) {
+    impl_->p = p;
+    if (p.device == "null") {
+        impl_->sink = Impl::Sink::Null;
+    } else if (p.device.compare(0, 5, "file:") == 0) {
+        impl_->sink = Impl::Sink::File;
+    }
+    // Open eagerly so the first utterance doesn't pay for it.
+    std::lock_guard<std::mutex> lk(m_);
+    if (!configure_locked(p.sample_rate, p.channels)) {
+        std::fprintf(stderr, "AlsaPlayback: %s (will retry on first write)\n",
+                     impl_->last_err.c_str());
+    }
+}
+
+AlsaPlayback::~AlsaPlayback() {
+    if (!impl_) return;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if (impl_->pcm) snd_pcm_drain(impl_->pcm);
+        close_locked();
+    }
+    delete impl_;
+    impl_ = nullptr;
+}
+
+void AlsaPlayback::close_locked() {
+    impl_->wav.close();
+    if (impl_->pcm) {
+        snd_pcm_close(impl_->pcm);
+        impl_->pcm = nullptr;
+    }
+    impl_->rate = 0;
+    impl_->channels = 0;
+}
+
+static std::string alsa_err(const char* what, int err) {
+    return std::string(what) + ": " + snd_strerror(err);
+}
+
+bool AlsaPlayback::configure_locked(unsigned sample_rate, unsigned channels) {
+    if ((impl_->pcm || impl_->sink != Impl::Sink::Alsa) &&
+        impl_->rate == sample_rate && impl_->channels == channels) return true;
+
+    close_locked();
+
+    if (impl_->sink != Impl::Sink::Alsa) {
+        // The first real chunk fixes the format; a later format change
+        // starts the file over.
+        if (impl_->sink == Impl::Sink::File &&
+            !impl_->wav.open(impl_->p.device.substr(5), sample_rate, channels)) {
+            impl_->last_err = "cannot create " + impl_->p.device.substr(5);
+            return false;
+        }
+        impl_->rate = sample_rate;
+        impl_->channels = channels;
+        impl_->period = (snd_pcm_uframes_t)((uint64_t)sample_rate * impl_->p.period_us / 1000000u);
+        impl_->stats.reconfigs++;
+        std::fprintf(stderr, "[audio] playback '%s' rate=%u ch=%u (no device)\n",
+                     impl_->p.device.c_str(), sample_rate, channels);
+        return true;
+    }
+
+    snd_pcm_t* pcm = nullptr;
+    int err = snd_pcm_open(&pcm, impl_->p.device.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        impl_->last_err = alsa_err("snd_pcm_open failed", err);
+        return false;
+    }
+
+    snd_pcm_hw_params_t* hw = nullptr;
+    snd_pcm_hw_params_malloc(&hw);
+    snd_pcm_hw_params_any(pcm, hw);
+
+    unsigned rate = sample_rate;
+    snd_pcm_uframes_t period = (snd_pcm_uframes_t)((uint64_t)sample_rate * impl_->p.period_us / 1000000u);
+    snd_pcm_uframes_t buffer = (snd_pcm_uframes_t)((uint64_t)sample_rate * impl_->p.buffer_us / 1000000u);
+    period = std::max<snd_pcm_uframes_t>(period, 64);
+    buffer = std::max<snd_pcm_uframes_t>(buffer, period * 2);
+
+    if ((err = snd_pcm_hw_params_set_access(pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(pcm, hw, SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, hw, channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_resample(pcm, hw, 1)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, nullptr)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, nullptr)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw, &buffer)) < 0 ||
+        (err = snd_pcm_hw_params(pcm, hw)) < 0) {
+        snd_pcm_hw_params_free(hw);
+        snd_pcm_close(pcm);
+        impl_->last_err = alsa_err("snd_pcm_hw_params failed", err);
+        return false;
+    }
+    snd_pcm_hw_params_get_period_size(hw, &period, nullptr);
+    snd_pcm_hw_params_get_buffer_size(hw, &buffer);
+    snd_pcm_hw_params_free(hw);
+
+    // Start as soon as one period is queued rather than when the buffer is
+    // full: the first syllable shouldn't wait for 120 ms of priming.
+    snd_pcm_sw_params_t* sw = nullptr;
+    snd_pcm_sw_params_malloc(&sw);
+    snd_pcm_sw_params_current(pcm, sw);
+    snd_pcm_sw_params_set_start_threshold(pcm, sw, period);
+    snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+    err = snd_pcm_sw_params(pcm, sw);
+    snd_pcm_sw_params_free(sw);
+    if (err < 0) {
+        snd_pcm_close(pcm);
+        impl_->last_err = alsa_err("snd_pcm_sw_params failed", err);
+        return false;
+    }
+
+    impl_->pcm = pcm;
+    impl_->rate = sample_rate;
+    impl_->channels = channels;
+    impl_->period = period;
+    impl_->needs_prepare = false;
+    impl_->stats.reconfigs++;
+
+    std::fprintf(stderr, "[audio] playback '%s' rate=%u ch=%u period=%lu buffer=%lu\n",
+                 impl_->p.device.c_str(), rate, channels,
+                 (unsigned long)period, (unsigned long)buffer);
+    return true;
+}
+
+// Drop what the device still holds if abort() ran since the last drop.
+// abort() can only do that itself when nobody holds m_, so whoever takes m_
+// next catches up here. True if there was an abort to honor.
+bool AlsaPlayback::honor_abort_locked() {
+    const uint64_t g = abort_gen_.load(std::memory_order_acquire);
+    if (g == dropped_gen_) return false;
+    dropped_gen_ = g;
+    if (impl_->pcm) {
+        snd_pcm_drop(impl_->pcm);
+        impl_->needs_prepare = true;
+    }
+    return true;
+}
+
+bool AlsaPlayback::write(const int16_t* pcm, size_t frames, unsigned sample_rate, unsigned channels) {
+    const uint64_t gen = abort_gen_.load(std::memory_order_acquire);
+    std::lock_guard<std::mutex> lk(m_);
+    honor_abort_locked();
+    // Aborted while waiting for the device: this audio is stale too.
+    if (dropped_gen_ != gen) {
+        impl_->stats.aborts++;
+        return true;
+    }
+
+    if (!configure_locked(sample_rate, channels)) {
+        impl_->stats.write_errors++;
+        return false;
+    }
+
+    const float gain = gain_.load(std::memory_order_relaxed);
+    if (gain < 1.0f) {
+        const size_t n = frames * channels;
+        impl_->scaled.resize(n);
+        for (size_t i = 0; i < n; ++i) impl_->scaled[i] = (int16_t)std::lrintf(pcm[i] * gain);
+        pcm = impl_->scaled.data();
+    }
+
+    if (impl_->sink != Impl::Sink::Alsa) {
+        // Nothing to wait for: the audio "plays" the moment it is written.
+        if (tap_) tap_(pcm, frames, impl_->rate, channels, std::chrono::steady_clock::now());
+        if (impl_->sink == Impl::Sink::File && !impl_->wav.write(pcm, frames)) {
+            impl_->stats.write_errors++;
+            impl_->last_err = "short write to " + impl_->p.device.substr(5);
+            return false;
+        }
+        impl_->stats.frames_written += frames;
+        return true;
+    }
+
+    if (impl_->needs_prepare) {
+        snd_pcm_prepare(impl_->pcm);
+        impl_->needs_prepare = false;
+    }
+
+    const size_t step = std::max<size_t>(impl_->period, 64);
+    size_t off = 0;
+    while (off < frames) {
+        if (honor_abort_locked()) {
+            impl_->stats.aborts++;
+            return true;
+        }
+        const size_t want = std::min(step, frames - off);
+
+        std::chrono::steady_clock::time_point play_at{};
+        if (tap_) {
+            snd_pcm_sframes_t queued = 0;
+            if (snd_pcm_delay(impl_->pcm, &queued) < 0 || queued < 0) queued = 0;
+            play_at = std::chrono::steady_clock::now() +
+                      std::chrono::microseconds((int64_t)queued * 1000000 / impl_->rate);
+        }
+
+        snd_pcm_sframes_t n = snd_pcm_writei(impl_->pcm, pcm + off * channels, want);
+        if (n < 0) {
+            if (n == -EPIPE) impl_->stats.underruns++;
+            if (n == -EINTR) continue;
+
+            const int rc = snd_pcm_recover(impl_->pcm, (int)n, /*silent=*/1);
+            if (rc < 0) {
+                impl_->stats.write_errors++;
+                impl_->last_err = alsa_err("snd_pcm_writei failed", rc);
+                // Device went away (USB unplug?): reopen on the next write.
+                close_locked();
+                return false;
+            }
+            continue;
+        }
+        if (tap_) tap_(pcm + off * channels, (size_t)n, impl_->rate, channels, play_at);
+        off += (size_t)n;
+        impl_->stats.frames_written += (uint64_t)n;
+    }
+    // An abort during the last period: drop it now, not at the next write.
+    if (honor_abort_locked()) impl_->stats.aborts++;
+    return true;
+}
+
+void AlsaPlayback::drain() {
+    std::lock_guard<std::mutex> lk(m_);
+    impl_->wav.flush();
+    if (honor_abort_locked() || !impl_->pcm || impl_->needs_prepare) return;
+
+    // A blocking snd_pcm_drain would hold m_ until the buffer has played,
+    // deaf to abort(). Non-blocking, it starts the drain and returns;
+    // wait for it here a period at a time.
+    snd_pcm_nonblock(impl_->pcm, 1);
+    int err = snd_pcm_drain(impl_->pcm);
+    while (err == -EAGAIN && snd_pcm_state(impl_->pcm) == SND_PCM_STATE_DRAINING) {
+        if (honor_abort_locked()) {
+            impl_->stats.aborts++;
+            break;
+        }
+        snd_pcm_sframes_t queued = 0;
+        if (snd_pcm_delay(impl_->pcm, &queued) < 0 || queued <= 0) queued = (snd_pcm_sframes_t)impl_->period;
+        const int64_t us = (int64_t)std::min<snd_pcm_sframes_t>(queued, (snd_pcm_sframes_t)impl_->period) *
+                           1000000 / impl_->rate;
+        std::this_thread::sleep_for(std::chrono::microseconds(std::max<int64_t>(us, 1000)));
+    }
+    snd_pcm_nonblock(impl_->pcm, 0);
+    // drain leaves the PCM in SETUP; prepare lazily before the next write.
+    impl_->needs_prepare = true;
+}
+
+void AlsaPlayback::abort() {
+    abort_gen_.fetch_add(1, std::memory_order_acq_rel);
+    // If nobody holds the device, drop what is still buffered here;
+    // otherwise the holder (write or drain) drops it within one period.
+    std::unique_lock<std::mutex> lk(m_, std::try_to_lock);
+    if (lk.owns_lock()) honor_abort_locked();
+}
+
+AlsaPlayback::Stats AlsaPlayback::stats() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return impl_->stats;
+}
+
+std::string AlsaPlayback::last_error() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return impl_->last_err;
+}
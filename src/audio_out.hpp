@@ -0,0 +1,99 @@
+// audio_out.hpp
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+/*
+ * AlsaPlayback
+ *
+ * Persistent playback device: one snd_pcm_t stays open for the life of the
+ * process and PCM frames are written straight to it with snd_pcm_writei,
+ * mirroring the capture side in main.cpp. Replaces fork/exec of aplay per
+ * chunk (process creation + device open/close + buffer priming each time).
+ *
+ * Two pseudo devices bypass ALSA for offline runs (edna_bench): "null"
+ * discards audio and "file:<path>" records it to a WAV file. Neither
+ * blocks, so playback runs as fast as synthesis.
+ */
+class AlsaPlayback {
+public:
+    struct Params {
+        std::string device = "default";   // ALSA name, "null" or "file:<path>"
+
+        // Initial format. If a chunk arrives with a different rate/channel
+        // count the device is reconfigured (rare: one TTS model = one rate).
+        unsigned sample_rate = 22050;
+        unsigned channels    = 1;
+
+        // ALSA buffering. Short periods keep startup latency low; the buffer
+        // must be large enough to ride out scheduling hiccups.
+        unsigned period_us = 20000;
+        unsigned buffer_us = 120000;
+    };
+
+    struct Stats {
+        uint64_t frames_written = 0;
+        uint64_t underruns      = 0;   // EPIPE while writing (mid-chunk starvation)
+        uint64_t write_errors   = 0;
+        uint64_t reconfigs      = 0;   // device (re)opened with new hw params
+        uint64_t aborts         = 0;   // writes cut short by abort()
+    };
+
+    // Reference tap for echo cancellation: called on the writing thread with
+    // every chunk handed to the device and the time its first frame is
+    // expected to reach the speaker (now + snd_pcm_delay). Must be cheap.
+    using TapFn = std::function<void(const int16_t* pcm, size_t frames,
+                                     unsigned sample_rate, unsigned channels,
+                                     std::chrono::steady_clock::time_point play_at)>;
+
+    explicit AlsaPlayback(const Params& p);
+    ~AlsaPlayback();
+
+    AlsaPlayback(const AlsaPlayback&) = delete;
+    AlsaPlayback& operator=(const AlsaPlayback&) = delete;
+
+    // Write interleaved S16 frames; blocks while the ALSA buffer is full.
+    // Frames go to the device a period at a time so abort() can cut in.
+    bool write(const int16_t* pcm, size_t frames, unsigned sample_rate, unsigned channels);
+
+    // Let queued audio play out, then re-arm the device for the next write.
+    // The device stays open. Polls for abort() a period at a time.
+    void drain();
+
+    // Stop playback now (barge-in): a write() or drain() in progress returns
+    // within a period and whatever is buffered in the device is dropped
+    // rather than played. Safe to call from any thread.
+    void abort();
+
+    Stats stats() const;
+    std::string last_error() const;
+
+    // Install before playback starts (not synchronized with write()).
+    void set_tap(TapFn tap) { tap_ = std::move(tap); }
+
+    // Software output gain (linear, 0..1), applied in write() before the
+    // tap so the echo reference matches what the speaker plays. Takes
+    // effect on the next period; safe to call from any thread.
+    void set_gain(float g) { gain_.store(g < 0.0f ? 0.0f : (g > 1.0f ? 1.0f : g), std::memory_order_relaxed); }
+    float gain() const { return gain_.load(std::memory_order_relaxed); }
+
+private:
+    bool configure_locked(unsigned sample_rate, unsigned channels);
+    void close_locked();
+    bool honor_abort_locked();
+
+    struct Impl;
+    Impl* impl_;
+
+    mutable std::mutex m_;
+    std::atomic<uint64_t> abort_gen_{0};
+    uint64_t dropped_gen_ = 0;   // abort_gen_ the device last dropped for (m_)
+    std::atomic<float> gain_{1.0f};
+    TapFn tap_;
+};
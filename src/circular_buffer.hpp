@@ -0,0 +1,94 @@
+// circular_buffer.hpp
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/*
+ * CircularBuffer
+ *
+ * Fixed-capacity sample buffer that keeps the newest capacity() elements.
+ * Storage is allocated once in the constructor; push never shifts or
+ * reallocates, it overwrites the oldest data when full.
+ *
+ * Used for the capture pre-roll (always full, constantly overwritten) and
+ * the ASR utterance accumulator (cleared per utterance, so it only wraps
+ * when an utterance outgrows the capacity). linearize() hands out one
+ * contiguous pointer, oldest first, and only moves data if the buffer has
+ * actually wrapped.
+ *
+ * Not thread-safe; one owner.
+ */
+template <typename T>
+class CircularBuffer {
+public:
+    explicit CircularBuffer(size_t capacity) : buf_(std::max<size_t>(1, capacity)) {}
+
+    size_t capacity() const { return buf_.size(); }
+    size_t size() const { return size_; }
+    bool   empty() const { return size_ == 0; }
+    bool   full() const { return size_ == buf_.size(); }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    // Append n elements; the oldest are dropped if they no longer fit.
+    void push(const T* v, size_t n) {
+        push_fill(n, [&](T* dst, size_t k, size_t at) { std::copy(v + at, v + at + k, dst); });
+    }
+
+    // Append n elements produced in place: fill(dst, k, at) must write
+    // input elements [at, at + k) to dst. Called once, or twice when the
+    // write wraps, so converters can target the ring directly.
+    template <typename Fill>
+    void push_fill(size_t n, Fill&& fill) {
+        const size_t cap = buf_.size();
+        size_t at = 0;
+        if (n > cap) {               // only the last cap elements survive
+            at = n - cap;
+            n = cap;
+        }
+
+        size_t tail = (head_ + size_) % cap;
+        const size_t first = std::min(n, cap - tail);
+        fill(buf_.data() + tail, first, at);
+        if (first < n) fill(buf_.data(), n - first, at + first);
+
+        const size_t total = size_ + n;
+        if (total > cap) {
+            head_ = (head_ + (total - cap)) % cap;
+            size_ = cap;
+        } else {
+            size_ = total;
+        }
+    }
+
+    // Copy n elements starting `from` elements after the oldest.
+    void copy_out(size_t from, T* dst, size_t n) const {
+        const size_t cap = buf_.size();
+        n = std::min(n, from < size_ ? size_ - from : 0);
+        const size_t start = (head_ + from) % cap;
+        const size_t first = std::min(n, cap - start);
+        std::copy(buf_.data() + start, buf_.data() + start + first, dst);
+        std::copy(buf_.data(), buf_.data() + (n - first), dst + first);
+    }
+
+    // Contiguous view of the contents, oldest first. O(1) unless wrapped.
+    const T* linearize() {
+        if (head_ + size_ > buf_.size()) {
+            std::rotate(buf_.begin(), buf_.begin() + (long)head_, buf_.end());
+            head_ = 0;
+        } else if (size_ == 0) {
+            head_ = 0;
+        }
+        return buf_.data() + head_;
+    }
+
+private:
+    std::vector<T> buf_;
+    size_t head_ = 0;   // index of the oldest element
+    size_t size_ = 0;
+};
@@ -0,0 +1,117 @@
+// endpointer.cpp
+#include "endpointer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static double frame_dbfs(const int16_t* x, size_t n) {
+    if (!x || n == 0) return -90.0;
+    double acc = 0.0;
+    for (size_t i = 0; i < n; i++) acc += (double)x[i] * (double)x[i];
+    const double rms = std::sqrt(acc / (double)n) / 32768.0;
+    return 20.0 * std::log10(std::max(rms, 1e-5));
+}
+
+Endpointer::Endpointer(const Params& p) : p_(p) {}
+
+int Endpointer::hangover_frames() const {
+    double h = p_.base_hangover_frames;
+
+    const double snr = speech_db_ - noise_db_;
+    if (snr < p_.good_snr_db) h += (p_.good_snr_db - snr) * p_.frames_per_db;
+
+    if (pause_ema_ > 0.0) h = std::max(h, pause_ema_ * p_.pause_factor);
+
+    int frames = (int)std::lround(h);
+    frames = std::clamp(frames, p_.min_hangover_frames, p_.max_hangover_frames);
+
+    if (cue_utt_.load(std::memory_order_relaxed) == utt_ && in_speech_) {
+        frames = std::min(frames, p_.cue_hangover_frames);
+    }
+    return frames;
+}
+
+Endpointer::Decision Endpointer::push(int vad, const int16_t* pcm, size_t n) {
+    const double db = frame_dbfs(pcm, n);
+
+    if (!in_speech_) {
+        // Noise floor: track quickly downwards, slowly upwards.
+        if (vad <= 0) {
+            const double a = db < noise_db_ ? 0.3 : 0.02;
+            noise_db_ += a * (db - noise_db_);
+        }
+
+        last_voiced_ = vad > 0;
+        if (vad > 0) voiced_run_++;
+        else voiced_run_ = 0;
+
+        return voiced_run_ >= p_.start_frames ? Decision::Start : Decision::None;
+    }
+
+    const bool voiced = vad > 0 && db > noise_db_ + p_.speech_margin_db;
+    last_voiced_ = voiced;
+
+    if (voiced) {
+        speech_db_ += 0.05 * (db - speech_db_);
+
+        // A gap that ended in more speech was a pause, not the end.
+        if (unvoiced_run_ >= p_.min_pause_frames) {
+            pause_ema_ = pause_ema_ > 0.0 ? 0.7 * pause_ema_ + 0.3 * unvoiced_run_
+                                          : (double)unvoiced_run_;
+        }
+        unvoiced_run_ = 0;
+        return Decision::None;
+    }
+
+    unvoiced_run_++;
+    const int hang = hangover_frames();
+    if (unvoiced_run_ < hang) return Decision::None;
+
+    last_.trailing_ms = unvoiced_run_ * p_.frame_ms;
+    last_.hangover_ms = hang * p_.frame_ms;
+    last_.noise_db = noise_db_;
+    last_.snr_db = speech_db_ - noise_db_;
+    last_.pause_ms = pause_ema_ * p_.frame_ms;
+    last_.cue = cue_utt_.load(std::memory_order_relaxed) == utt_ &&
+                hang <= p_.cue_hangover_frames;
+
+    in_speech_ = false;
+    voiced_run_ = 0;
+    unvoiced_run_ = 0;
+    return Decision::End;
+}
+
+void Endpointer::start(uint64_t utt) {
+    in_speech_ = true;
+    utt_ = utt;
+    voiced_run_ = 0;
+    unvoiced_run_ = 0;
+}
+
+void Endpointer::reset() {
+    in_speech_ = false;
+    voiced_run_ = 0;
+    unvoiced_run_ = 0;
+}
+
+void Endpointer::cue_complete(uint64_t utt) {
+    cue_utt_.store(utt, std::memory_order_relaxed);
+}
+
+void VoicedSpan::add(size_t at, size_t n, bool voiced) {
+    if (!valid_ || !voiced) return;
+    if (first_ == kNone) first_ = at;
+    end_ = std::max(end_, at + n);
+}
+
+void VoicedSpan::bounds(size_t n, int lead_pad, int trail_pad, size_t& begin, size_t& end) const {
+    begin = 0;
+    end = n;
+    if (!valid_ || first_ == kNone || end_ <= first_) return;
+    begin = first_ > (size_t)lead_pad ? first_ - (size_t)lead_pad : 0;
+    end = std::min(n, end_ + (size_t)trail_pad);
+    if (end <= begin) {
+        begin = 0;
+        end = n;
+    }
+}
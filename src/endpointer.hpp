@@ -0,0 +1,132 @@
+// endpointer.hpp
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Endpointer
+ *
+ * Per-frame speech start / end decisions on top of a frame VAD (libfvad).
+ * The fixed "20 unvoiced frames" rule made every command pay 400 ms of
+ * silence before ASR started; here the end-of-speech hangover adapts:
+ *
+ *  - noise: a background energy floor is tracked between utterances. In
+ *    speech, VAD-voiced frames that are barely above it count as silence
+ *    (trailing room noise keeps fvad "voiced"), and a poor SNR lengthens
+ *    the hangover because the VAD flaps more.
+ *  - speaking rate: pauses inside an utterance (silence followed by more
+ *    speech) are tracked; a slow, pausing talker gets a longer hangover, a
+ *    fast one a shorter one.
+ *  - transcript cue: the ASR thread can report that the partial transcript
+ *    already reads as a complete command/question (cue_complete); the
+ *    hangover then drops to cue_hangover_frames.
+ *
+ * Called from the capture thread only, except cue_complete().
+ */
+class Endpointer {
+public:
+    struct Params {
+        int frame_ms = 20;
+
+        int start_frames = 3;            // voiced run that opens an utterance (60 ms)
+
+        // End-of-speech hangover bounds, in frames.
+        int min_hangover_frames = 10;    // 200 ms
+        int base_hangover_frames = 16;   // 320 ms with clean audio and no pause history
+        int max_hangover_frames = 30;    // 600 ms
+        int cue_hangover_frames = 8;     // 160 ms once the transcript reads complete
+
+        // Noise adaptation
+        double speech_margin_db = 6.0;   // voiced frames weaker than floor + this count as silence
+        double good_snr_db = 18.0;       // below this, add hangover
+        double frames_per_db = 0.5;      // extra hangover frames per dB of missing SNR
+
+        // Speaking-rate adaptation: hangover >= pause_factor * typical pause.
+        double pause_factor = 1.5;
+        int min_pause_frames = 3;        // shorter gaps are not pauses
+    };
+
+    enum class Decision { None, Start, End };
+
+    // Describes the most recent End decision.
+    struct Endpoint {
+        int    trailing_ms = 0;          // silence observed before End (the endpoint delay)
+        int    hangover_ms = 0;          // hangover in force at that point
+        double noise_db = 0.0;
+        double snr_db = 0.0;
+        double pause_ms = 0.0;           // typical intra-utterance pause
+        bool   cue = false;              // ended early on a transcript cue
+    };
+
+    explicit Endpointer(const Params& p);
+
+    // Feed one frame: vad = fvad_process() result (>0 voiced), pcm for energy.
+    Decision push(int vad, const int16_t* pcm, size_t n);
+
+    // Enter speech for utterance utt (after Decision::Start, or forced for
+    // barge-in).
+    void start(uint64_t utt);
+
+    // Leave speech without an endpoint and clear run counters (mic gated).
+    void reset();
+
+    // Any thread: the partial transcript of utterance utt looks complete.
+    void cue_complete(uint64_t utt);
+
+    bool in_speech() const { return in_speech_; }
+    // Verdict for the frame just pushed: voiced and, in speech, above the
+    // noise floor (trailing room noise that fvad calls voiced is not).
+    bool voiced() const { return last_voiced_; }
+    int  trailing_frames() const { return unvoiced_run_; }
+    int  hangover_frames() const;
+    const Endpoint& last_endpoint() const { return last_; }
+
+private:
+    Params p_;
+
+    bool in_speech_ = false;
+    bool last_voiced_ = false;
+    uint64_t utt_ = 0;
+    int voiced_run_ = 0;
+    int unvoiced_run_ = 0;
+
+    double noise_db_ = -60.0;            // frame energy floor (dBFS)
+    double speech_db_ = -20.0;           // voiced frame level (dBFS)
+    double pause_ema_ = 0.0;             // frames
+
+    std::atomic<uint64_t> cue_utt_{0};
+    Endpoint last_{};
+};
+
+/*
+ * VoicedSpan
+ *
+ * Where the speech is inside one utterance buffer, from the per-frame
+ * voiced() verdicts: sample offset of the first voiced frame and the end of
+ * the last one. The pre-roll before the onset and the endpoint hangover
+ * after it are silence Whisper would otherwise decode; bounds() gives the
+ * range to keep, with some padding so word edges survive.
+ */
+class VoicedSpan {
+public:
+    void reset() { first_ = kNone; end_ = 0; valid_ = true; }
+
+    // A frame of n samples was appended at sample offset at.
+    void add(size_t at, size_t n, bool voiced);
+
+    // Offsets no longer line up (the buffer dropped old audio): bounds()
+    // returns everything until the next reset().
+    void invalidate() { valid_ = false; }
+
+    // [begin, end) of an n-sample buffer to decode; pads are in samples.
+    // The whole buffer when no frame was voiced.
+    void bounds(size_t n, int lead_pad, int trail_pad, size_t& begin, size_t& end) const;
+
+private:
+    static constexpr size_t kNone = (size_t)-1;
+    size_t first_ = kNone;
+    size_t end_ = 0;
+    bool valid_ = true;
+};
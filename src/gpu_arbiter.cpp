@@ -0,0 +1,135 @@
+// gpu_arbiter.cpp
+#include "gpu_arbiter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_between(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+GpuArbiter::Lease& GpuArbiter::Lease::operator=(Lease&& o) noexcept {
+    if (this != &o) {
+        release();
+        arb_ = o.arb_;
+        cls_ = o.cls_;
+        t0_ = o.t0_;
+        o.arb_ = nullptr;
+    }
+    return *this;
+}
+
+void GpuArbiter::Lease::release() {
+    if (!arb_) return;
+    arb_->release(cls_, t0_);
+    arb_ = nullptr;
+}
+
+GpuArbiter::GpuArbiter(int device, int max_concurrent)
+    : device_(device), max_concurrent_(std::max(1, max_concurrent)) {}
+
+GpuArbiter& GpuArbiter::for_device(int device) {
+    static std::mutex reg_m;
+    static std::map<int, std::unique_ptr<GpuArbiter>> reg;
+    std::lock_guard<std::mutex> lk(reg_m);
+    auto& a = reg[device];
+    if (!a) a.reset(new GpuArbiter(device));
+    return *a;
+}
+
+bool GpuArbiter::can_run_locked(Class c) const {
+    if (active_ >= max_concurrent_) return false;
+    for (int i = 0; i < (int)c; i++) {
+        if (waiting_[i] > 0) return false;   // someone more important is queued
+    }
+    return true;
+}
+
+GpuArbiter::Lease GpuArbiter::acquire(Class c) {
+    const int ci = (int)c;
+    const auto w0 = Clock::now();
+
+    std::unique_lock<std::mutex> lk(m_);
+    bool waited = false;
+    if (!can_run_locked(c)) {
+        waited = true;
+        waiting_[ci]++;
+        cv_.wait(lk, [&]{
+            // Our own entry is in waiting_[ci]; only higher classes block us.
+            return can_run_locked(c);
+        });
+        waiting_[ci]--;
+    }
+    active_++;
+
+    const auto t0 = Clock::now();
+    ClassStats& st = stats_[ci];
+    st.leases++;
+    if (waited) {
+        const double w = ms_between(w0, t0);
+        st.contended++;
+        st.wait_ms_total += w;
+        st.wait_ms_max = std::max(st.wait_ms_max, w);
+    }
+    lk.unlock();
+
+    Lease l;
+    l.arb_ = this;
+    l.cls_ = c;
+    l.t0_ = t0;
+    return l;
+}
+
+void GpuArbiter::release(Class c, Clock::time_point t0) {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        active_--;
+        stats_[(int)c].hold_ms_total += ms_between(t0, Clock::now());
+    }
+    // Waiters of different classes share cv_; each re-checks its own rule.
+    cv_.notify_all();
+}
+
+GpuArbiter::ClassStats GpuArbiter::stats(Class c) const {
+    std::lock_guard<std::mutex> lk(m_);
+    return stats_[(int)c];
+}
+
+bool GpuArbiter::busy() const {
+    std::lock_guard<std::mutex> lk(m_);
+    if (active_ > 0) return true;
+    for (int w : waiting_) if (w > 0) return true;
+    return false;
+}
+
+const char* GpuArbiter::class_name(Class c) {
+    switch (c) {
+        case Class::AsrFinal:    return "asr_final";
+        case Class::LlmDecode:   return "llm_decode";
+        case Class::AsrPartial:  return "asr_partial";
+        case Class::TtsPrefetch: return "tts_prefetch";
+    }
+    return "unknown";
+}
+
+std::string GpuArbiter::report() const {
+    std::lock_guard<std::mutex> lk(m_);
+    std::string out;
+    char line[256];
+    for (int i = 0; i < kClasses; i++) {
+        const ClassStats& st = stats_[i];
+        if (st.leases == 0) continue;
+        std::snprintf(line, sizeof(line),
+                      "[perf] gpu=%d class=%s leases=%llu contended=%llu wait_ms_avg=%.2f wait_ms_max=%.1f busy_ms=%.0f\n",
+                      device_, class_name((Class)i),
+                      (unsigned long long)st.leases, (unsigned long long)st.contended,
+                      st.contended ? st.wait_ms_total / (double)st.contended : 0.0,
+                      st.wait_ms_max, st.hold_ms_total);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,102 @@
+// gpu_arbiter.hpp
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/*
+ * GpuArbiter
+ *
+ * Cooperative scheduler for one GPU shared by Whisper, llama.cpp and the TTS
+ * worker. Engines take a Lease around each unit of heavy GPU work (one
+ * whisper_full, one llama_decode, one TTS chunk); when several are waiting
+ * the highest priority class goes first. There is no preemption: the LLM
+ * takes a lease per decode step precisely so an ASR finalize can slip in
+ * between two tokens instead of waiting out the whole reply.
+ *
+ * One arbiter per device (for_device); engines placed on different
+ * devices never wait on each other.
+ */
+class GpuArbiter {
+public:
+    // Lower value = higher priority.
+    enum class Class : int {
+        AsrFinal    = 0,   // user is waiting on this transcript
+        LlmDecode   = 1,   // reply tokens (and the TTS chunk playback waits on)
+        AsrPartial  = 2,   // streaming hypotheses
+        TtsPrefetch = 3,   // synthesis ahead of playback
+    };
+    static constexpr int kClasses = 4;
+
+    struct ClassStats {
+        uint64_t leases = 0;
+        uint64_t contended = 0;      // had to wait
+        double   wait_ms_total = 0.0;
+        double   wait_ms_max = 0.0;
+        double   hold_ms_total = 0.0;
+    };
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& o) noexcept { *this = std::move(o); }
+        Lease& operator=(Lease&& o) noexcept;
+        ~Lease() { release(); }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        // Give the GPU back early (e.g. before blocking on something else).
+        void release();
+        bool held() const { return arb_ != nullptr; }
+
+    private:
+        friend class GpuArbiter;
+        GpuArbiter* arb_ = nullptr;
+        Class cls_ = Class::TtsPrefetch;
+        std::chrono::steady_clock::time_point t0_{};
+    };
+
+    explicit GpuArbiter(int device = 0, int max_concurrent = 1);
+
+    GpuArbiter(const GpuArbiter&) = delete;
+    GpuArbiter& operator=(const GpuArbiter&) = delete;
+
+    // Shared arbiter for a device index (created on first use).
+    static GpuArbiter& for_device(int device);
+
+    // Block until this class may use the GPU.
+    Lease acquire(Class c);
+
+    ClassStats stats(Class c) const;
+
+    // Snapshot: a lease is held or someone is waiting for one.
+    bool busy() const;
+    int device() const { return device_; }
+
+    // One line per class with work so far, for the [perf] log.
+    std::string report() const;
+
+    static const char* class_name(Class c);
+
+private:
+    void release(Class c, std::chrono::steady_clock::time_point t0);
+    bool can_run_locked(Class c) const;
+
+    const int device_;
+    const int max_concurrent_;
+
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    int active_ = 0;
+    int waiting_[kClasses] = {};
+    ClassStats stats_[kClasses];
+};
+
+// Lease for c from arb, or an empty lease when arb is null (GPU unused).
+inline GpuArbiter::Lease gpu_lease(GpuArbiter* arb, GpuArbiter::Class c) {
+    return arb ? arb->acquire(c) : GpuArbiter::Lease{};
+}
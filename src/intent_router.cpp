@@ -0,0 +1,496 @@
+// intent_router.cpp
+#include "intent_router.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <utility>
+
+namespace {
+
+using Words = std::vector<std::string>;
+
+Words split_words(const std::string& s) {
+    Words w;
+    std::istringstream in(s);
+    std::string t;
+    while (in >> t) w.push_back(t);
+    return w;
+}
+
+struct Tok {
+    enum class Kind { Word, Num, Dur };
+    Kind kind = Kind::Word;
+    bool optional = false;
+    std::vector<std::string> alts;   // Kind::Word
+};
+
+std::vector<Tok> compile(const char* pattern) {
+    std::vector<Tok> out;
+    for (std::string t : split_words(pattern)) {
+        Tok tok;
+        if (t.size() > 2 && t.front() == '[' && t.back() == ']') {
+            tok.optional = true;
+            t = t.substr(1, t.size() - 2);
+        }
+        if (t == "<n>") {
+            tok.kind = Tok::Kind::Num;
+        } else if (t == "<dur>") {
+            tok.kind = Tok::Kind::Dur;
+        } else {
+            size_t b = 0;
+            while (b <= t.size()) {
+                size_t e = t.find('|', b);
+                if (e == std::string::npos) e = t.size();
+                tok.alts.push_back(t.substr(b, e - b));
+                b = e + 1;
+            }
+        }
+        out.push_back(std::move(tok));
+    }
+    return out;
+}
+
+// ---- numbers and durations ----
+// Each consumer appends every way the words at i can be read as one item:
+// (index after it, value). The matcher backtracks over the candidates.
+using Cands = std::vector<std::pair<size_t, long>>;
+
+int small_number(const std::string& w) {
+    static const char* const kOnes[] = {
+        "zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine",
+        "ten", "eleven", "twelve", "thirteen", "fourteen", "fifteen", "sixteen",
+        "seventeen", "eighteen", "nineteen",
+    };
+    for (int i = 0; i < 20; ++i) if (w == kOnes[i]) return i;
+    return -1;
+}
+
+int tens_number(const std::string& w) {
+    static const char* const kTens[] = {
+        "twenty", "thirty", "forty", "fifty", "sixty", "seventy", "eighty", "ninety",
+    };
+    for (int i = 0; i < 8; ++i) if (w == kTens[i]) return (i + 2) * 10;
+    return -1;
+}
+
+// 0..99 in words: "seven", "forty", "forty two".
+void below_hundred_at(const Words& w, size_t i, Cands& out) {
+    if (i >= w.size()) return;
+    const int s = small_number(w[i]);
+    if (s >= 0) { out.emplace_back(i + 1, s); return; }
+    const int t = tens_number(w[i]);
+    if (t < 0) return;
+    out.emplace_back(i + 1, t);
+    if (i + 1 < w.size()) {
+        const int u = small_number(w[i + 1]);
+        if (u >= 1 && u <= 9) out.emplace_back(i + 2, t + u);
+    }
+}
+
+void number_at(const Words& w, size_t i, Cands& out) {
+    if (i >= w.size()) return;
+    const std::string& t = w[i];
+    if (std::all_of(t.begin(), t.end(), [](unsigned char c){ return std::isdigit(c); })) {
+        if (t.size() <= 6) out.emplace_back(i + 1, std::atol(t.c_str()));
+        return;
+    }
+
+    Cands lo;
+    if (t == "a" || t == "an") lo.emplace_back(i + 1, 1);   // "a minute", "a hundred"
+    else                       below_hundred_at(w, i, lo);
+    for (const auto& c : lo) {
+        out.push_back(c);
+        // "two hundred [and] [forty two]"
+        if (c.second >= 1 && c.second <= 9 && c.first < w.size() && w[c.first] == "hundred") {
+            const long h = c.second * 100;
+            size_t j = c.first + 1;
+            out.emplace_back(j, h);
+            if (j < w.size() && w[j] == "and") ++j;
+            Cands rest;
+            below_hundred_at(w, j, rest);
+            for (const auto& r : rest) if (r.second > 0) out.emplace_back(r.first, h + r.second);
+        }
+    }
+}
+
+long unit_seconds(const std::string& w) {
+    if (w == "second" || w == "seconds" || w == "sec" || w == "secs") return 1;
+    if (w == "minute" || w == "minutes" || w == "min" || w == "mins") return 60;
+    if (w == "hour" || w == "hours" || w == "hr" || w == "hrs") return 3600;
+    return 0;
+}
+
+// One "<n> [and a half] <unit>", "<n> <unit> and a half" or "half [an|a] <unit>".
+void dur_part_at(const Words& w, size_t i, Cands& out) {
+    if (i >= w.size()) return;
+    if (w[i] == "half") {
+        size_t j = i + 1;
+        if (j < w.size() && (w[j] == "an" || w[j] == "a")) ++j;
+        if (j < w.size()) {
+            const long u = unit_seconds(w[j]);
+            if (u) out.emplace_back(j + 1, u / 2);
+        }
+        return;
+    }
+    Cands nums;
+    number_at(w, i, nums);
+    for (const auto& n : nums) {
+        size_t j = n.first;
+        long half = 0;
+        if (j + 2 < w.size() && w[j] == "and" && w[j + 1] == "a" && w[j + 2] == "half") {
+            j += 3;
+            half = 1;
+        }
+        if (j >= w.size()) continue;
+        const long u = unit_seconds(w[j]);
+        if (!u) continue;
+        out.emplace_back(j + 1, n.second * u + half * u / 2);
+        // "an hour and a half"
+        if (!half && j + 3 < w.size() && w[j + 1] == "and" && w[j + 2] == "a" && w[j + 3] == "half") {
+            out.emplace_back(j + 4, n.second * u + u / 2);
+        }
+    }
+}
+
+// Parts joined by an optional "and": "1 hour and 30 minutes", "2 minutes 10 seconds".
+void duration_at(const Words& w, size_t i, Cands& out, int depth = 0) {
+    Cands parts;
+    dur_part_at(w, i, parts);
+    for (const auto& p : parts) {
+        out.push_back(p);
+        if (depth >= 2) continue;
+        size_t j = p.first;
+        if (j < w.size() && w[j] == "and") ++j;
+        Cands more;
+        duration_at(w, j, more, depth + 1);
+        for (const auto& m : more) out.emplace_back(m.first, p.second + m.second);
+    }
+}
+
+bool match(const std::vector<Tok>& pat, size_t pi, const Words& w, size_t wi, std::vector<long>& caps) {
+    if (pi == pat.size()) return wi == w.size();
+    const Tok& t = pat[pi];
+
+    // Greedy: consume if possible, fall back to skipping an optional token.
+    if (t.kind == Tok::Kind::Word) {
+        if (wi < w.size() && std::find(t.alts.begin(), t.alts.end(), w[wi]) != t.alts.end() &&
+            match(pat, pi + 1, w, wi + 1, caps)) {
+            return true;
+        }
+    } else {
+        Cands cands;
+        if (t.kind == Tok::Kind::Num) number_at(w, wi, cands);
+        else                          duration_at(w, wi, cands);
+        // Longest reading first ("twenty five minutes" before "twenty ...").
+        std::stable_sort(cands.begin(), cands.end(),
+                         [](const Cands::value_type& a, const Cands::value_type& b) { return a.first > b.first; });
+        for (const auto& c : cands) {
+            caps.push_back(c.second);
+            if (match(pat, pi + 1, w, c.first, caps)) return true;
+            caps.pop_back();
+        }
+    }
+    return t.optional && match(pat, pi + 1, w, wi, caps);
+}
+
+// Politeness around the command that changes nothing about its meaning.
+void strip_filler(Words& w) {
+    static const char* const kLead1[] = { "please", "hey", "ok", "okay", "so", "um", "uh", "and" };
+    static const char* const kLead2[] = { "can", "could", "would", "will" };
+    static const char* const kTrail1[] = { "please", "thanks", "now" };
+    bool changed = true;
+    while (changed && !w.empty()) {
+        changed = false;
+        for (const char* f : kLead1) {
+            if (!w.empty() && w.front() == f) { w.erase(w.begin()); changed = true; }
+        }
+        for (const char* f : kLead2) {
+            if (w.size() >= 2 && w[0] == f && w[1] == "you") { w.erase(w.begin(), w.begin() + 2); changed = true; }
+        }
+        for (const char* f : kTrail1) {
+            if (w.size() > 1 && w.back() == f) { w.pop_back(); changed = true; }
+        }
+        if (w.size() > 2 && w[w.size() - 2] == "thank" && w.back() == "you") { w.resize(w.size() - 2); changed = true; }
+        if (w.size() > 2 && w[w.size() - 2] == "for" && w.back() == "me") { w.resize(w.size() - 2); changed = true; }
+    }
+}
+
+std::string plural(long n, const char* unit) {
+    return std::to_string(n) + " " + unit + (n == 1 ? "" : "s");
+}
+
+// "1 hour and 30 minutes", "45 seconds".
+std::string spoken_duration(long secs) {
+    std::vector<std::string> parts;
+    if (secs >= 3600)      parts.push_back(plural(secs / 3600, "hour"));
+    if (secs % 3600 >= 60) parts.push_back(plural(secs % 3600 / 60, "minute"));
+    if (secs % 60 || parts.empty()) parts.push_back(plural(secs % 60, "second"));
+    std::string s;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        if (i) s += (i + 1 == parts.size()) ? " and " : ", ";
+        s += parts[i];
+    }
+    return s;
+}
+
+std::tm local_now() {
+    const std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_r(&t, &tm);
+    return tm;
+}
+
+} // namespace
+
+struct IntentRouter::Rule {
+    const char* intent;
+    std::vector<Tok> pat;
+    std::function<std::string(const Captures&)> fn;
+};
+
+IntentRouter::IntentRouter(const Params& p) : p_(p), volume_(std::clamp(p.volume, 0, 100)) {
+    using C = const Captures&;
+    auto add = [&](const char* intent, std::initializer_list<const char*> patterns,
+                   std::function<std::string(C)> fn) {
+        for (const char* pat : patterns) rules_.push_back(Rule{intent, compile(pat), fn});
+    };
+
+    // First match wins; more specific rules (timers) come before the
+    // catch-all "stop" / "cancel".
+    add("time", {
+        "[do] [you] [know] what time [is] [it] [is]",
+        "what [is|s] the time",
+        "[tell] [me] the time",
+        "[what] [is|s] the current time",
+    }, [this](C c) { return on_time(c); });
+
+    add("date", {
+        "what [is|s] [the] [today] [s] date [today] [is] [it]",
+        "what day [of] [the] [week] [is] [it] [is] [today]",
+        "what [is|s] today",
+        "[tell] [me] the date",
+        "[what] [is|s] today s date",
+    }, [this](C c) { return on_date(c); });
+
+    add("timer_set", {
+        "[set|start] [a|the|me] [a] timer for <dur>",
+        "[set|start] [a|an] <dur> timer",
+        "timer <dur>",
+    }, [this](C c) { return on_timer_set(c); });
+
+    add("timer_cancel", {
+        "cancel|stop|clear|delete|end [the|my|all] [the] [my] timer|timers",
+        "turn off [the|my] timer|timers",
+    }, [this](C c) { return on_timer_cancel(c); });
+
+    add("timer_left", {
+        "how [much] [time|long] [is] [left|remaining] [on] [the|my] timer",
+        "how much time [is] [left|remaining]",
+        "how long [is] left",
+        "[how] [much] time left",
+        "how much longer",
+    }, [this](C c) { return on_timer_left(c); });
+
+    add("volume_set", {
+        "[set] [the] volume [to] <n> [percent]",
+        "[set] [the] volume [level] [to] <n> [percent]",
+    }, [this](C c) { return on_volume_set(c); });
+
+    add("volume_up", {
+        "[turn] [the] volume up",
+        "turn [it|yourself] up",
+        "turn up [the] volume",
+        "increase|raise [the] volume",
+        "[be|speak|talk] louder",
+        "speak up",
+    }, [this](C) { return on_volume_step(+1); });
+
+    add("volume_down", {
+        "[turn] [the] volume down",
+        "turn [it|yourself] down",
+        "turn down [the] volume",
+        "decrease|lower|reduce [the] volume",
+        "[be|speak|talk] quieter|softer",
+    }, [this](C) { return on_volume_step(-1); });
+
+    add("volume_query", {
+        "what [is|s] the volume [level] [at]",
+        "how loud [are] [you|is] [it] [the] [volume]",
+    }, [this](C c) { return on_volume_query(c); });
+
+    add("repeat", {
+        "repeat [that|it|yourself|the] [answer|last] [answer] [again]",
+        "say [that|it] again",
+        "what did you [just] say",
+        "what was that",
+        "come again",
+        "pardon [me]",
+        "sorry what",
+    }, [this](C c) { return on_repeat(c); });
+
+    add("stop", {
+        "stop|cancel|quiet|silence|shush|enough|nevermind",
+        "never mind",
+        "stop talking|it|that",
+        "be quiet",
+        "shut up",
+        "forget [it|that|about] [it]",
+        "that [is|s] [enough|all]",
+        "that will do",
+    }, [](C) { return std::string(); });
+
+    timer_thread_ = std::thread([this]{ timer_loop(); });
+}
+
+IntentRouter::~IntentRouter() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (timer_thread_.joinable()) timer_thread_.join();
+}
+
+bool IntentRouter::route(const std::string& command, Result& out) {
+    if (!p_.enabled) return false;
+    const auto t0 = Clock::now();
+
+    Words w = split_words(command);
+    strip_filler(w);
+    if (w.empty() || w.size() > 16) return false;   // long: a real question
+
+    Captures caps;
+    for (const Rule& r : rules_) {
+        caps.clear();
+        if (!match(r.pat, 0, w, 0, caps)) continue;
+        out.intent = r.intent;
+        out.reply = r.fn(caps);
+        out.match_us = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+        return true;
+    }
+    return false;
+}
+
+void IntentRouter::set_last_reply(const std::string& text) {
+    std::lock_guard<std::mutex> lk(m_);
+    last_reply_ = text;
+}
+
+int IntentRouter::volume() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return volume_;
+}
+
+std::string IntentRouter::on_time(const Captures&) {
+    const std::tm tm = local_now();
+    const int h12 = tm.tm_hour % 12 == 0 ? 12 : tm.tm_hour % 12;
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "It's %d:%02d %s.", h12, tm.tm_min, tm.tm_hour < 12 ? "AM" : "PM");
+    return buf;
+}
+
+std::string IntentRouter::on_date(const Captures&) {
+    const std::tm tm = local_now();
+    char day[64];
+    std::strftime(day, sizeof(day), "%A, %B", &tm);
+    return std::string("Today is ") + day + " " + std::to_string(tm.tm_mday) + ".";
+}
+
+std::string IntentRouter::on_volume_step(int dir) {
+    int v;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        const int want = std::clamp(volume_ + dir * p_.volume_step, 0, 100);
+        if (want == volume_) return dir > 0 ? "Volume is already at maximum." : "Volume is already at minimum.";
+        volume_ = v = want;
+    }
+    if (volume_fn_) volume_fn_(v);
+    return "Volume " + std::to_string(v) + " percent.";
+}
+
+std::string IntentRouter::on_volume_set(const Captures& c) {
+    const long want = c.empty() ? -1 : c[0];
+    if (want < 0 || want > 100) return "Volume goes from 0 to 100.";
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        volume_ = (int)want;
+    }
+    if (volume_fn_) volume_fn_((int)want);
+    return "Volume " + std::to_string(want) + " percent.";
+}
+
+std::string IntentRouter::on_volume_query(const Captures&) {
+    return "Volume is at " + std::to_string(volume()) + " percent.";
+}
+
+std::string IntentRouter::on_timer_set(const Captures& c) {
+    const long secs = c.empty() ? 0 : c[0];
+    if (secs <= 0) return "How long should the timer be?";
+    if (secs > p_.max_timer_sec) return "I can set timers for up to " + spoken_duration(p_.max_timer_sec) + ".";
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        if ((int)timers_.size() >= p_.max_timers) return "Too many timers are running already.";
+        Timer t;
+        t.id = next_timer_id_++;
+        t.due = Clock::now() + std::chrono::seconds(secs);
+        t.seconds = secs;
+        timers_.insert(std::upper_bound(timers_.begin(), timers_.end(), t,
+                                        [](const Timer& a, const Timer& b) { return a.due < b.due; }),
+                       t);
+    }
+    cv_.notify_all();
+    std::fprintf(stderr, "[intent] timer set secs=%ld\n", secs);
+    return "Timer set for " + spoken_duration(secs) + ".";
+}
+
+std::string IntentRouter::on_timer_cancel(const Captures&) {
+    size_t n;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        n = timers_.size();
+        timers_.clear();
+    }
+    cv_.notify_all();
+    if (n == 0) return "There's no timer running.";
+    return n == 1 ? "Timer cancelled." : plural((long)n, "timer") + " cancelled.";
+}
+
+std::string IntentRouter::on_timer_left(const Captures&) {
+    std::lock_guard<std::mutex> lk(m_);
+    if (timers_.empty()) return "There's no timer running.";
+    const auto left = std::chrono::duration_cast<std::chrono::seconds>(timers_.front().due - Clock::now());
+    const std::string s = spoken_duration(std::max<long>(1, (long)left.count()));
+    if (timers_.size() == 1) return s + " left.";
+    return plural((long)timers_.size(), "timer") + " running. The next one ends in " + s + ".";
+}
+
+std::string IntentRouter::on_repeat(const Captures&) {
+    std::lock_guard<std::mutex> lk(m_);
+    return last_reply_.empty() ? "I haven't said anything yet." : last_reply_;
+}
+
+void IntentRouter::timer_loop() {
+    std::unique_lock<std::mutex> lk(m_);
+    while (!stop_) {
+        if (timers_.empty()) {
+            cv_.wait(lk);
+            continue;
+        }
+        const auto due = timers_.front().due;
+        if (Clock::now() < due) {
+            cv_.wait_until(lk, due);
+            continue;
+        }
+        const Timer t = timers_.front();
+        timers_.erase(timers_.begin());
+
+        lk.unlock();
+        std::fprintf(stderr, "[intent] timer done secs=%ld\n", t.seconds);
+        if (announce_) announce_("Your timer for " + spoken_duration(t.seconds) + " is done.");
+        lk.lock();
+    }
+}
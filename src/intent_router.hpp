@@ -0,0 +1,113 @@
+// intent_router.hpp
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * IntentRouter
+ *
+ * Deterministic fast path in front of the LLM. The command left over by
+ * strip_invocation (already normalize()d: lowercase, no punctuation) is
+ * matched against a table of word patterns compiled once at construction.
+ * A hit is answered by a C++ handler in microseconds and never reaches
+ * LlamaBrain, so the GPU stays free for questions that need the model.
+ * A pattern must cover the whole command (after dropping politeness such
+ * as "can you ... please"); anything else goes to the LLM as before.
+ *
+ * Pattern syntax, one token per word:
+ *   word      literal             a|b|c    any one of the alternatives
+ *   [tok]     optional token      <n>      number: digits or words
+ *   <dur>     duration: "5 minutes", "an hour and 30 seconds", ...
+ *
+ * Intents: time, date, stop, volume (up/down/set/query), timers (set,
+ * cancel, time left) and repeat-last-answer. Routed turns are not added
+ * to the LLM's conversation history.
+ *
+ * Timers run on the router's own thread; when one expires the announce
+ * callback is handed the text to speak. route() and set_last_reply() may
+ * be called from different threads.
+ */
+class IntentRouter {
+public:
+    struct Params {
+        bool enabled       = true;
+        int  volume        = 100;   // initial output volume, percent
+        int  volume_step   = 10;    // per "louder" / "quieter"
+        int  max_timers    = 8;
+        int  max_timer_sec = 24 * 3600;
+    };
+
+    struct Result {
+        std::string intent;         // e.g. "time", "timer_set"; empty = not routed
+        std::string reply;          // text to speak; empty = say nothing (stop)
+        double      match_us = 0.0; // time spent in route()
+    };
+
+    using AnnounceFn = std::function<void(const std::string& text)>;
+    using VolumeFn   = std::function<void(int percent)>;
+
+    explicit IntentRouter(const Params& p);
+    ~IntentRouter();
+
+    IntentRouter(const IntentRouter&) = delete;
+    IntentRouter& operator=(const IntentRouter&) = delete;
+
+    // Match a normalized command. True (and out filled in) if it was
+    // handled here; false means it should go to the LLM.
+    bool route(const std::string& command, Result& out);
+
+    // What was said last (LLM or routed), for "repeat that".
+    void set_last_reply(const std::string& text);
+
+    // Install before the first route(): called on the timer thread when a
+    // timer expires, and on the routing thread when the volume changes.
+    void set_announce(AnnounceFn fn) { announce_ = std::move(fn); }
+    void set_volume_fn(VolumeFn fn)  { volume_fn_ = std::move(fn); }
+
+    int volume() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Captures = std::vector<long>;   // <n> values and <dur> seconds, in order
+    struct Rule;
+
+    std::string on_time(const Captures& c);
+    std::string on_date(const Captures& c);
+    std::string on_volume_step(int dir);
+    std::string on_volume_set(const Captures& c);
+    std::string on_volume_query(const Captures& c);
+    std::string on_timer_set(const Captures& c);
+    std::string on_timer_cancel(const Captures& c);
+    std::string on_timer_left(const Captures& c);
+    std::string on_repeat(const Captures& c);
+
+    void timer_loop();
+
+    Params p_;
+    std::vector<Rule> rules_;
+
+    struct Timer {
+        uint64_t id = 0;
+        Clock::time_point due{};
+        long seconds = 0;           // as requested
+    };
+
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<Timer> timers_;     // sorted by due
+    uint64_t next_timer_id_ = 1;
+    bool stop_ = false;
+    int volume_ = 100;
+    std::string last_reply_;
+
+    AnnounceFn announce_;
+    VolumeFn volume_fn_;
+    std::thread timer_thread_;
+};
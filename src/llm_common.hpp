@@ -0,0 +1,257 @@
+// llm_common.hpp
+#pragma once
+
+// Internal to the llama TUs (llm_llama.cpp, llm_sessions.cpp): pulls in
+// llama.h and the ggml headers, so nothing else should include it
+// (edna_microbench aside, which times token_to_piece on its own).
+
+#include "llm_llama.hpp"
+#include "gpu_arbiter.hpp"
+
+#include <llama.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llm {
+
+inline std::string trim_ws(const std::string& s) {
+    size_t a = 0, b = s.size();
+    while (a < b && std::isspace((unsigned char)s[a])) a++;
+    while (b > a && std::isspace((unsigned char)s[b - 1])) b--;
+    return s.substr(a, b - a);
+}
+
+inline double ms_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+inline void batch_reset(llama_batch& b) { b.n_tokens = 0; }
+
+inline void batch_add(llama_batch& b, llama_token id, llama_pos pos, bool logits,
+                      llama_seq_id seq = 0) {
+    const int32_t i = b.n_tokens;
+    b.token[i]     = id;
+    b.pos[i]       = pos;
+    b.n_seq_id[i]  = 1;
+    b.seq_id[i][0] = seq;
+    b.logits[i]    = logits;
+    b.n_tokens++;
+}
+
+// Two-pass tokenization (works across many llama.cpp revisions)
+inline std::vector<llama_token> tokenize_prompt(const llama_vocab* vocab,
+                                                const std::string& text,
+                                                bool add_special) {
+    int32_t n = llama_tokenize(vocab,
+                               text.c_str(),
+                               (int32_t)text.size(),
+                               nullptr,
+                               0,
+                               add_special,
+                               /*parse_special=*/true);
+    if (n < 0) n = -n;
+
+    std::vector<llama_token> toks((size_t)n);
+    int32_t n2 = llama_tokenize(vocab,
+                                text.c_str(),
+                                (int32_t)text.size(),
+                                toks.data(),
+                                (int32_t)toks.size(),
+                                add_special,
+                                /*parse_special=*/true);
+    if (n2 < 0) n2 = -n2;
+    toks.resize((size_t)n2);
+    return toks;
+}
+
+// Detokenize into out, reusing its storage: called once per generated
+// token, so after the first few tokens this never allocates.
+inline void token_to_piece(const llama_vocab* vocab, llama_token tok, std::string& out) {
+    if (out.capacity() < 64) out.reserve(64);
+    out.resize(out.capacity());
+
+    int32_t n = llama_token_to_piece(vocab, tok,
+                                     out.data(),
+                                     (int32_t)out.size(),
+                                     /*lstrip=*/0,
+                                     /*special=*/true);
+    if (n < 0) {
+        out.resize((size_t)(-n));
+        n = llama_token_to_piece(vocab, tok,
+                                 out.data(),
+                                 (int32_t)out.size(),
+                                 0, true);
+    }
+
+    if (n > 0) out.resize((size_t)n);
+    else out.clear();
+}
+
+// Backend init once-per-process (avoid repeated init/free thrash), shared
+// by every engine in the process.
+inline std::once_flag   g_backend_once;
+inline std::mutex       g_backend_mu;
+inline std::atomic<int> g_backend_refcnt{0};
+
+inline void backend_acquire() {
+    std::call_once(g_backend_once, []() {
+        llama_backend_init();
+    });
+    g_backend_refcnt.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void backend_release() {
+    const int n = g_backend_refcnt.fetch_sub(1, std::memory_order_relaxed) - 1;
+    if (n == 0) {
+        std::lock_guard<std::mutex> lk(g_backend_mu);
+        llama_backend_free();
+    }
+}
+
+inline llama_sampler* make_sampler() {
+    const uint32_t seed = 0xC0FFEEu;  // or time-based if you prefer
+    const float temp    = 0.7f;
+    const int   top_k   = 40;
+    const float top_p   = 0.9f;
+
+    llama_sampler* chain =
+        llama_sampler_chain_init(llama_sampler_chain_default_params());
+    if (!chain) return nullptr;
+
+    // Order: penalties (optional) -> temp -> top-k -> top-p -> dist
+    // Keep it simple until stable.
+    llama_sampler_chain_add(chain, llama_sampler_init_temp(temp));
+    llama_sampler_chain_add(chain, llama_sampler_init_top_k(top_k));
+    llama_sampler_chain_add(chain, llama_sampler_init_top_p(top_p, 1));
+
+    // REQUIRED: actually select a token
+    llama_sampler_chain_add(chain, llama_sampler_init_dist(seed));
+
+    return chain;
+}
+
+inline bool parse_kv_type(const std::string& s, ggml_type& out) {
+    if (s == "f16")  { out = GGML_TYPE_F16;  return true; }
+    if (s == "q8_0") { out = GGML_TYPE_Q8_0; return true; }
+    if (s == "q4_0") { out = GGML_TYPE_Q4_0; return true; }
+    return false;
+}
+
+// Model load parameters from LlamaBrain::Params.
+inline llama_model_params model_params(const LlamaBrain::Params& p) {
+    llama_model_params mp = llama_model_default_params();
+    mp.n_gpu_layers = p.n_gpu_layers;
+    mp.main_gpu = p.main_gpu;
+    mp.use_mmap = p.use_mmap;
+    mp.use_mlock = p.use_mlock;
+    return mp;
+}
+
+// Context parameters from LlamaBrain::Params (threads, batching, KV cache
+// type, flash attention). False on an unknown kv_type.
+inline bool context_params(const LlamaBrain::Params& p, llama_context_params& cp) {
+    ggml_type kv_type = GGML_TYPE_F16;
+    if (!parse_kv_type(p.kv_type, kv_type)) return false;
+
+    cp = llama_context_default_params();
+    cp.n_ctx     = p.n_ctx;
+    cp.n_threads = p.n_threads;
+    cp.n_threads_batch = p.n_threads_batch > 0 ? p.n_threads_batch : p.n_threads;
+    cp.n_batch   = p.n_batch;
+    cp.n_ubatch  = p.n_ubatch > 0 ? std::min(p.n_ubatch, p.n_batch) : p.n_batch;
+    cp.type_k    = kv_type;
+    cp.type_v    = kv_type;
+    cp.flash_attn_type = p.flash_attn < 0 ? LLAMA_FLASH_ATTN_TYPE_AUTO
+                       : p.flash_attn > 0 ? LLAMA_FLASH_ATTN_TYPE_ENABLED
+                                          : LLAMA_FLASH_ATTN_TYPE_DISABLED;
+    if (kv_type != GGML_TYPE_F16 && p.flash_attn == 0) {
+        std::fprintf(stderr, "[llm] kv_type=%s needs flash attention; enabling it\n", p.kv_type.c_str());
+        cp.flash_attn_type = LLAMA_FLASH_ATTN_TYPE_ENABLED;
+    }
+    return true;
+}
+
+inline const char* flash_attn_name(const llama_context_params& cp) {
+    return cp.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_AUTO    ? "auto" :
+           cp.flash_attn_type == LLAMA_FLASH_ATTN_TYPE_ENABLED ? "on" : "off";
+}
+
+inline double mib(double bytes) { return bytes / (1024.0 * 1024.0); }
+
+// What a model costs resident: weights plus its KV cache for n_ctx (K and V,
+// every layer; GQA models store n_head_kv heads). The compute buffers come on
+// top; llama_memory_breakdown_print() has the per-device totals.
+inline void print_memory(const char* what, const llama_model* model, const llama_context_params& cp) {
+    const int64_t n_layer   = llama_model_n_layer(model);
+    const int64_t n_head    = std::max<int32_t>(1, llama_model_n_head(model));
+    const int64_t n_head_kv = llama_model_n_head_kv(model);
+    const int64_t n_embd_kv = llama_model_n_embd(model) / n_head * n_head_kv;
+    const double kv_bytes = (double)cp.n_ctx * (double)n_layer *
+                            (double)(ggml_row_size(cp.type_k, n_embd_kv) + ggml_row_size(cp.type_v, n_embd_kv));
+
+    char desc[128] = {0};
+    llama_model_desc(model, desc, sizeof(desc));
+    std::fprintf(stderr, "[llm] memory %s (%s, %.2fB params): weights=%.1f MiB kv=%.1f MiB "
+                         "(n_ctx=%u k=%s v=%s, %.1f KiB/token)\n",
+                 what, desc, (double)llama_model_n_params(model) / 1e9, mib((double)llama_model_size(model)),
+                 mib(kv_bytes), cp.n_ctx, ggml_type_name(cp.type_k), ggml_type_name(cp.type_v),
+                 cp.n_ctx ? kv_bytes / cp.n_ctx / 1024.0 : 0.0);
+}
+
+// The prompt is split in two so the system prefix can stay resident in the KV
+// cache across turns: only the per-turn suffix is tokenized and decoded each time.
+inline std::string build_system_prefix(const LlamaBrain::Params& p) {
+    std::string s = p.system_prompt;
+    if (!s.empty() && s.back() != '\n') s += "\n";
+    return s;
+}
+
+inline std::string build_turn(const std::string& user_text) {
+    // Keep this simple and predictable (fast, low-token).
+    // You can swap to chat templates later if you want model-specific formatting.
+    std::string s;
+    s.reserve(user_text.size() + 16);
+
+    s += "User: ";
+    s += user_text;
+    s += "\nEdna:";
+
+    return s;
+}
+
+// One llama_decode under a GPU lease. Leases are per call (per prefill chunk
+// or generated token) so higher-priority work can run between them.
+inline int decode_gpu(llama_context* ctx, GpuArbiter* gpu, llama_batch& batch) {
+    GpuArbiter::Lease lease = gpu_lease(gpu, GpuArbiter::Class::LlmDecode);
+    return llama_decode(ctx, batch);
+}
+
+// Decode toks[0..n) into seq starting at pos, filling each batch up to
+// n_batch tokens. Only the very last token requests logits. Returns false
+// on decode failure.
+inline bool prefill_chunked(llama_context* ctx, GpuArbiter* gpu, llama_batch& batch, int32_t n_batch,
+                            const llama_token* toks, size_t n, llama_pos& pos, llama_seq_id seq = 0) {
+    size_t i = 0;
+    while (i < n) {
+        batch_reset(batch);
+
+        const size_t take = std::min<size_t>((size_t)n_batch, n - i);
+        for (size_t j = 0; j < take; j++) {
+            const bool want_logits = (i + j + 1 == n);
+            batch_add(batch, toks[i + j], pos++, want_logits, seq);
+        }
+
+        if (decode_gpu(ctx, gpu, batch) != 0) return false;
+        i += take;
+    }
+    return true;
+}
+
+} // namespace llm
@@ -1,168 +1,283 @@
 #include "llm_llama.hpp"
+#include "gpu_arbiter.hpp"
 
-// llama.h drags ggml headers too. Keep it quarantined in this TU.
-#include <llama.h>
+// llama.h drags ggml headers too. Keep it quarantined in the llm TUs.
+#include "llm_common.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <mutex>
 #include <string>
 #include <vector>
 
+using namespace llm;
+
 /* ------------------------------------------------------------ */
 /* Helpers                                                      */
 /* ------------------------------------------------------------ */
 
-static std::string trim_ws(const std::string& s) {
-    size_t a = 0, b = s.size();
-    while (a < b && std::isspace((unsigned char)s[a])) a++;
-    while (b > a && std::isspace((unsigned char)s[b - 1])) b--;
-    return s.substr(a, b - a);
+// A draft model is only usable if it tokenizes the same way: its proposals
+// are fed to the main model as token ids. Same check as llama.cpp's
+// speculative example (type, special tokens, shared token texts).
+static bool vocab_compatible(const llama_vocab* a, const llama_vocab* b, std::string& why) {
+    if (llama_vocab_type(a) != llama_vocab_type(b)) {
+        why = "tokenizer type differs";
+        return false;
+    }
+    if (llama_vocab_bos(a) != llama_vocab_bos(b) || llama_vocab_eos(a) != llama_vocab_eos(b)) {
+        why = "BOS/EOS tokens differ";
+        return false;
+    }
+    const int32_t na = llama_vocab_n_tokens(a);
+    const int32_t nb = llama_vocab_n_tokens(b);
+    if (std::abs(na - nb) > 128) {
+        why = "vocab sizes differ (" + std::to_string(na) + " vs " + std::to_string(nb) + ")";
+        return false;
+    }
+    for (int32_t t = 5; t < std::min(na, nb); t++) {
+        const char* ta = llama_vocab_get_text(a, t);
+        const char* tb = llama_vocab_get_text(b, t);
+        if (std::strcmp(ta ? ta : "", tb ? tb : "") != 0) {
+            why = "token " + std::to_string(t) + " differs";
+            return false;
+        }
+    }
+    return true;
 }
 
-static void batch_reset(llama_batch& b) { b.n_tokens = 0; }
+/* ------------------------------------------------------------ */
+/* LlamaBrain Impl                                              */
+/* ------------------------------------------------------------ */
 
-static void batch_add(llama_batch& b, llama_token id, llama_pos pos, bool logits) {
-    const int32_t i = b.n_tokens;
-    b.token[i]     = id;
-    b.pos[i]       = pos;
-    b.n_seq_id[i]  = 1;
-    b.seq_id[i][0] = 0;
-    b.logits[i]    = logits;
-    b.n_tokens++;
-}
+struct LlamaBrain::Impl {
+    Params p{};
 
-// Two-pass tokenization (works across many llama.cpp revisions)
-static std::vector<llama_token> tokenize_prompt(const llama_vocab* vocab,
-                                                const std::string& text,
-                                                bool add_special) {
-    int32_t n = llama_tokenize(vocab,
-                               text.c_str(),
-                               (int32_t)text.size(),
-                               nullptr,
-                               0,
-                               add_special,
-                               /*parse_special=*/true);
-    if (n < 0) n = -n;
-
-    std::vector<llama_token> toks((size_t)n);
-    int32_t n2 = llama_tokenize(vocab,
-                                text.c_str(),
-                                (int32_t)text.size(),
-                                toks.data(),
-                                (int32_t)toks.size(),
-                                add_special,
-                                /*parse_special=*/true);
-    if (n2 < 0) n2 = -n2;
-    toks.resize((size_t)n2);
-    return toks;
-}
+    llama_model* model = nullptr;
+    const llama_vocab* vocab = nullptr;
 
-static std::string token_to_piece(const llama_vocab* vocab, llama_token tok) {
-    std::string out;
-    out.resize(256);
-
-    int32_t n = llama_token_to_piece(vocab, tok,
-                                     out.data(),
-                                     (int32_t)out.size(),
-                                     /*lstrip=*/0,
-                                     /*special=*/true);
-    if (n < 0) {
-        out.resize((size_t)(-n));
-        n = llama_token_to_piece(vocab, tok,
-                                 out.data(),
-                                 (int32_t)out.size(),
-                                 0, true);
-    }
-
-    if (n > 0) out.resize((size_t)n);
-    else out.clear();
-    return out;
-}
+    llama_context_params cparams{};
+    llama_context* ctx = nullptr;
 
-// Backend init once-per-process (avoid repeated init/free thrash)
-static std::once_flag g_backend_once;
-static std::mutex     g_backend_mu;
-static std::atomic<int> g_backend_refcnt{0};
+    llama_sampler* sampler = nullptr;
+
+    // System prompt tokens, decoded once into seq 0 at positions [0, n_prefix).
+    std::vector<llama_token> prefix_toks;
+    llama_pos n_prefix = 0;
+    bool prefix_resident = false;
+
+    // Conversation history lives in seq 0 right after the prefix, one entry
+    // per completed turn ("User: ...\nEdna: ...\n") at positions [start, end).
+    // n_past is the next free position.
+    struct Turn { llama_pos start; llama_pos end; };
+    std::deque<Turn> turns;
+    llama_pos n_past = 0;
+
+    // Tokens that close an assistant turn in the KV cache.
+    std::vector<llama_token> turn_end_toks;
+
+    // Tokens in seq 0 by position, mirroring the KV cache; the draft model
+    // syncs its own cache against this.
+    std::vector<llama_token> kv_toks;
+
+    // Speculative decoding (Params::draft_model_path). The draft context
+    // holds the same conversation as ctx, brought up to date lazily before
+    // each proposal.
+    struct Draft {
+        llama_model* model = nullptr;
+        llama_context* ctx = nullptr;
+        std::vector<llama_token> kv_toks;    // what ctx's seq 0 holds, by position
+        std::vector<llama_token> pending;    // scratch: tokens to decode in sync()
+        int32_t n_vocab = 0;
+    } draft;
+
+    mutable std::mutex stats_mu;
+    Stats stats{};
+
+    GpuArbiter* gpu = nullptr;   // null: no GPU arbitration
+
+    // Advanced by cancel() from any thread; polled once per generated token.
+    std::atomic<uint64_t> cancel_gen{0};
+
+    bool decode_prefix(llama_batch& batch, int32_t n_batch);
+    void drop_history();
+    int  make_room(int32_t n_ctx, int32_t need);
+
+    void draft_reset();
+    bool draft_sync(llama_batch& batch, int32_t n_batch, const llama_token* next);
+    void draft_propose(llama_batch& batch, int32_t n_batch, llama_token next, int max,
+                       std::vector<llama_token>& out);
+};
 
-static void backend_acquire() {
-    std::call_once(g_backend_once, []() {
-        llama_backend_init();
-    });
-    g_backend_refcnt.fetch_add(1, std::memory_order_relaxed);
+
+// (Re)build the resident system prefix: wipe the KV cache and decode the prefix
+// tokens into seq 0. Called once at startup, and again only if trimming the
+// previous turn out of the cache is not supported by the memory backend.
+bool LlamaBrain::Impl::decode_prefix(llama_batch& batch, int32_t n_batch) {
+    llama_memory_clear(llama_get_memory(ctx), /*data=*/true);
+    prefix_resident = false;
+
+    llama_pos pos = 0;
+    if (!prefill_chunked(ctx, gpu, batch, n_batch, prefix_toks.data(), prefix_toks.size(), pos)) {
+        return false;
+    }
+    n_prefix = pos;
+    n_past = pos;
+    turns.clear();
+    kv_toks = prefix_toks;
+    prefix_resident = true;
+    return true;
 }
 
-static void backend_release() {
-    const int n = g_backend_refcnt.fetch_sub(1, std::memory_order_relaxed) - 1;
-    if (n == 0) {
-        std::lock_guard<std::mutex> lk(g_backend_mu);
-        llama_backend_free();
+// Forget the conversation but keep the resident prefix.
+void LlamaBrain::Impl::drop_history() {
+    if (!prefix_resident) return;
+    if (!llama_memory_seq_rm(llama_get_memory(ctx), 0, n_prefix, -1)) {
+        // Partial removal unsupported: force a prefix rebuild on next use.
+        prefix_resident = false;
     }
+    turns.clear();
+    n_past = n_prefix;
+    kv_toks.resize((size_t)n_prefix);
 }
 
-static llama_sampler* make_sampler() {
-    const uint32_t seed = 0xC0FFEEu;  // or time-based if you prefer
-    const float temp    = 0.7f;
-    const int   top_k   = 40;
-    const float top_p   = 0.9f;
+// Sliding window: evict the oldest turns until `need` more positions fit in
+// n_ctx (and max_history_turns is honored). The evicted span is removed from
+// the KV cache and the newer turns are shifted down to close the gap, so
+// nothing is re-tokenized or re-decoded. Returns the number of evicted tokens.
+int LlamaBrain::Impl::make_room(int32_t n_ctx, int32_t need) {
+    size_t n_evict = 0;
+    llama_pos freed = 0;
+    const size_t max_turns = p.max_history_turns > 0 ? (size_t)p.max_history_turns : turns.size();
+
+    while (n_evict < turns.size() &&
+           (n_past - freed + need > n_ctx || turns.size() - n_evict > max_turns)) {
+        freed = turns[n_evict].end - n_prefix;
+        n_evict++;
+    }
+    if (n_evict == 0) return 0;
 
-    llama_sampler* chain =
-        llama_sampler_chain_init(llama_sampler_chain_default_params());
-    if (!chain) return nullptr;
+    llama_memory_t mem = llama_get_memory(ctx);
+    const llama_pos a = n_prefix;
+    const llama_pos b = n_prefix + freed;
 
-    // Order: penalties (optional) -> temp -> top-k -> top-p -> dist
-    // Keep it simple until stable.
-    llama_sampler_chain_add(chain, llama_sampler_init_temp(temp));
-    llama_sampler_chain_add(chain, llama_sampler_init_top_k(top_k));
-    llama_sampler_chain_add(chain, llama_sampler_init_top_p(top_p, 1));
+    if (!llama_memory_can_shift(mem) || !llama_memory_seq_rm(mem, 0, a, b)) {
+        const int dropped = (int)(n_past - n_prefix);
+        drop_history();
+        return dropped;
+    }
+    llama_memory_seq_add(mem, 0, b, -1, -freed);
+    kv_toks.erase(kv_toks.begin() + a, kv_toks.begin() + std::min<size_t>((size_t)b, kv_toks.size()));
+
+    // Same shift in the draft cache, so it does not re-decode the window.
+    if (draft.ctx) {
+        llama_memory_t dmem = llama_get_memory(draft.ctx);
+        if ((size_t)b <= draft.kv_toks.size() && llama_memory_seq_rm(dmem, 0, a, b)) {
+            llama_memory_seq_add(dmem, 0, b, -1, -freed);
+            draft.kv_toks.erase(draft.kv_toks.begin() + a, draft.kv_toks.begin() + b);
+        } else {
+            draft_reset();
+        }
+    }
 
-    // REQUIRED: actually select a token
-    llama_sampler_chain_add(chain, llama_sampler_init_dist(seed));
+    turns.erase(turns.begin(), turns.begin() + (long)n_evict);
+    for (auto& t : turns) {
+        t.start -= freed;
+        t.end   -= freed;
+    }
+    n_past -= freed;
+    return (int)freed;
+}
 
-    return chain;
+void LlamaBrain::Impl::draft_reset() {
+    if (!draft.ctx) return;
+    llama_memory_clear(llama_get_memory(draft.ctx), /*data=*/true);
+    draft.kv_toks.clear();
 }
 
-static std::string build_prompt(const LlamaBrain::Params& p, const std::string& user_text) {
-    // Keep this simple and predictable (fast, low-token).
-    // You can swap to chat templates later if you want model-specific formatting.
-    std::string s;
-    s.reserve(p.system_prompt.size() + user_text.size() + 64);
+// Bring the draft cache in line with kv_toks (+ next, if given): keep the
+// common prefix, drop the rest, decode what is missing. Usually that is only
+// the tokens accepted since the last proposal.
+bool LlamaBrain::Impl::draft_sync(llama_batch& batch, int32_t n_batch, const llama_token* next) {
+    llama_memory_t dmem = llama_get_memory(draft.ctx);
+
+    size_t keep = 0;
+    const size_t n = std::min(draft.kv_toks.size(), kv_toks.size());
+    while (keep < n && draft.kv_toks[keep] == kv_toks[keep]) keep++;
+    if (keep < draft.kv_toks.size()) {
+        if (!llama_memory_seq_rm(dmem, 0, (llama_pos)keep, -1)) {
+            llama_memory_clear(dmem, /*data=*/true);
+            keep = 0;
+        }
+        draft.kv_toks.resize(keep);
+    }
 
-    s += p.system_prompt;
-    if (!s.empty() && s.back() != '\n') s += "\n";
-    s += "User: ";
-    s += user_text;
-    s += "\nEdna:";
+    draft.pending.assign(kv_toks.begin() + (long)keep, kv_toks.end());
+    if (next) draft.pending.push_back(*next);
+    if (draft.pending.empty()) return true;
 
-    return s;
+    llama_pos pos = (llama_pos)keep;
+    if (!prefill_chunked(draft.ctx, gpu, batch, n_batch, draft.pending.data(), draft.pending.size(), pos)) {
+        draft_reset();
+        return false;
+    }
+    draft.kv_toks.insert(draft.kv_toks.end(), draft.pending.begin(), draft.pending.end());
+    return true;
 }
 
-/* ------------------------------------------------------------ */
-/* LlamaBrain Impl                                              */
-/* ------------------------------------------------------------ */
-
-struct LlamaBrain::Impl {
-    Params p{};
-
-    llama_model* model = nullptr;
-    const llama_vocab* vocab = nullptr;
+// Greedy draft continuation of kv_toks + next: up to max tokens, stopping
+// early once the draft model's top choice falls below draft_p_min (those
+// proposals are mostly rejected and would only lengthen the verify batch).
+void LlamaBrain::Impl::draft_propose(llama_batch& batch, int32_t n_batch, llama_token next, int max,
+                                     std::vector<llama_token>& out) {
+    out.clear();
+    if (!draft.ctx || max <= 0) return;
+    if (!draft_sync(batch, n_batch, &next)) return;
+
+    llama_pos pos = (llama_pos)draft.kv_toks.size();
+    while ((int)out.size() < max) {
+        const float* logits = llama_get_logits_ith(draft.ctx, -1);
+        if (!logits) break;
+
+        llama_token best = 0;
+        for (int32_t t = 1; t < draft.n_vocab; t++) {
+            if (logits[t] > logits[best]) best = t;
+        }
+        double sum = 0.0;
+        for (int32_t t = 0; t < draft.n_vocab; t++) {
+            const float d = logits[t] - logits[best];
+            if (d > -20.0f) sum += std::exp((double)d);   // the rest is < 2e-9 each
+        }
+        if (1.0 / sum < p.draft_p_min) break;
 
-    llama_context_params cparams{};
-    llama_context* ctx = nullptr;
+        out.push_back(best);
+        // The last proposal is verified by the main model, no need to
+        // decode it here.
+        if ((int)out.size() == max) break;
 
-    llama_sampler* sampler = nullptr;
-};
+        batch_reset(batch);
+        batch_add(batch, best, pos++, /*logits=*/true);
+        if (decode_gpu(draft.ctx, gpu, batch) != 0) {
+            draft_reset();
+            break;
+        }
+        draft.kv_toks.push_back(best);
+    }
+}
 
 LlamaBrain::LlamaBrain(const std::string& model_path, const Params& p) : impl_(new Impl) {
     impl_->p = p;
 
     backend_acquire();
 
-    llama_model_params mp = llama_model_default_params();
-    mp.n_gpu_layers = p.n_gpu_layers;
+    const llama_model_params mp = model_params(p);
+    if (p.n_gpu_layers > 0 && p.gpu_arbitrate) impl_->gpu = &GpuArbiter::for_device(p.main_gpu);
 
     impl_->model = llama_model_load_from_file(model_path.c_str(), mp);
     if (!impl_->model) {
@@ -176,22 +291,82 @@ LlamaBrain::LlamaBrain(const std::string& model_path, const Params& p) : impl_(n
         std::exit(1);
     }
 
-    impl_->cparams = llama_context_default_params();
-    impl_->cparams.n_ctx     = p.n_ctx;
-    impl_->cparams.n_threads = p.n_threads;
-    impl_->cparams.n_batch   = p.n_batch;
+    if (!context_params(p, impl_->cparams)) {
+        std::fprintf(stderr, "LlamaBrain: unknown kv_type '%s' (f16, q8_0, q4_0)\n", p.kv_type.c_str());
+        std::exit(1);
+    }
 
     impl_->ctx = llama_init_from_model(impl_->model, impl_->cparams);
     if (!impl_->ctx) {
         std::fprintf(stderr, "LlamaBrain: failed to create context\n");
         std::exit(1);
     }
+    std::fprintf(stderr, "[llm] n_batch=%u n_ubatch=%u threads=%d/%d flash_attn=%s mmap=%d mlock=%d\n",
+                 impl_->cparams.n_batch, impl_->cparams.n_ubatch,
+                 impl_->cparams.n_threads, impl_->cparams.n_threads_batch,
+                 flash_attn_name(impl_->cparams),
+                 p.use_mmap ? 1 : 0, p.use_mlock ? 1 : 0);
+    print_memory("main", impl_->model, impl_->cparams);
 
     impl_->sampler = make_sampler();
     if (!impl_->sampler) {
         std::fprintf(stderr, "LlamaBrain: failed to init sampler\n");
         std::exit(1);
     }
+
+    // Optional draft model. Unlike the main model it is not required: on any
+    // problem edna runs without speculation.
+    if (!p.draft_model_path.empty()) {
+        llama_model_params dmp = model_params(p);
+        dmp.n_gpu_layers = p.draft_gpu_layers;
+
+        Impl::Draft& d = impl_->draft;
+        std::string why;
+        d.model = llama_model_load_from_file(p.draft_model_path.c_str(), dmp);
+        if (!d.model) {
+            why = "failed to load";
+        } else if (vocab_compatible(impl_->vocab, llama_model_get_vocab(d.model), why)) {
+            // Same window as the main context: positions mirror it.
+            d.ctx = llama_init_from_model(d.model, impl_->cparams);
+            if (!d.ctx) why = "failed to create context";
+        }
+        if (d.ctx) {
+            d.n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(d.model));
+            print_memory("draft", d.model, impl_->cparams);
+            std::fprintf(stderr, "[llm] draft model %s draft_max=%d p_min=%.2f\n",
+                         p.draft_model_path.c_str(), p.draft_max, p.draft_p_min);
+        } else {
+            std::fprintf(stderr, "[llm] draft model %s disabled: %s\n",
+                         p.draft_model_path.c_str(), why.c_str());
+            if (d.model) llama_model_free(d.model);
+            d.model = nullptr;
+        }
+    }
+
+    // Tokenize + decode the system prefix once; every turn reuses it.
+    impl_->prefix_toks = tokenize_prompt(impl_->vocab, build_system_prefix(p), /*add_special=*/true);
+    impl_->turn_end_toks = tokenize_prompt(impl_->vocab, "\n", /*add_special=*/false);
+
+    const int32_t n_batch = std::min<int32_t>(std::max<int32_t>(8, p.n_batch),
+                                              (int32_t)llama_n_batch(impl_->ctx));
+    const int32_t n_ctx   = std::max<int32_t>(64, p.n_ctx);
+    if ((int32_t)impl_->prefix_toks.size() > n_ctx / 2) {
+        std::fprintf(stderr, "LlamaBrain: system prompt too long (%zu tokens, n_ctx=%d)\n",
+                     impl_->prefix_toks.size(), n_ctx);
+        std::exit(1);
+    }
+
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+    const bool ok = impl_->decode_prefix(batch, n_batch);
+    if (ok && impl_->draft.ctx) impl_->draft_sync(batch, n_batch, nullptr);
+    llama_batch_free(batch);
+    // Per-device totals (weights / KV / compute, free memory) now that the
+    // compute buffers are allocated.
+    llama_memory_breakdown_print(impl_->ctx);
+    if (!ok) {
+        std::fprintf(stderr, "LlamaBrain: failed to decode system prefix\n");
+        std::exit(1);
+    }
 }
 
 LlamaBrain::~LlamaBrain() {
@@ -200,6 +375,8 @@ LlamaBrain::~LlamaBrain() {
     if (impl_->sampler) llama_sampler_free(impl_->sampler);
     if (impl_->ctx)     llama_free(impl_->ctx);
     if (impl_->model)   llama_model_free(impl_->model);
+    if (impl_->draft.ctx)   llama_free(impl_->draft.ctx);
+    if (impl_->draft.model) llama_model_free(impl_->draft.model);
 
     backend_release();
 
@@ -208,6 +385,14 @@ LlamaBrain::~LlamaBrain() {
 }
 
 std::string LlamaBrain::reply(const std::string& user_text) {
+    return reply_stream(user_text, nullptr);
+}
+
+std::string LlamaBrain::reply_stream(const std::string& user_text, const PieceFn& on_piece) {
+    return reply_stream(user_text, on_piece, cancel_gen());
+}
+
+std::string LlamaBrain::reply_stream(const std::string& user_text, const PieceFn& on_piece, uint64_t gen) {
     // Serialize ALL access to impl_ / ctx / sampler. llama.cpp contexts are not thread-safe.
     std::lock_guard<std::mutex> lock(reply_mu_);
 
@@ -216,41 +401,22 @@ std::string LlamaBrain::reply(const std::string& user_text) {
     }
 
     const int32_t n_ctx   = std::max<int32_t>(64, impl_->p.n_ctx);
-    const int32_t n_batch = std::max<int32_t>(8,  impl_->p.n_batch);
+    int32_t       n_batch = std::max<int32_t>(8,  impl_->p.n_batch);
 
-    const std::string prompt = build_prompt(impl_->p, user_text);
+    const auto t0 = std::chrono::steady_clock::now();
 
-    // Reset between requests (portable):
-    // Older llama.h doesn't expose KV-cache APIs, so we recreate ONLY the context.
-    // This keeps the model loaded and avoids full reload cost.
-    if (impl_->ctx) {
-        llama_free(impl_->ctx);
-        impl_->ctx = nullptr;
-    }
-    impl_->ctx = llama_init_from_model(impl_->model, impl_->cparams);
-    if (!impl_->ctx) {
-        return "(failed to recreate context)";
-    }
-    
-    // Samplers are stateful: recreate per request.
-    if (impl_->sampler) {
-        llama_sampler_free(impl_->sampler);
-        impl_->sampler = nullptr;
-    }
-    impl_->sampler = make_sampler();
-    if (!impl_->sampler) {
-        return "(failed to recreate sampler)";
-    }
+    // Prefill chunks must not exceed what the context accepts per llama_decode.
+    n_batch = std::min<int32_t>(n_batch, (int32_t)llama_n_batch(impl_->ctx));
 
-    // Tokenize full prompt
+    // Tokenize only this turn; the system prefix is already in the KV cache.
     std::vector<llama_token> toks =
-        tokenize_prompt(impl_->vocab, prompt, /*add_special=*/true);
+        tokenize_prompt(impl_->vocab, build_turn(user_text), /*add_special=*/false);
 
     if (toks.empty()) {
         return "(empty prompt)";
     }
 
-    // Decide how many prompt tokens we allow:
+    // Decide how many prompt tokens we allow (prefix + turn):
     // - prefer user-specified max_prompt_tokens
     // - clamp to fit in context with a safety margin for generation
     const int32_t safety = std::max<int32_t>(32, impl_->p.max_new_tokens + 8);
@@ -258,93 +424,267 @@ std::string LlamaBrain::reply(const std::string& user_text) {
         (impl_->p.max_prompt_tokens > 0) ? impl_->p.max_prompt_tokens : (n_ctx - safety);
 
     max_prompt = std::min<int32_t>(max_prompt, n_ctx - safety);
-    if (max_prompt < 16) max_prompt = 16;
 
-    if ((int32_t)toks.size() > max_prompt) {
-        // Keep tail so we preserve the recent turns near the end.
-        toks.erase(toks.begin(), toks.end() - max_prompt);
+    int32_t max_turn = max_prompt - (int32_t)impl_->prefix_toks.size();
+    if (max_turn < 16) max_turn = 16;
 
-        // Best-effort: ensure BOS if used
-        const llama_token bos = llama_vocab_bos(impl_->vocab);
-        if (!toks.empty() && toks.front() != bos) {
-            toks.insert(toks.begin(), bos);
-        }
+    if ((int32_t)toks.size() > max_turn) {
+        // Keep tail so the "\nEdna:" cue survives.
+        toks.erase(toks.begin(), toks.end() - max_turn);
     }
 
-    llama_pos pos = 0;
-
     // Batch init
     llama_batch batch = llama_batch_init(n_batch, 0, 1);
 
-    // --------------------
-    // Prompt decode
-    // --------------------
-    for (size_t i = 0; i < toks.size(); i++) {
-        if (pos >= n_ctx) break;
-
-        batch_reset(batch);
+    // Append this turn after the existing history. Make room first by sliding
+    // the oldest turns out of the window (never the system prefix).
+    const int32_t need = (int32_t)toks.size() + impl_->p.max_new_tokens +
+                         (int32_t)impl_->turn_end_toks.size() + 1;
 
-        // Only the last prompt token needs logits
-        const bool want_logits = (i + 1 == toks.size());
-        batch_add(batch, toks[i], pos++, want_logits);
+    Stats st{};
+    bool rebuilt = false;
+    if (impl_->prefix_resident) {
+        if (!impl_->p.keep_history) impl_->drop_history();
+        st.evicted_tokens = impl_->make_room(n_ctx, need);
+    }
 
-        if (llama_decode(impl_->ctx, batch) != 0) {
+    // If the prefix was lost (decode failure, backend without partial
+    // removal), rebuild it; that also starts a fresh conversation.
+    if (!impl_->prefix_resident) {
+        if (!impl_->decode_prefix(batch, n_batch)) {
             llama_batch_free(batch);
-            return "(decode failed on prompt)";
+            return "(decode failed on system prefix)";
         }
+        rebuilt = true;
     }
 
+    const llama_pos turn_start = impl_->n_past;
+    llama_pos pos = turn_start;
+
+    st.prompt_tokens  = (int)toks.size();
+    st.cached_tokens  = rebuilt ? 0 : (int)impl_->n_past;
+    st.history_tokens = (int)(impl_->n_past - impl_->n_prefix);
+    st.history_turns  = (int)impl_->turns.size();
+
+    // --------------------
+    // Prompt decode (chunked, n_batch tokens per llama_decode)
+    // --------------------
+    const auto pf0 = std::chrono::steady_clock::now();
+    if (!prefill_chunked(impl_->ctx, impl_->gpu, batch, n_batch, toks.data(), toks.size(), pos)) {
+        llama_batch_free(batch);
+        // The cache is in an unknown state now; rebuild the prefix next turn.
+        impl_->prefix_resident = false;
+        return "(decode failed on prompt)";
+    }
+    impl_->kv_toks.insert(impl_->kv_toks.end(), toks.begin(), toks.end());
+    st.prefill_ms = ms_since(pf0);
+
     // REQUIRED: reset sampler after prompt decode and before first sampling.
     llama_sampler_reset(impl_->sampler);
 
     std::string out;
     out.reserve(256);
+    std::string piece;
 
     const llama_token eos = llama_vocab_eos(impl_->vocab);
 
     // --------------------
     // Generation loop
     // --------------------
+    // With a draft model each decode carries the sampled token plus the
+    // draft's guesses for what follows, all with logits. Sampling then walks
+    // those logits while its picks keep matching the guesses, so one
+    // llama_decode can yield several tokens. Tokens are sampled exactly as
+    // without a draft (same chain, reset per token, logits of the same
+    // prefix; batched decodes can differ in the last float bits), so a good
+    // guess only saves the decode of a token the main model picks anyway.
+    const int draft_max = impl_->draft.ctx ? std::min(impl_->p.draft_max, n_batch - 1) : 0;
+    std::vector<llama_token> drafted;   // guesses in the last batch, after its first token
+    size_t verified = 0;                // of those, already consumed by sampling
+    int32_t logits_idx = -1;            // batch index of the logits to sample next
+
+    bool decode_ok = true;
+    const auto gen0 = std::chrono::steady_clock::now();
     for (int i = 0; i < impl_->p.max_new_tokens; i++) {
         if (pos >= n_ctx - 1) break;
+        if (impl_->cancel_gen.load(std::memory_order_relaxed) != gen) {
+            st.cancelled = true;
+            break;
+        }
 
-        // Must have logits right now.
-        if (!llama_get_logits_ith(impl_->ctx, 0)) {
+        // Must have logits right now. -1 = last token of the previous batch
+        // (the prefill chunk puts it at n_tokens-1, not at index 0).
+        if (!llama_get_logits_ith(impl_->ctx, logits_idx)) {
             break;
         }
 
         // REQUIRED: reset sampler BEFORE EVERY SAMPLE in modern llama.cpp.
         llama_sampler_reset(impl_->sampler);
 
-        llama_token tok = llama_sampler_sample(impl_->sampler, impl_->ctx, 0);
+        llama_token tok = llama_sampler_sample(impl_->sampler, impl_->ctx, logits_idx);
+        if (st.gen_tokens++ == 0) st.ttft_ms = ms_since(t0);
         llama_sampler_accept(impl_->sampler, tok);
 
-        if (tok == eos) break;
+        if (tok == eos || llama_vocab_is_eog(impl_->vocab, tok)) break;
 
-        out += token_to_piece(impl_->vocab, tok);
+        token_to_piece(impl_->vocab, tok, piece);
 
+        bool stop = false;
         if (impl_->p.stop_on_newline) {
-            auto nl = out.find('\n');
+            auto nl = piece.find('\n');
             if (nl != std::string::npos) {
-                out.resize(nl);
-                break;
+                piece.resize(nl);
+                stop = true;
             }
         }
 
+        out += piece;
+        if (on_piece && !piece.empty()) on_piece(piece);
+        if (stop) break;
+
+        // Guessed right: tok is already in the KV cache and the logits after
+        // it came with the same batch.
+        if (verified < drafted.size() && tok == drafted[verified]) {
+            verified++;
+            st.draft_accepted++;
+            impl_->kv_toks.push_back(tok);
+            pos++;
+            logits_idx++;
+            continue;
+        }
+
+        // Otherwise drop the rejected guesses before decoding tok.
+        if (verified < drafted.size() &&
+            !llama_memory_seq_rm(llama_get_memory(impl_->ctx), 0, pos, -1)) {
+            decode_ok = false;
+            break;
+        }
+
+        const int room = std::min({draft_max, impl_->p.max_new_tokens - i - 1, n_ctx - 2 - (int)pos});
+        impl_->draft_propose(batch, n_batch, tok, room, drafted);
+        verified = 0;
+        st.draft_tokens += (int)drafted.size();
+
         // Decode generated token WITH logits enabled so we can sample next.
         batch_reset(batch);
-        batch_add(batch, tok, pos++, /*want_logits=*/true);
+        batch_add(batch, tok, pos, /*want_logits=*/true);
+        for (size_t j = 0; j < drafted.size(); j++) {
+            batch_add(batch, drafted[j], pos + 1 + (llama_pos)j, /*want_logits=*/true);
+        }
 
-        if (llama_decode(impl_->ctx, batch) != 0) {
+        if (decode_gpu(impl_->ctx, impl_->gpu, batch) != 0) {
             out += " (decode failed)";
+            decode_ok = false;
             break;
         }
+        impl_->kv_toks.push_back(tok);
+        pos++;
+        logits_idx = 0;
+    }
+
+    // Guesses past the last accepted token are still in the cache.
+    if (decode_ok && verified < drafted.size() &&
+        !llama_memory_seq_rm(llama_get_memory(impl_->ctx), 0, pos, -1)) {
+        decode_ok = false;
+    }
+
+    st.gen_ms = ms_since(gen0);
+
+    if (st.cancelled && decode_ok) {
+        // Interrupted: drop the whole turn (user text + partial reply).
+        llama_batch_free(batch);
+        if (llama_memory_seq_rm(llama_get_memory(impl_->ctx), 0, turn_start, -1)) {
+            impl_->n_past = turn_start;
+            impl_->kv_toks.resize((size_t)turn_start);
+        } else {
+            impl_->prefix_resident = false;
+        }
+        {
+            std::lock_guard<std::mutex> lk(impl_->stats_mu);
+            impl_->stats = st;
+        }
+        return trim_ws(out);
     }
 
+    // Close the turn in the KV cache so the next one appends after it. The
+    // final sampled token (EOG / newline) is never decoded, so add the turn
+    // separator explicitly.
+    if (decode_ok && pos + (llama_pos)impl_->turn_end_toks.size() < n_ctx) {
+        decode_ok = prefill_chunked(impl_->ctx, impl_->gpu, batch, n_batch,
+                                    impl_->turn_end_toks.data(), impl_->turn_end_toks.size(), pos);
+        if (decode_ok) {
+            impl_->kv_toks.insert(impl_->kv_toks.end(),
+                                  impl_->turn_end_toks.begin(), impl_->turn_end_toks.end());
+        }
+    }
     llama_batch_free(batch);
 
+    if (decode_ok) {
+        impl_->turns.push_back(Impl::Turn{turn_start, pos});
+        impl_->n_past = pos;
+    } else {
+        impl_->prefix_resident = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(impl_->stats_mu);
+        impl_->stats = st;
+    }
+
     out = trim_ws(out);
     if (out.empty()) out = "(no response)";
     return out;
 }
 
+
+void LlamaBrain::cancel() {
+    // Deliberately not under reply_mu_: that is held for the whole reply.
+    if (impl_) impl_->cancel_gen.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t LlamaBrain::cancel_gen() const {
+    return impl_ ? impl_->cancel_gen.load(std::memory_order_relaxed) : 0;
+}
+
+bool LlamaBrain::warmup() {
+    std::lock_guard<std::mutex> lock(reply_mu_);
+    if (!impl_ || !impl_->prefix_resident) return false;
+
+    const std::vector<llama_token> toks =
+        tokenize_prompt(impl_->vocab, build_turn("Hello."), /*add_special=*/false);
+    if (toks.empty()) return false;
+    const int32_t n_batch = std::min<int32_t>(std::max<int32_t>(8, impl_->p.n_batch),
+                                              (int32_t)llama_n_batch(impl_->ctx));
+    llama_batch batch = llama_batch_init(n_batch, 0, 1);
+
+    // Decode after whatever ctx holds, then cut it back to exactly that.
+    auto warm = [&](llama_context* ctx, llama_pos start) {
+        llama_pos pos = start;
+        bool ok = prefill_chunked(ctx, impl_->gpu, batch, n_batch, toks.data(), toks.size(), pos);
+        if (ok) {
+            batch_reset(batch);
+            batch_add(batch, toks.back(), pos, /*logits=*/true);
+            ok = decode_gpu(ctx, impl_->gpu, batch) == 0;
+        }
+        return llama_memory_seq_rm(llama_get_memory(ctx), 0, start, -1) && ok;
+    };
+
+    bool ok = warm(impl_->ctx, impl_->n_past);
+    if (!ok) impl_->prefix_resident = false;
+    if (impl_->draft.ctx && !warm(impl_->draft.ctx, (llama_pos)impl_->draft.kv_toks.size())) {
+        impl_->draft_reset();
+    }
+    llama_batch_free(batch);
+    return ok;
+}
+
+void LlamaBrain::reset_history() {
+    std::lock_guard<std::mutex> lock(reply_mu_);
+    if (impl_) impl_->drop_history();
+}
+
+LlamaBrain::Stats LlamaBrain::last_stats() const {
+    if (!impl_) return Stats{};
+    std::lock_guard<std::mutex> lk(impl_->stats_mu);
+    return impl_->stats;
+}
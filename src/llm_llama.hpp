@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <mutex>
 
@@ -8,11 +10,24 @@ public:
     struct Params {
         // GPU offload: Orin Nano has limited VRAM, so keep this conservative.
         int n_gpu_layers     = 16;
+        int main_gpu         = 0;      // CUDA device for the offloaded layers
+        bool gpu_arbitrate   = true;   // share the device via GpuArbiter (lease per llama_decode)
 
         // Context and performance knobs
         int n_ctx            = 512;
-        int n_threads        = 6;
-        int n_batch          = 64;
+        int n_threads        = 6;      // generation (1 token per decode)
+        int n_threads_batch  = 0;      // prefill; 0 = n_threads
+        int n_batch          = 64;     // tokens per llama_decode (prefill chunk)
+        int n_ubatch         = 0;      // physical batch per compute graph; 0 = n_batch.
+                                       // Smaller shrinks the compute buffer.
+
+        // Memory. The KV cache grows linearly with n_ctx; q8_0 halves it and
+        // q4_0 quarters it (vs f16), at a small quality cost. A quantized V
+        // cache requires flash attention.
+        std::string kv_type  = "f16";  // "f16", "q8_0" or "q4_0" (K and V)
+        int  flash_attn      = -1;     // -1 = auto, 0 = off, 1 = on
+        bool use_mmap        = true;   // map the GGUF instead of reading it into RAM
+        bool use_mlock       = false;  // pin the mapped weights (never paged out)
 
         // Generation controls
         int max_new_tokens   = 128;
@@ -20,12 +35,48 @@ public:
         // Prompt controls (helps prevent blowing context on long user text)
         int max_prompt_tokens = 384;   // should be <= n_ctx - safety margin
 
+        // Conversation memory: keep previous turns in the KV cache. When n_ctx
+        // fills up the oldest turns slide out; the system prompt never does.
+        bool keep_history     = true;
+        int  max_history_turns = 0;    // 0 = limited only by n_ctx
+
         // Assistant behavior
         std::string system_prompt =
             "You are Edna, a concise voice assistant. Answer in 1-2 sentences.";
 
         // Stop early for voice UX (useful when models ramble)
         bool stop_on_newline = true;
+
+        // Speculative decoding: a small draft model with the same tokenizer
+        // (e.g. Qwen2.5-0.5B next to the 2B) proposes up to draft_max tokens
+        // per step and the main model verifies them in one batched decode.
+        // Every token is still sampled from the main model, so the reply is
+        // the same as without a draft. "" = off.
+        std::string draft_model_path;
+        int   draft_max        = 6;
+        float draft_p_min      = 0.6f;  // stop drafting once the draft is less sure than this
+        int   draft_gpu_layers = 999;
+    };
+
+    // Timing for the most recent reply(). Prefill and generation are reported
+    // separately because they scale very differently (batched vs 1 token/step).
+    struct Stats {
+        int    prompt_tokens = 0;   // tokens prefilled this turn
+        int    cached_tokens = 0;   // prefix + history tokens reused from the KV cache
+        int    history_tokens = 0;  // history in the window when this turn started
+        int    history_turns  = 0;
+        int    evicted_tokens = 0;  // slid out of the window to make room
+        int    gen_tokens    = 0;
+        double prefill_ms    = 0.0;
+        double gen_ms        = 0.0;
+        double ttft_ms       = 0.0; // reply() entry -> first sampled token
+        bool   cancelled     = false; // stopped early by cancel()
+        int    draft_tokens  = 0;   // proposed by the draft model
+        int    draft_accepted = 0;  // of those, confirmed by the main model
+
+        double prefill_tps() const { return prefill_ms > 0.0 ? prompt_tokens * 1000.0 / prefill_ms : 0.0; }
+        double gen_tps()     const { return gen_ms     > 0.0 ? gen_tokens    * 1000.0 / gen_ms     : 0.0; }
+        double accept_rate() const { return draft_tokens > 0 ? (double)draft_accepted / draft_tokens : 0.0; }
     };
 
     LlamaBrain(const std::string& model_path, const Params& p);
@@ -36,6 +87,33 @@ public:
 
     std::string reply(const std::string& user_text);
 
+    // Streaming variant: on_piece is called (on the calling thread) with each
+    // decoded piece as soon as it is sampled. Returns the full trimmed reply.
+    // Generation stops as soon as cancel_gen() moves past `gen`, so a caller
+    // that captured it when it took the job loses no cancel() that lands
+    // before the call; without `gen`, the generation at the call counts.
+    using PieceFn = std::function<void(const std::string& piece)>;
+    std::string reply_stream(const std::string& user_text, const PieceFn& on_piece);
+    std::string reply_stream(const std::string& user_text, const PieceFn& on_piece, uint64_t gen);
+
+    // Stop an in-flight reply() from another thread (barge-in) and any reply
+    // started for an earlier cancel_gen(). Generation ends before the next
+    // token; the partial turn is removed from the KV cache so the
+    // conversation reads as if it never happened.
+    void cancel();
+    uint64_t cancel_gen() const;
+
+    // Forget the conversation (the system prompt stays resident).
+    void reset_history();
+
+    // Startup warm-up: prefill a short dummy turn and decode one token, then
+    // drop both from the KV cache. Runs both graph shapes once (CUDA kernel
+    // loading, cuBLAS handles) so the first real turn does not pay for it.
+    bool warmup();
+
+    // Stats of the last completed reply().
+    Stats last_stats() const;
+
     std::mutex reply_mu_;
 
 private:
@@ -0,0 +1,633 @@
+#include "llm_sessions.hpp"
+#include "gpu_arbiter.hpp"
+
+// llama.h drags ggml headers too. Keep it quarantined in the llm TUs.
+#include "llm_common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llm;
+
+using Clock = std::chrono::steady_clock;
+
+/* ------------------------------------------------------------ */
+/* LlamaSessions Impl                                           */
+/* ------------------------------------------------------------ */
+
+struct LlamaSessions::Impl {
+    Params p{};
+
+    llama_model* model = nullptr;
+    const llama_vocab* vocab = nullptr;
+    llama_context_params cparams{};
+    llama_context* ctx = nullptr;
+    GpuArbiter* gpu = nullptr;   // null: no GPU arbitration
+
+    std::vector<llama_token> prefix_toks;     // resident in seq 0 at [0, n_prefix)
+    std::vector<llama_token> turn_end_toks;
+    llama_pos n_prefix = 0;
+    int32_t n_ctx_seq = 0;                    // per-session window
+    int32_t n_batch = 0;                      // tokens per merged decode
+
+    // One reply_stream() call. Owned by the calling thread; the scheduler
+    // works on it through Session::req until phase is Done.
+    struct Request {
+        enum class Phase { Queued, Prefill, Generate, Close, Done };
+        Phase phase = Phase::Queued;
+
+        std::vector<llama_token> toks;        // the prompt, then turn_end_toks
+        size_t fed = 0;                       // of toks, decoded so far
+        llama_token next = 0;                 // sampled, decoded in the next step
+        int max_new = 0;
+        llama_pos turn_start = 0;
+        llama_pos pos = 0;                    // next position in the session's seq
+
+        std::string out;
+        std::deque<std::string> pieces;       // sampled, not yet handed to the caller
+        std::string piece;                    // token_to_piece scratch
+        bool failed = false;
+
+        Stats st{};
+        Clock::time_point t0{}, pf0{}, gen0{};
+        bool in_batch = false;                // has been part of a decode yet
+        uint64_t decodes = 0;
+        uint64_t sessions_sum = 0;
+    };
+
+    struct Turn { llama_pos start; llama_pos end; };
+
+    struct Session {
+        bool open = false;
+        bool closing = false;
+        bool reset = false;
+        bool cancel = false;
+        bool primed = false;                  // prefix copied into seq
+        llama_seq_id seq = 0;
+        llama_sampler* sampler = nullptr;
+        std::deque<Turn> turns;
+        llama_pos n_past = 0;
+        Request* req = nullptr;
+        Stats stats{};
+    };
+    std::vector<Session> sessions;
+
+    // mu guards everything above that the scheduler and callers share. The
+    // scheduler drops it only around llama_decode; the KV cache, samplers and
+    // Request token state are touched by the scheduler thread alone.
+    mutable std::mutex mu;
+    std::condition_variable work_cv;   // scheduler: new request, cancel, close, stop
+    std::condition_variable done_cv;   // callers: pieces, request done, session closed
+    bool stop = false;
+    size_t rr = 0;                     // round-robin start for prefill chunks
+    SchedStats sched{};
+    llama_batch batch{};
+    std::thread sched_thread;
+
+    bool has_work() const;
+    void prime(Session& s);
+    void drop_history(Session& s);
+    int  make_room(Session& s, int32_t need);
+    void start(Session& s);
+    void finish(Session& s);
+    void abort_turn(Session& s);
+    void sample(Session& s, int32_t idx);
+    void close_turn(Session& s);
+    void step(std::unique_lock<std::mutex>& lk);
+    void loop();
+    std::string run(int sid, const std::string& user_text, const PieceFn& on_piece, int max_new);
+};
+
+bool LlamaSessions::Impl::has_work() const {
+    for (const Session& s : sessions) {
+        if (s.req || s.closing || s.reset) return true;
+    }
+    return false;
+}
+
+// Share the resident system prompt with a fresh session.
+void LlamaSessions::Impl::prime(Session& s) {
+    llama_memory_t mem = llama_get_memory(ctx);
+    llama_memory_seq_rm(mem, s.seq, -1, -1);
+    llama_memory_seq_cp(mem, 0, s.seq, 0, n_prefix);
+    s.turns.clear();
+    s.n_past = n_prefix;
+    s.primed = true;
+}
+
+void LlamaSessions::Impl::drop_history(Session& s) {
+    if (!s.primed) return;
+    if (!llama_memory_seq_rm(llama_get_memory(ctx), s.seq, n_prefix, -1)) s.primed = false;
+    s.turns.clear();
+    s.n_past = n_prefix;
+}
+
+// LlamaBrain::Impl::make_room for one session's sequence.
+int LlamaSessions::Impl::make_room(Session& s, int32_t need) {
+    size_t n_evict = 0;
+    llama_pos freed = 0;
+    const size_t max_turns = p.llm.max_history_turns > 0 ? (size_t)p.llm.max_history_turns : s.turns.size();
+
+    while (n_evict < s.turns.size() &&
+           (s.n_past - freed + need > n_ctx_seq || s.turns.size() - n_evict > max_turns)) {
+        freed = s.turns[n_evict].end - n_prefix;
+        n_evict++;
+    }
+    if (n_evict == 0) return 0;
+
+    llama_memory_t mem = llama_get_memory(ctx);
+    const llama_pos a = n_prefix;
+    const llama_pos b = n_prefix + freed;
+
+    if (!llama_memory_can_shift(mem) || !llama_memory_seq_rm(mem, s.seq, a, b)) {
+        const int dropped = (int)(s.n_past - n_prefix);
+        drop_history(s);
+        return dropped;
+    }
+    llama_memory_seq_add(mem, s.seq, b, -1, -freed);
+
+    s.turns.erase(s.turns.begin(), s.turns.begin() + (long)n_evict);
+    for (auto& t : s.turns) {
+        t.start -= freed;
+        t.end   -= freed;
+    }
+    s.n_past -= freed;
+    return (int)freed;
+}
+
+// A queued request enters the batch rotation: place it after the history.
+void LlamaSessions::Impl::start(Session& s) {
+    Request& r = *s.req;
+    const int32_t need = (int32_t)r.toks.size() + r.max_new + (int32_t)turn_end_toks.size() + 1;
+
+    if (s.primed && !p.llm.keep_history) drop_history(s);
+    if (s.primed) r.st.turn.evicted_tokens = make_room(s, need);
+    const bool rebuilt = !s.primed;
+    if (!s.primed) prime(s);
+
+    r.turn_start = r.pos = s.n_past;
+    r.st.turn.prompt_tokens  = (int)r.toks.size();
+    r.st.turn.cached_tokens  = rebuilt ? (int)n_prefix : (int)s.n_past;
+    r.st.turn.history_tokens = (int)(s.n_past - n_prefix);
+    r.st.turn.history_turns  = (int)s.turns.size();
+    r.phase = Request::Phase::Prefill;
+}
+
+void LlamaSessions::Impl::finish(Session& s) {
+    Request& r = *s.req;
+    r.st.batch_sessions = r.decodes ? (double)r.sessions_sum / r.decodes : 0.0;
+    r.phase = Request::Phase::Done;
+    s.stats = r.st;
+    s.req = nullptr;
+}
+
+// Cancelled or failed: drop the whole turn (user text + partial reply).
+void LlamaSessions::Impl::abort_turn(Session& s) {
+    Request& r = *s.req;
+    if (llama_memory_seq_rm(llama_get_memory(ctx), s.seq, r.turn_start, -1)) {
+        s.n_past = r.turn_start;
+    } else {
+        s.primed = false;
+    }
+    if (r.phase == Request::Phase::Generate) r.st.turn.gen_ms = ms_since(r.gen0);
+    finish(s);
+}
+
+// The reply is over: decode the turn separator (the final sampled token is
+// never decoded) and then record the turn.
+void LlamaSessions::Impl::close_turn(Session& s) {
+    Request& r = *s.req;
+    r.st.turn.gen_ms = ms_since(r.gen0);
+    if (!turn_end_toks.empty() && r.pos + (llama_pos)turn_end_toks.size() < n_ctx_seq) {
+        r.toks = turn_end_toks;
+        r.fed = 0;
+        r.phase = Request::Phase::Close;
+        return;
+    }
+    s.turns.push_back(Turn{r.turn_start, r.pos});
+    s.n_past = r.pos;
+    finish(s);
+}
+
+// Sample the session's next token from batch index idx (same stop rules as
+// LlamaBrain::reply_stream).
+void LlamaSessions::Impl::sample(Session& s, int32_t idx) {
+    Request& r = *s.req;
+    if (r.st.turn.gen_tokens >= r.max_new || r.pos >= n_ctx_seq - 1 ||
+        !llama_get_logits_ith(ctx, idx)) {
+        close_turn(s);
+        return;
+    }
+
+    // REQUIRED: reset sampler BEFORE EVERY SAMPLE in modern llama.cpp.
+    llama_sampler_reset(s.sampler);
+    const llama_token tok = llama_sampler_sample(s.sampler, ctx, idx);
+    if (r.st.turn.gen_tokens++ == 0) r.st.turn.ttft_ms = ms_since(r.t0);
+    llama_sampler_accept(s.sampler, tok);
+
+    if (tok == llama_vocab_eos(vocab) || llama_vocab_is_eog(vocab, tok)) {
+        close_turn(s);
+        return;
+    }
+
+    token_to_piece(vocab, tok, r.piece);
+    bool stop_here = false;
+    if (p.llm.stop_on_newline) {
+        const size_t nl = r.piece.find('\n');
+        if (nl != std::string::npos) {
+            r.piece.resize(nl);
+            stop_here = true;
+        }
+    }
+    r.out += r.piece;
+    if (!r.piece.empty()) r.pieces.push_back(r.piece);
+    if (stop_here) {
+        close_turn(s);
+        return;
+    }
+    r.next = tok;
+    r.phase = Request::Phase::Generate;
+}
+
+// One scheduler step: build a merged batch, decode it, consume the logits.
+void LlamaSessions::Impl::step(std::unique_lock<std::mutex>& lk) {
+    for (Session& s : sessions) {
+        // A reply that already ended (turn separator pending) is kept.
+        if (s.req && s.cancel && (s.req->phase == Request::Phase::Prefill ||
+                                  s.req->phase == Request::Phase::Generate)) {
+            s.req->st.turn.cancelled = true;
+            abort_turn(s);
+        } else if (s.req && s.req->phase == Request::Phase::Queued) {
+            if (s.cancel) {
+                s.req->st.turn.cancelled = true;
+                finish(s);
+            } else {
+                start(s);
+            }
+        }
+        if (s.req) continue;
+        if (s.reset) {
+            drop_history(s);
+            s.reset = false;
+        }
+        if (s.closing) {
+            llama_memory_seq_rm(llama_get_memory(ctx), s.seq, -1, -1);
+            s.turns.clear();
+            s.n_past = 0;
+            s.primed = false;
+            s.open = false;
+            s.closing = false;
+            sched.open_sessions--;
+        }
+    }
+
+    // Who is in this batch, and where their logits are.
+    struct Slot { Session* s; size_t take; int32_t logits_idx; };
+    std::vector<Slot> slots;
+    batch_reset(batch);
+
+    // Generating sessions first: one token each, so streaming replies keep
+    // their pace however many prompts are being prefilled.
+    for (Session& s : sessions) {
+        if (!s.req || s.req->phase != Request::Phase::Generate) continue;
+        slots.push_back(Slot{&s, 1, batch.n_tokens});
+        batch_add(batch, s.req->next, s.req->pos, /*logits=*/true, s.seq);
+    }
+    // Then prompt (and turn separator) chunks in the room that is left.
+    const size_t n = sessions.size();
+    for (size_t k = 0; k < n && batch.n_tokens < n_batch; k++) {
+        Session& s = sessions[(rr + k) % n];
+        if (!s.req) continue;
+        Request& r = *s.req;
+        if (r.phase != Request::Phase::Prefill && r.phase != Request::Phase::Close) continue;
+
+        const size_t take = std::min<size_t>((size_t)(n_batch - batch.n_tokens), r.toks.size() - r.fed);
+        int32_t logits_idx = -1;
+        for (size_t j = 0; j < take; j++) {
+            const bool last = r.phase == Request::Phase::Prefill && r.fed + j + 1 == r.toks.size();
+            if (last) logits_idx = batch.n_tokens;
+            batch_add(batch, r.toks[r.fed + j], r.pos + (llama_pos)j, last, s.seq);
+        }
+        if (r.phase == Request::Phase::Prefill && r.fed == 0) r.pf0 = Clock::now();
+        slots.push_back(Slot{&s, take, logits_idx});
+    }
+    rr++;
+    if (slots.empty()) return;
+
+    const auto now = Clock::now();
+    for (Slot& sl : slots) {
+        Request& r = *sl.s->req;
+        if (!r.in_batch) {
+            r.in_batch = true;
+            r.st.queue_ms = std::chrono::duration<double, std::milli>(now - r.t0).count();
+        }
+    }
+
+    lk.unlock();
+    const int rc = decode_gpu(ctx, gpu, batch);
+    lk.lock();
+
+    sched.decodes++;
+    sched.tokens += (uint64_t)batch.n_tokens;
+    sched.seq_slots += slots.size();
+
+    if (rc != 0) {
+        std::fprintf(stderr, "[llm] sessions: llama_decode failed (%d) on %d tokens from %zu sessions\n",
+                     rc, batch.n_tokens, slots.size());
+    }
+    for (Slot& sl : slots) {
+        Session& s = *sl.s;
+        Request& r = *s.req;
+        r.decodes++;
+        r.sessions_sum += slots.size();
+
+        if (rc != 0) {
+            r.failed = true;
+            abort_turn(s);
+            continue;
+        }
+        switch (r.phase) {
+            case Request::Phase::Generate:
+                r.pos++;
+                sample(s, sl.logits_idx);
+                break;
+            case Request::Phase::Prefill:
+                r.fed += sl.take;
+                r.pos += (llama_pos)sl.take;
+                if (r.fed == r.toks.size()) {
+                    r.st.turn.prefill_ms = ms_since(r.pf0);
+                    r.gen0 = Clock::now();
+                    sample(s, sl.logits_idx);
+                }
+                break;
+            case Request::Phase::Close:
+                r.fed += sl.take;
+                r.pos += (llama_pos)sl.take;
+                if (r.fed == r.toks.size()) {
+                    s.turns.push_back(Turn{r.turn_start, r.pos});
+                    s.n_past = r.pos;
+                    finish(s);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void LlamaSessions::Impl::loop() {
+    std::unique_lock<std::mutex> lk(mu);
+    while (true) {
+        work_cv.wait(lk, [&]{ return stop || has_work(); });
+        if (stop) break;
+        step(lk);
+        done_cv.notify_all();
+    }
+    // Nobody will decode for these any more.
+    for (Session& s : sessions) {
+        if (!s.req) continue;
+        s.req->failed = true;
+        finish(s);
+    }
+    done_cv.notify_all();
+}
+
+std::string LlamaSessions::Impl::run(int sid, const std::string& user_text,
+                                     const PieceFn& on_piece, int max_new) {
+    if (sid < 0 || sid >= (int)sessions.size()) return "(no session)";
+
+    Request r;
+    r.t0 = Clock::now();
+    r.max_new = max_new;
+    r.toks = tokenize_prompt(vocab, build_turn(user_text), /*add_special=*/false);
+    if (r.toks.empty()) return "(empty prompt)";
+
+    // Same prompt budget as LlamaBrain, against the session's window.
+    const int32_t safety = std::max<int32_t>(32, p.llm.max_new_tokens + 8);
+    int32_t max_prompt = p.llm.max_prompt_tokens > 0 ? p.llm.max_prompt_tokens : (n_ctx_seq - safety);
+    max_prompt = std::min<int32_t>(max_prompt, n_ctx_seq - safety);
+    const int32_t max_turn = std::max<int32_t>(16, max_prompt - (int32_t)prefix_toks.size());
+    if ((int32_t)r.toks.size() > max_turn) {
+        // Keep tail so the "\nEdna:" cue survives.
+        r.toks.erase(r.toks.begin(), r.toks.end() - max_turn);
+    }
+
+    std::unique_lock<std::mutex> lk(mu);
+    Session& s = sessions[(size_t)sid];
+    if (!s.open || s.closing) return "(no session)";
+    if (s.req || stop) return "(busy)";
+    s.cancel = false;
+    s.req = &r;
+    work_cv.notify_one();
+
+    std::deque<std::string> ready;
+    while (true) {
+        done_cv.wait(lk, [&]{ return !r.pieces.empty() || r.phase == Request::Phase::Done; });
+        ready.swap(r.pieces);
+        const bool done = r.phase == Request::Phase::Done;
+        if (on_piece && !ready.empty()) {
+            lk.unlock();
+            for (const std::string& piece : ready) on_piece(piece);
+            lk.lock();
+        }
+        ready.clear();
+        if (done && r.pieces.empty()) break;
+    }
+
+    const bool cancelled = r.st.turn.cancelled;
+    std::string out = trim_ws(r.out);
+    if (r.failed) return r.st.turn.gen_tokens == 0 ? "(decode failed on prompt)" : out + " (decode failed)";
+    if (cancelled) return out;
+    if (out.empty()) out = "(no response)";
+    return out;
+}
+
+/* ------------------------------------------------------------ */
+/* LlamaSessions                                                */
+/* ------------------------------------------------------------ */
+
+LlamaSessions::LlamaSessions(const std::string& model_path, const Params& params) : impl_(new Impl) {
+    Params p = params;
+    p.max_sessions = std::max(1, p.max_sessions);
+    impl_->p = p;
+
+    backend_acquire();
+
+    const llama_model_params mp = model_params(p.llm);
+    if (p.llm.n_gpu_layers > 0 && p.llm.gpu_arbitrate) impl_->gpu = &GpuArbiter::for_device(p.llm.main_gpu);
+
+    impl_->model = llama_model_load_from_file(model_path.c_str(), mp);
+    if (!impl_->model) {
+        std::fprintf(stderr, "LlamaSessions: failed to load model: %s\n", model_path.c_str());
+        std::exit(1);
+    }
+    impl_->vocab = llama_model_get_vocab(impl_->model);
+    if (!impl_->vocab) {
+        std::fprintf(stderr, "LlamaSessions: failed to get vocab\n");
+        std::exit(1);
+    }
+
+    // One context for everyone: a window of llm.n_ctx per session in a
+    // unified KV cache (the shared prefix cells are counted only once, so
+    // this leaves some slack), and a batch that always fits one generated
+    // token per session.
+    impl_->n_ctx_seq = std::max<int32_t>(64, p.llm.n_ctx);
+    impl_->n_batch = std::max<int32_t>(std::max<int32_t>(8, p.max_batch_tokens > 0 ? p.max_batch_tokens : p.llm.n_batch),
+                                       p.max_sessions);
+    LlamaBrain::Params cp_in = p.llm;
+    cp_in.n_ctx   = impl_->n_ctx_seq * p.max_sessions;
+    cp_in.n_batch = impl_->n_batch;
+    if (!context_params(cp_in, impl_->cparams)) {
+        std::fprintf(stderr, "LlamaSessions: unknown kv_type '%s' (f16, q8_0, q4_0)\n", p.llm.kv_type.c_str());
+        std::exit(1);
+    }
+    impl_->cparams.n_seq_max  = (uint32_t)p.max_sessions + 1;
+    impl_->cparams.kv_unified = true;
+
+    impl_->ctx = llama_init_from_model(impl_->model, impl_->cparams);
+    if (!impl_->ctx) {
+        std::fprintf(stderr, "LlamaSessions: failed to create context\n");
+        std::exit(1);
+    }
+    impl_->n_batch = std::min<int32_t>(impl_->n_batch, (int32_t)llama_n_batch(impl_->ctx));
+    std::fprintf(stderr, "[llm] sessions=%d n_ctx=%d/session n_batch=%d n_ubatch=%u threads=%d/%d flash_attn=%s\n",
+                 p.max_sessions, impl_->n_ctx_seq, impl_->n_batch, impl_->cparams.n_ubatch,
+                 impl_->cparams.n_threads, impl_->cparams.n_threads_batch, flash_attn_name(impl_->cparams));
+    print_memory("main", impl_->model, impl_->cparams);
+
+    impl_->sessions.resize((size_t)p.max_sessions);
+    for (size_t i = 0; i < impl_->sessions.size(); i++) {
+        Impl::Session& s = impl_->sessions[i];
+        s.seq = (llama_seq_id)(i + 1);
+        s.sampler = make_sampler();
+        if (!s.sampler) {
+            std::fprintf(stderr, "LlamaSessions: failed to init sampler\n");
+            std::exit(1);
+        }
+    }
+
+    impl_->prefix_toks = tokenize_prompt(impl_->vocab, build_system_prefix(p.llm), /*add_special=*/true);
+    impl_->turn_end_toks = tokenize_prompt(impl_->vocab, "\n", /*add_special=*/false);
+    if ((int32_t)impl_->prefix_toks.size() > impl_->n_ctx_seq / 2) {
+        std::fprintf(stderr, "LlamaSessions: system prompt too long (%zu tokens, n_ctx=%d)\n",
+                     impl_->prefix_toks.size(), impl_->n_ctx_seq);
+        std::exit(1);
+    }
+
+    impl_->batch = llama_batch_init(impl_->n_batch, 0, 1);
+    llama_pos pos = 0;
+    const bool ok = prefill_chunked(impl_->ctx, impl_->gpu, impl_->batch, impl_->n_batch,
+                                    impl_->prefix_toks.data(), impl_->prefix_toks.size(), pos);
+    llama_memory_breakdown_print(impl_->ctx);
+    if (!ok) {
+        std::fprintf(stderr, "LlamaSessions: failed to decode system prefix\n");
+        std::exit(1);
+    }
+    impl_->n_prefix = pos;
+
+    impl_->sched_thread = std::thread([this]() { impl_->loop(); });
+}
+
+LlamaSessions::~LlamaSessions() {
+    if (!impl_) return;
+
+    {
+        std::lock_guard<std::mutex> lk(impl_->mu);
+        impl_->stop = true;
+    }
+    impl_->work_cv.notify_all();
+    if (impl_->sched_thread.joinable()) impl_->sched_thread.join();
+
+    for (Impl::Session& s : impl_->sessions) {
+        if (s.sampler) llama_sampler_free(s.sampler);
+    }
+    llama_batch_free(impl_->batch);
+    if (impl_->ctx)   llama_free(impl_->ctx);
+    if (impl_->model) llama_model_free(impl_->model);
+
+    backend_release();
+
+    delete impl_;
+    impl_ = nullptr;
+}
+
+int LlamaSessions::open() {
+    std::lock_guard<std::mutex> lk(impl_->mu);
+    for (size_t i = 0; i < impl_->sessions.size(); i++) {
+        Impl::Session& s = impl_->sessions[i];
+        if (s.open) continue;
+        s.open = true;
+        s.cancel = s.reset = false;
+        s.stats = Stats{};
+        impl_->sched.open_sessions++;
+        impl_->sched.peak_sessions = std::max(impl_->sched.peak_sessions, impl_->sched.open_sessions);
+        return (int)i;
+    }
+    return -1;
+}
+
+void LlamaSessions::close(int sid) {
+    if (sid < 0 || sid >= (int)impl_->sessions.size()) return;
+    std::unique_lock<std::mutex> lk(impl_->mu);
+    Impl::Session& s = impl_->sessions[(size_t)sid];
+    if (!s.open) return;
+    s.closing = true;
+    s.cancel = true;
+    impl_->work_cv.notify_one();
+    impl_->done_cv.wait(lk, [&]{ return !s.open || impl_->stop; });
+}
+
+std::string LlamaSessions::reply_stream(int sid, const std::string& user_text, const PieceFn& on_piece) {
+    return impl_->run(sid, user_text, on_piece, impl_->p.llm.max_new_tokens);
+}
+
+void LlamaSessions::cancel(int sid) {
+    if (sid < 0 || sid >= (int)impl_->sessions.size()) return;
+    std::lock_guard<std::mutex> lk(impl_->mu);
+    Impl::Session& s = impl_->sessions[(size_t)sid];
+    if (!s.req) return;
+    s.cancel = true;
+    impl_->work_cv.notify_one();
+}
+
+void LlamaSessions::reset_history(int sid) {
+    if (sid < 0 || sid >= (int)impl_->sessions.size()) return;
+    std::unique_lock<std::mutex> lk(impl_->mu);
+    Impl::Session& s = impl_->sessions[(size_t)sid];
+    if (!s.open) return;
+    s.reset = true;
+    impl_->work_cv.notify_one();
+    impl_->done_cv.wait(lk, [&]{ return !s.reset || impl_->stop; });
+}
+
+bool LlamaSessions::warmup() {
+    const int sid = open();
+    if (sid < 0) return false;
+    impl_->run(sid, "Hello.", nullptr, /*max_new=*/1);
+    const bool ok = last_stats(sid).turn.gen_tokens > 0;
+    close(sid);
+    return ok;
+}
+
+LlamaSessions::Stats LlamaSessions::last_stats(int sid) const {
+    if (sid < 0 || sid >= (int)impl_->sessions.size()) return Stats{};
+    std::lock_guard<std::mutex> lk(impl_->mu);
+    return impl_->sessions[(size_t)sid].stats;
+}
+
+LlamaSessions::SchedStats LlamaSessions::sched_stats() const {
+    std::lock_guard<std::mutex> lk(impl_->mu);
+    return impl_->sched;
+}
+
+int LlamaSessions::max_sessions() const {
+    return (int)impl_->sessions.size();
+}
@@ -0,0 +1,96 @@
+// llm_sessions.hpp
+#pragma once
+
+#include "llm_llama.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+ * LlamaSessions
+ *
+ * One model and one llama_context shared by several concurrent
+ * conversations (edna_server: one per room). Each session owns a KV
+ * sequence (seq 1..max_sessions); seq 0 holds the system prompt, decoded
+ * once and copied into a session's sequence when it opens (with a unified
+ * KV cache the copy shares the cells, it does not duplicate them).
+ *
+ * reply_stream() calls from different threads do not take turns on the
+ * context the way LlamaBrain's reply_mu_ makes them. A scheduler thread
+ * merges them into shared llama_decode batches instead: every step carries
+ * the next token of each session that is generating, and the room left
+ * after those goes to prompt chunks of sessions that are prefilling,
+ * round-robin. N rooms generating at once cost about one decode per token,
+ * not N (generation is bound by reading the weights, not by batch size).
+ *
+ * Per session the behavior is LlamaBrain's: history stays in the KV cache
+ * and slides out when the session's n_ctx window fills, cancel() drops the
+ * partial turn, replies stop at the first newline. No draft model.
+ */
+class LlamaSessions {
+public:
+    struct Params {
+        // Model, threads, KV cache type, prompt and generation controls.
+        // n_ctx, max_prompt_tokens and the history limits apply per session.
+        LlamaBrain::Params llm;
+
+        int max_sessions = 4;       // admission limit: one KV sequence each
+        int max_batch_tokens = 0;   // tokens per merged llama_decode; 0 = llm.n_batch
+    };
+
+    struct Stats {
+        LlamaBrain::Stats turn;     // as LlamaBrain (no draft counters)
+        double queue_ms = 0.0;      // reply_stream() -> first decode with this turn in it
+        double batch_sessions = 0.0;// sessions per decode, averaged over this turn's decodes
+    };
+
+    // Scheduler counters since construction.
+    struct SchedStats {
+        uint64_t decodes   = 0;
+        uint64_t tokens    = 0;     // summed over decodes
+        uint64_t seq_slots = 0;     // sessions per decode, summed
+        int open_sessions  = 0;
+        int peak_sessions  = 0;
+
+        double avg_tokens()   const { return decodes ? (double)tokens / decodes : 0.0; }
+        double avg_sessions() const { return decodes ? (double)seq_slots / decodes : 0.0; }
+    };
+
+    using PieceFn = LlamaBrain::PieceFn;
+
+    LlamaSessions(const std::string& model_path, const Params& p);
+    ~LlamaSessions();
+
+    LlamaSessions(const LlamaSessions&) = delete;
+    LlamaSessions& operator=(const LlamaSessions&) = delete;
+
+    // Admission: a session id, or -1 if max_sessions are already open.
+    int open();
+
+    // Cancel anything in flight and free the session's KV sequence. Blocks
+    // until the scheduler has done so; the id may then be handed out again.
+    void close(int sid);
+
+    // As LlamaBrain::reply_stream, for one session: on_piece runs on the
+    // calling thread. One reply per session at a time.
+    std::string reply_stream(int sid, const std::string& user_text, const PieceFn& on_piece);
+
+    // Barge-in for one session (any thread).
+    void cancel(int sid);
+
+    // Forget one session's conversation.
+    void reset_history(int sid);
+
+    // Prefill a short turn and decode one token, then drop both (see
+    // LlamaBrain::warmup). Needs a free session slot.
+    bool warmup();
+
+    Stats last_stats(int sid) const;
+    SchedStats sched_stats() const;
+    int max_sessions() const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
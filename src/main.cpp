@@ -6,14 +6,30 @@
 #include "llm_llama.hpp"
 #include "tts_coqui.hpp"
 #include "state_machine.hpp"
-
+#include "text_util.hpp"
+#include "spsc_ring.hpp"
+#include "circular_buffer.hpp"
+#include "pcm_convert.hpp"
+#include "aec.hpp"
+#include "endpointer.hpp"
+#include "pipeline.hpp"
+#include "gpu_arbiter.hpp"
+#include "trace.hpp"
+#include "intent_router.hpp"
+#include "reactor.hpp"
+#ifdef EDNA_HAVE_PIPER
+#include "piper_tts.hpp"
+#endif
+
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <csignal>
 #include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -22,6 +38,10 @@
 #include <iostream>
 #include <cmath>
 #include <chrono>
+#include <cerrno>
+
+#include <poll.h>
+#include <sys/epoll.h>
 
 static constexpr const char* COLOR_RESET = "\033[0m";
 static constexpr const char* COLOR_ASR   = "\033[1;32m"; // bright green
@@ -42,118 +62,41 @@ static void die(const char* msg, int err = 0) {
     std::exit(1);
 }
 
-static std::atomic<bool> g_running{true};
-static void on_sigint(int) { g_running.store(false); }
-
-static std::string trim_ws(const std::string& s) {
-    size_t a = 0, b = s.size();
-    while (a < b && std::isspace((unsigned char)s[a])) a++;
-    while (b > a && std::isspace((unsigned char)s[b - 1])) b--;
-    return s.substr(a, b - a);
-}
-
-static std::string normalize(const std::string& in) {
-    std::string s;
-    s.reserve(in.size());
-    for (unsigned char c : in) {
-        if (std::isalnum(c) || std::isspace(c)) s.push_back((char)std::tolower(c));
-        else s.push_back(' ');
-    }
-    // collapse spaces
-    std::string out;
-    out.reserve(s.size());
-    bool prev_space = true;
-    for (unsigned char c : s) {
-        bool sp = std::isspace(c);
-        if (sp) {
-            if (!prev_space) out.push_back(' ');
-        } else {
-            out.push_back((char)c);
-        }
-        prev_space = sp;
-    }
-    return trim_ws(out);
-}
-
-static bool strip_invocation(std::string& text) {
-    std::string t = normalize(text);
-
-    auto strip_prefix = [&](const std::string& pfx) -> bool {
-        if (t.rfind(pfx, 0) == 0) {
-            t = trim_ws(t.substr(pfx.size()));
-            return true;
-        }
-        return false;
-    };
-
-    // Strip longer prefixes first. Include aliases for common Whisper mishears.
-    bool invoked =
-        strip_prefix("hey edna")  ||
-        strip_prefix("okay edna") ||
-        strip_prefix("ok edna")   ||
-        strip_prefix("edna")      ||
-        strip_prefix("etna")      ||
-        strip_prefix("ewa")       ||
-        strip_prefix("ed")        ||
-        strip_prefix("ed nah")    ||
-        strip_prefix("ed na");
-
-    if (!invoked) return false;
-
-    text = t;   // leave only the remainder (may be empty)
-    return true;
+static double frame_rms(const int16_t* x, size_t n) {
+    double acc = 0.0;
+    for (size_t i = 0; i < n; i++) acc += (double)x[i] * (double)x[i];
+    return n ? std::sqrt(acc / (double)n) : 0.0;
 }
 
-static std::vector<std::string> split_sentences(const std::string& in) {
-    // Cheap splitter to reduce TTS latency by synthesizing smaller chunks.
-    std::vector<std::string> out;
-    std::string cur;
-    cur.reserve(in.size());
+// A command for the brain stage, tagged with the turn (utterance id) it
+// came from for tracing.
+struct Command {
+    uint64_t turn = 0;
+    std::string text;
+    std::chrono::steady_clock::time_point queued{};
 
-    auto flush = [&]() {
-        std::string s = trim_ws(cur);
-        cur.clear();
-        if (!s.empty()) out.push_back(std::move(s));
-    };
+    // Answered by the IntentRouter: speak reply instead of asking the LLM.
+    std::string intent;
+    std::string reply;
+    bool announce = false;   // not a reply to the user (timer expired)
+};
 
-    for (size_t i = 0; i < in.size(); ++i) {
-        char c = in[i];
-        cur.push_back(c);
-
-        const bool end_punct = (c == '.' || c == '!' || c == '?');
-        if (!end_punct) continue;
-
-        const bool at_end = (i + 1 >= in.size());
-        const bool next_space = (!at_end && std::isspace((unsigned char)in[i + 1]));
-        if (at_end || next_space) flush();
-    }
-    flush();
-
-    // If we didn't find punctuation, fall back to a soft wrap.
-    if (out.size() <= 1 && !out.empty() && out[0].size() > 180) {
-        std::string s = out[0];
-        out.clear();
-        size_t pos = 0;
-        while (pos < s.size()) {
-            size_t take = std::min<size_t>(180, s.size() - pos);
-            size_t cut = s.rfind(' ', pos + take);
-            if (cut == std::string::npos || cut <= pos) cut = pos + take;
-            out.push_back(trim_ws(s.substr(pos, cut - pos)));
-            pos = cut;
-            while (pos < s.size() && std::isspace((unsigned char)s[pos])) pos++;
-        }
-        // Remove empties.
-        std::vector<std::string> clean;
-        clean.reserve(out.size());
-        for (auto &p : out) if (!p.empty()) clean.push_back(std::move(p));
-        out.swap(clean);
-    }
-
-    return out;
+static std::atomic<bool> g_running{true};
+static Reactor* g_loop = nullptr;   // the capture loop; SIGINT stops it at once
+static void on_sigint(int) {
+    g_running.store(false);
+    if (g_loop) g_loop->stop();
 }
 
 
 int main() {
+    const auto t_main = std::chrono::steady_clock::now();   // cold-start reference
+
+    // Main-thread event loop: mic capture (ALSA poll descriptors), its
+    // watchdog timer, state machine transitions and shutdown all wake it;
+    // nothing here polls on a timeout.
+    Reactor loop;
+    g_loop = &loop;
     std::signal(SIGINT, on_sigint);
 
     // Audio capture settings
@@ -162,8 +105,13 @@ int main() {
     const int frame_ms = 20;
     const int frame_samples = (sr * frame_ms) / 1000; // 320
 
-    // Mic gate: while speaking, ignore mic; after speaking, ignore for a short cooldown
-    const int tts_cooldown_ms = 600; // tune: 300..800
+    // Echo cancellation: the TTS output is subtracted from the mic signal
+    // before VAD / Whisper, so the mic needs no cooldown after a reply.
+    const bool use_aec = true;
+
+    // Mic gate: while speaking, ignore mic (barge-in detection aside); after
+    // speaking, ignore for a short cooldown unless AEC removes the echo tail.
+    const int tts_cooldown_ms = use_aec ? 0 : 600; // tune: 300..800 without AEC
     const int cooldown_frames = (tts_cooldown_ms + frame_ms - 1) / frame_ms;
 
     const std::string TOP = require_env("EDNA_TOP_DIR");
@@ -172,194 +120,671 @@ int main() {
     const std::string llama_model_path =
         TOP + "/models/Qwen2.5-2B-Instruct.Q6_K.gguf";
 
+    /* ===================== Tracing ===================== */
+    // Per-turn latency spans (EDNA_TRACE, see trace.hpp). Off by default.
+    Tracer& trace = Tracer::instance();
+    {
+        Tracer::Params tp;
+        if (Tracer::params_from_env(tp)) trace.start(tp);
+    }
+
     /* ===================== State Machine ===================== */
     EdnaStateMachine::Config sm_cfg;
     EdnaStateMachine sm(sm_cfg);
 
-    sm.set_observer([](EdnaStateMachine::State from,
-                       EdnaStateMachine::State to,
-                       EdnaStateMachine::Event why,
-                       const std::string& note) {
+    // Transitions are also delivered to the capture loop (on_transition,
+    // set up with it) through the loop's eventfd, and ring sm_bell for
+    // threads waiting on a state change. Pushes to text_q ring it too, so
+    // the brain stage holding an announcement sleeps on it alone.
+    using SmTransition = std::function<void(EdnaStateMachine::State, EdnaStateMachine::State,
+                                            EdnaStateMachine::Event)>;
+    SmTransition on_transition;
+    EventFd sm_bell;
+
+    sm.set_observer([&](EdnaStateMachine::State from,
+                        EdnaStateMachine::State to,
+                        EdnaStateMachine::Event why,
+                        const std::string& note) {
+        trace.transition(EdnaStateMachine::state_name(from), std::chrono::steady_clock::now());
         std::fprintf(stderr, "[SM] %s --(%s)--> %s%s%s\n",
                      EdnaStateMachine::state_name(from),
                      EdnaStateMachine::event_name(why),
                      EdnaStateMachine::state_name(to),
                      note.empty() ? "" : " : ",
                      note.empty() ? "" : note.c_str());
+        loop.post([&on_transition, from, to, why] {
+            if (on_transition) on_transition(from, to, why);
+        });
+        sm_bell.signal();
     });
 
-    sm.start();
+    /* ===================== Stages ===================== */
+    // Default placement for the 6-core Orin: capture alone on core 0
+    // (SCHED_FIFO, it must never miss a period), ASR on 2-3 and the LLM on
+    // 4-5, so neither competes with the other or with the audio threads.
+    // Playback and TTS synthesis share core 1 (the TTS worker forks from the
+    // synth thread and inherits its mask): playback is SCHED_FIFO and takes
+    // the core the moment it has a period to write, and synthesis itself
+    // runs on the GPU.
+    // Override per stage with EDNA_CPUS_<STAGE>="a,b" or "a-b"; "" unpins.
+    // On smaller machines nothing is pinned by default. Thread counts do not
+    // follow the placement: EDNA_THREADS_ASR / EDNA_THREADS_BRAIN (default 4).
+    const bool pin_default = std::thread::hardware_concurrency() >= 6;
+    auto cpus = [&](const char* name, std::vector<int> dflt) {
+        return stage_cpus_from_env(name, pin_default ? dflt : std::vector<int>{});
+    };
+    const StageConfig capture_cfg{"capture", cpus("capture", {0}), 0, 60};
+    const StageConfig asr_cfg    {"asr",     cpus("asr",     {2, 3}), 0, 0};
+    const StageConfig brain_cfg  {"brain",   cpus("brain",   {4, 5}), 0, 0};
+    const StageConfig synth_cfg  {"tts-synth", cpus("tts_synth", {1}), 0, 0};
+    const StageConfig play_cfg   {"tts-play",  cpus("tts_play",  {1}), 0, 50};
 
     /* ===================== Queues ===================== */
-    std::mutex q_m, b_m;
-    std::condition_variable q_cv, b_cv;
-
-    std::deque<std::vector<int16_t>> audio_q; // audio -> ASR
-    std::deque<std::string> text_q;           // transcript -> brain
+    // Rung by the capture loop for every frame it pushes (and at shutdown);
+    // the ASR thread sleeps on it. Counted, so no wakeup is ever lost.
+    EventFd audio_bell;
+
+    // Capture -> ASR. The capture loop pushes 20 ms frames into a preallocated
+    // lock-free ring (never allocates, never waits on the ASR thread); the ASR
+    // thread rebuilds the utterance from Begin/End markers. Snapshot marks
+    // ask for a partial decode while speech is still going, so the final
+    // decode at End only has the uncommitted tail left.
+    using AudioRing = SpscRing<AudioFrame, 1024>;   // ~20 s of frames
+    auto audio_ring = std::make_unique<AudioRing>();
+    // Utterances with id <= this are stale (mic was gated after they started).
+    // An atomic rather than a ring marker: it also voids an End already queued
+    // ahead of the gate, which a marker behind it would arrive too late for.
+    std::atomic<uint64_t> asr_cancel_utt{0};
+    // Held across a barge-in's two cancels and the brain stage's read of the
+    // two generations they advance, so a reply sees both or neither.
+    std::mutex barge_m;
+    // ASR -> brain. A newer command supersedes one still waiting.
+    BoundedQueue<Command> text_q("text", 2, BoundedQueue<Command>::Overflow::DropOldest);
+
+    // Speech start/end decisions for the capture loop. The ASR thread feeds
+    // it partial-transcript cues, hence it lives up here.
+    Endpointer::Params ep_p;
+    ep_p.frame_ms = frame_ms;
+    Endpointer ep(ep_p);
+
+    // Turn whose first played audio has not been seen yet (tracing only).
+    std::atomic<uint64_t> first_audio_turn{0};
 
     /* ===================== Init ASR + LLM + TTS ===================== */
+    // One GPU on the Orin. Engines on the same device share a GpuArbiter
+    // (ASR finalize > LLM decode > ASR partial > TTS prefetch); give them
+    // different devices on a multi-GPU box and they stop waiting on each other.
+    const int gpu_device = 0;
+
     WhisperASR::Params asr_p;
     asr_p.use_gpu = true;
-    asr_p.n_threads = 4;
+    asr_p.gpu_device = gpu_device;
+    asr_p.n_threads = stage_threads_from_env("asr", 4);
     asr_p.single_segment = true;
     asr_p.no_context = true;
     asr_p.language = "en";
-    WhisperASR asr(whisper_model_path, asr_p);
+    // Encoder window and token budget follow the utterance length;
+    // EDNA_ASR_FULL_CTX=1 runs whisper's full 30 s window (for comparison).
+    if (const char* v = std::getenv("EDNA_ASR_FULL_CTX")) {
+        if (std::string(v) == "1") asr_p.scale_audio_ctx = asr_p.scale_max_tokens = false;
+    }
+    // e.g. EDNA_WHISPER_FAST_MODEL=.../ggml-tiny.en.bin: final decodes while
+    // the GPU is busy use it instead of the main model.
+    if (const char* m = std::getenv("EDNA_WHISPER_FAST_MODEL")) asr_p.fast_model_path = m;
+    std::fprintf(stderr, "[asr] pcm convert kernel=%s\n", pcm_s16_to_f32_kernel());
 
     // Tuned for Qwen2.5-2B-Instruct (fast voice assistant)
     LlamaBrain::Params llm_p;
     llm_p.n_gpu_layers = 999; // offload everything that fits
+    llm_p.main_gpu = gpu_device;
     llm_p.n_ctx = 1024; // keep context short for latency
-    llm_p.n_threads = 4;
+    llm_p.n_threads = stage_threads_from_env("brain", 4);
     llm_p.n_batch = 256;
     llm_p.max_new_tokens = 96; // short spoken replies
-    LlamaBrain brain(llama_model_path, llm_p);
+    // EDNA_LLM_PROFILE=lowmem: q8_0 KV cache (half of f16) with flash
+    // attention and a smaller ubatch, spent on twice the history at about
+    // the same memory. EDNA_LLM_N_CTX / EDNA_LLM_KV_TYPE override either way;
+    // the "[llm] memory" line at load shows what a setting costs.
+    if (const char* prof = std::getenv("EDNA_LLM_PROFILE")) {
+        if (std::string(prof) == "lowmem") {
+            llm_p.kv_type = "q8_0";
+            llm_p.flash_attn = 1;
+            llm_p.n_ctx = 2048;
+            llm_p.n_ubatch = 128;
+        }
+    }
+    if (const char* v = std::getenv("EDNA_LLM_N_CTX")) llm_p.n_ctx = std::max(256, std::atoi(v));
+    if (const char* v = std::getenv("EDNA_LLM_KV_TYPE")) llm_p.kv_type = v;
+    // Optional draft model for speculative decoding (same tokenizer family),
+    // e.g. EDNA_DRAFT_MODEL=$EDNA_TOP_DIR/models/Qwen2.5-0.5B-Instruct-Q8_0.gguf
+    if (const char* d = std::getenv("EDNA_DRAFT_MODEL")) llm_p.draft_model_path = d;
 
     CoquiTTS::Params tts_p;
     tts_p.out_device = "plughw:CARD=V3,DEV=0";
-    CoquiTTS tts(tts_p);
+    tts_p.cuda_device = gpu_device;
+    tts_p.synth_stage = synth_cfg;
+    tts_p.play_stage = play_cfg;
+    // Repeated phrases are replayed from memory; set EDNA_TTS_CACHE_DIR to
+    // keep them across restarts.
+    if (const char* d = std::getenv("EDNA_TTS_CACHE_DIR")) tts_p.cache_dir = d;
+    // EDNA_XTTS_WORKER=tools/xtts_worker.py: XTTS v2 voice cloned from
+    // EDNA_TTS_SPEAKER (reference wav), streamed in chunks. Needs the GPU.
+    if (const char* w = std::getenv("EDNA_XTTS_WORKER")) {
+        tts_p.worker_script = w;
+        tts_p.model_name = "tts_models/multilingual/multi-dataset/xtts_v2";
+        tts_p.use_cuda = true;
+        tts_p.ready_timeout_ms = 120000;
+        if (const char* s = std::getenv("EDNA_TTS_SPEAKER")) tts_p.speaker = s;
+    }
 
-    /* ===================== Brain Thread ===================== */
-    std::thread brain_thread([&](){
-        while (true) {
-            std::string text;
+    // EDNA_PIPER_MODEL=/path/voice.onnx swaps the Python worker for in-process
+    // Piper synthesis (builds with -DEDNA_USE_PIPER=ON).
+    std::unique_ptr<TtsEngine> tts_engine;
+#ifdef EDNA_HAVE_PIPER
+    if (const char* m = std::getenv("EDNA_PIPER_MODEL")) {
+        PiperTTS::Params pp;
+        pp.model_path = m;
+        if (const char* d = std::getenv("EDNA_PIPER_ESPEAK_DATA")) pp.espeak_data = d;
+        tts_engine.reset(new PiperTTS(pp));
+    }
+#endif
+
+    /* ===================== Startup ===================== */
+    // The three engines load concurrently, then each runs a throwaway
+    // decode (1 s of silence, a dummy prefill, one synthesis) so weights,
+    // CUDA kernels and the TTS worker are hot before the first turn. The
+    // state machine stays in Boot until all of it is done.
+    //   EDNA_STARTUP=serial  load one after another (per-engine cost alone)
+    //   EDNA_WARMUP=0        skip the warm-up (TTS then starts on first reply)
+    const char* startup_env = std::getenv("EDNA_STARTUP");
+    const bool parallel_start = !(startup_env && std::string(startup_env) == "serial");
+    const char* warmup_env = std::getenv("EDNA_WARMUP");
+    const bool warm_start = !(warmup_env && std::string(warmup_env) == "0");
+
+    std::unique_ptr<WhisperASR> asr_ptr;
+    std::unique_ptr<LlamaBrain> brain_ptr;
+    std::unique_ptr<CoquiTTS> tts_ptr;
+
+    struct EngineStart {
+        const char* name;
+        std::function<void()> load;
+        std::function<bool()> warm;
+        double load_ms = 0.0;
+        double warm_ms = 0.0;
+        bool warm_ok = true;
+    };
+    std::vector<EngineStart> engines{
+        {"asr",
+         [&]{ asr_ptr.reset(new WhisperASR(whisper_model_path, asr_p)); },
+         [&]{
+             const std::vector<float> silence(sr, 0.0f);
+             asr_ptr->transcribe_16k_mono_f32(silence.data(), silence.size());
+             return true;
+         }},
+        {"llm",
+         [&]{ brain_ptr.reset(new LlamaBrain(llama_model_path, llm_p)); },
+         [&]{ return brain_ptr->warmup(); }},
+        {"tts",
+         [&]{ tts_ptr.reset(new CoquiTTS(tts_p, std::move(tts_engine))); },
+         [&]{
+             // The worker forks from this thread: give it the synth
+             // thread's placement, as if started from there.
+             apply_stage_config(synth_cfg);
+             return tts_ptr->warmup();
+         }},
+    };
 
-            {
-                std::unique_lock<std::mutex> lk(b_m);
-                b_cv.wait(lk, [&]{ return !g_running.load() || !text_q.empty(); });
-
-                if (!text_q.empty()) {
-                    text = std::move(text_q.front());
-                    text_q.pop_front();
-                } else if (!g_running.load()) {
-                    break;
-                } else {
-                    continue;
-                }
+    auto start_engine = [&](EngineStart& e) {
+        const auto t0 = std::chrono::steady_clock::now();
+        e.load();
+        const auto t1 = std::chrono::steady_clock::now();
+        if (warm_start) e.warm_ok = e.warm();
+        e.load_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        e.warm_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count();
+    };
+    // Own thread per engine even when serial, so thread placement set during
+    // start-up never sticks to the main thread.
+    if (parallel_start) {
+        std::vector<std::thread> starters;
+        for (EngineStart& e : engines) starters.emplace_back(start_engine, std::ref(e));
+        for (std::thread& t : starters) t.join();
+    } else {
+        for (EngineStart& e : engines) std::thread(start_engine, std::ref(e)).join();
+    }
+
+    for (const EngineStart& e : engines) {
+        std::fprintf(stderr, "[perf] startup engine=%s load_ms=%.1f warm_ms=%.1f warm_ok=%d\n",
+                     e.name, e.load_ms, e.warm_ms, e.warm_ok ? 1 : 0);
+    }
+    std::fprintf(stderr, "[perf] startup mode=%s warmup=%d ready_ms=%.1f\n",
+                 parallel_start ? "parallel" : "serial", warm_start ? 1 : 0,
+                 std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t_main).count());
+
+    WhisperASR& asr = *asr_ptr;
+    LlamaBrain& brain = *brain_ptr;
+    CoquiTTS& tts = *tts_ptr;
+
+    // Deterministic fast path: time, date, volume, timers, stop and
+    // "repeat that" are answered without the LLM (EDNA_INTENTS=0: off).
+    IntentRouter::Params intent_p;
+    if (const char* v = std::getenv("EDNA_INTENTS")) intent_p.enabled = std::string(v) != "0";
+    IntentRouter router(intent_p);
+    tts.set_volume(router.volume());
+    router.set_volume_fn([&](int percent) { tts.set_volume(percent); });
+    router.set_announce([&](const std::string& text) {
+        Command c;
+        c.intent = "announce";
+        c.reply = text;
+        c.announce = true;
+        c.queued = std::chrono::steady_clock::now();
+        text_q.push(std::move(c));
+        sm_bell.signal();
+    });
+
+    // Everything is loaded (and warm): leave Boot.
+    sm.start();
+
+    EchoCanceller::Params aec_p;
+    aec_p.sample_rate = sr;
+    EchoCanceller aec(aec_p);
+    if (use_aec || Tracer::on()) {
+        tts.set_playback_tap([&](const int16_t* pcm, size_t frames, unsigned rate, unsigned ch,
+                                 std::chrono::steady_clock::time_point play_at) {
+            if (use_aec) aec.push_reference(pcm, frames, rate, ch, play_at);
+            if (Tracer::on() && first_audio_turn.load(std::memory_order_relaxed)) {
+                const uint64_t turn = first_audio_turn.exchange(0);
+                if (turn) trace.since_anchor(turn, "first_audio", play_at);
             }
+        });
+    }
 
-            text = trim_ws(text);
-            if (text.empty() || text == "[BLANK_AUDIO]") continue;
-            
-            auto llm0 = std::chrono::steady_clock::now();
-            std::string reply = brain.reply(text);
-            
-            auto strip_after_any = [&](std::string& s, const std::vector<std::string>& toks) {
-                size_t cut = std::string::npos;
-                for (const auto& t : toks) {
-                    size_t p = s.find(t);
-                    if (p != std::string::npos)
-                        cut = std::min(cut, p);
+    /* ===================== Brain Stage ===================== */
+    Stage brain_stage(brain_cfg, [&](){
+        Command job;
+        // Announcements wait here until the conversation is idle; user
+        // commands still queued go first.
+        std::deque<Command> held;
+        while (true) {
+            if (held.empty() ? !text_q.pop(job) : !text_q.try_pop(job)) {
+                if (held.empty() || !g_running.load()) break;
+                if (!sm.dispatch(EdnaStateMachine::Event::Announce, held.front().reply)) {
+                    // Not idle: retry on the next transition or text_q push.
+                    sm_bell.wait();
+                    continue;
                 }
-                if (cut != std::string::npos)
-                    s.resize(cut);
-            
-                // full trim, not just tail
-                s = trim_ws(s);
-            };
-            
-            strip_after_any(reply, {
-                "<|endoftext|>",
-                "<|im_end|>",
-                "\nHuman:",
-                "\nUSER:",
-                "\nUser:",
-                "\n### Human:",
-                "\n### Instruction:"
-            });
-            
-            // optional safety net
-            if (reply.empty()) {
-                sm.dispatch(EdnaStateMachine::Event::NoCommand, "empty reply");
+                job = std::move(held.front());
+                held.pop_front();
+            } else if (job.announce) {
+                held.push_back(std::move(job));
                 continue;
             }
-            
-            auto llm1 = std::chrono::steady_clock::now();
-            std::fprintf(stderr, "[perf] llm_ms=%lld\n",
-                (long long)std::chrono::duration_cast<std::chrono::milliseconds>(llm1 - llm0).count());
-            std::fflush(stderr);
-            
-            sm.dispatch(EdnaStateMachine::Event::ReplyReady);
 
-            std::printf("%sEDNA: %s%s\n", COLOR_EDNA, reply.c_str(), COLOR_RESET);
-            std::fflush(stdout);
+            const uint64_t turn = job.turn;
+            const bool routed = !job.intent.empty();
+            trace.span(turn, "brain_queue", job.queued, std::chrono::steady_clock::now());
+            const std::string text = trim_ws(job.text);
+            if (!routed && (text.empty() || text == "[BLANK_AUDIO]")) continue;
+
+            // Every barge-in advances the brain's cancel generation and the
+            // TTS epoch. Taken here, with the job: a barge-in from now on
+            // cancels this reply even if it lands before generation starts,
+            // and TTS drops any sentence (routed ones too) enqueued after it.
+            uint64_t gen, tts_epoch;
+            {
+                std::lock_guard<std::mutex> lk(barge_m);
+                gen = brain.cancel_gen();
+                tts_epoch = tts.epoch();
+            }
+            auto interrupted = [&]{ return brain.cancel_gen() != gen; };
 
-            // TTS (always print status + timing so we know what happened)
-            std::fprintf(stderr, "[tts] enabled=%d device='%s' err='%s'\n",
-                         tts.is_enabled() ? 1 : 0,
-                         tts_p.out_device.c_str(),
-                         tts.last_error().c_str());
-            std::fflush(stderr);
+            auto llm0 = std::chrono::steady_clock::now();
 
-            auto tts0 = std::chrono::steady_clock::now();
+            // Stream pieces into the sentence splitter; each complete sentence
+            // goes to TTS right away while the LLM keeps generating.
+            SentenceSplitter splitter;
+            std::vector<std::string> sentences;
+            bool first_piece = true;
+            bool speaking = false;
             bool tts_ok = true;
+            auto tts0 = std::chrono::steady_clock::now();
 
-            if (tts.is_enabled()) {
-                // Sentence-by-sentence synthesis: start audio sooner, especially for long replies.
-                const auto parts = split_sentences(reply);
-                tts_ok = true;
-
-                for (size_t i = 0; i < parts.size(); ++i) {
-                    const std::string chunk = trim_ws(parts[i]);
-                    if (chunk.empty()) continue;
-
-                    const bool ok = tts.speak(chunk);
-                    if (!ok) {
-                        tts_ok = false;
-                        std::fprintf(stderr, "[tts] speak() FAILED: %s\n", tts.last_error().c_str());
+            auto hand_off = [&]() {
+                if (interrupted()) {
+                    sentences.clear();
+                    return;
+                }
+                for (auto& sent : sentences) {
+                    if (!speaking) {
+                        speaking = true;
+                        const auto first = std::chrono::steady_clock::now();
+                        std::fprintf(stderr, "[perf] first_sentence_ms=%lld\n",
+                            (long long)std::chrono::duration_cast<std::chrono::milliseconds>(first - llm0).count());
+                        trace.span(turn, "llm_first_sentence", llm0, first);
+                        if (Tracer::on()) first_audio_turn.store(turn);
+                        sm.dispatch(EdnaStateMachine::Event::ReplyReady);
+
+                        // TTS (always print status + timing so we know what happened)
+                        std::fprintf(stderr, "[tts] enabled=%d device='%s' err='%s'\n",
+                                     tts.is_enabled() ? 1 : 0,
+                                     tts_p.out_device.c_str(),
+                                     tts.last_error().c_str());
                         std::fflush(stderr);
-                        break;
+                        tts0 = first;
                     }
+                    // Synthesis + playback are pipelined inside CoquiTTS;
+                    // this returns immediately.
+                    if (tts.is_enabled() && !tts.enqueue(sent, tts_epoch)) tts_ok = false;
                 }
+                sentences.clear();
+            };
 
-                if (tts_ok) {
-                    std::fprintf(stderr, "[tts] speak() OK\n");
-                    std::fflush(stderr);
+            std::string reply;
+            if (routed) {
+                // Answered by the IntentRouter: nothing to generate.
+                reply = job.reply;
+                sentences = split_sentences(reply);
+                hand_off();
+                std::fprintf(stderr, "[perf] intent=%s think_ms=%.2f\n", job.intent.c_str(),
+                             std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - llm0).count());
+                trace.span(turn, "intent", llm0, std::chrono::steady_clock::now());
+            } else {
+                reply = brain.reply_stream(text, [&](const std::string& piece) {
+                    if (first_piece) {
+                        first_piece = false;
+                        const auto t = std::chrono::steady_clock::now();
+                        trace.span(turn, "llm_ttft", llm0, t);
+                        trace.since_anchor(turn, "first_token", t);
+                    }
+                    splitter.feed(piece, sentences);
+                    hand_off();
+                }, gen);
+                splitter.flush(sentences);
+                hand_off();
+
+                auto strip_after_any = [&](std::string& s, const std::vector<std::string>& toks) {
+                    size_t cut = std::string::npos;
+                    for (const auto& t : toks) {
+                        size_t p = s.find(t);
+                        if (p != std::string::npos)
+                            cut = std::min(cut, p);
+                    }
+                    if (cut != std::string::npos)
+                        s.resize(cut);
+
+                    // full trim, not just tail
+                    s = trim_ws(s);
+                };
+
+                strip_after_any(reply, {
+                    "<|endoftext|>",
+                    "<|im_end|>",
+                    "\nHuman:",
+                    "\nUSER:",
+                    "\nUser:",
+                    "\n### Human:",
+                    "\n### Instruction:"
+                });
+            }
+
+            // Barge-in: the capture loop already cancelled TTS and moved the
+            // state machine on; just let the pipeline settle.
+            if (interrupted()) {
+                tts.wait_idle();
+                std::printf("%sEDNA: %s [interrupted]%s\n", COLOR_EDNA, reply.c_str(), COLOR_RESET);
+                std::fflush(stdout);
+                if (!routed) {
+                    std::fprintf(stderr, "[perf] barge_in llm_cancelled=%d gen_tok=%d\n",
+                                 brain.last_stats().cancelled ? 1 : 0, brain.last_stats().gen_tokens);
                 }
+                first_audio_turn.store(0);
+                continue;
+            }
+
+            // optional safety net
+            if (!speaking) {
+                sm.dispatch(EdnaStateMachine::Event::NoCommand, "empty reply");
+                continue;
             }
 
+            if (!routed) {
+                auto llm1 = std::chrono::steady_clock::now();
+                trace.span(turn, "llm", llm0, llm1);
+                const LlamaBrain::Stats ls = brain.last_stats();
+                std::fprintf(stderr, "[perf] llm_ms=%lld ttft_ms=%.1f cached_tok=%d prefill_tok=%d prefill_ms=%.1f prefill_tps=%.1f gen_tok=%d gen_ms=%.1f gen_tps=%.1f draft_tok=%d accept=%.2f hist_turns=%d hist_tok=%d evicted_tok=%d\n",
+                    (long long)std::chrono::duration_cast<std::chrono::milliseconds>(llm1 - llm0).count(),
+                    ls.ttft_ms, ls.cached_tokens, ls.prompt_tokens, ls.prefill_ms, ls.prefill_tps(),
+                    ls.gen_tokens, ls.gen_ms, ls.gen_tps(), ls.draft_tokens, ls.accept_rate(),
+                    ls.history_turns, ls.history_tokens, ls.evicted_tokens);
+                std::fflush(stderr);
+            }
+
+            std::printf("%sEDNA: %s%s\n", COLOR_EDNA, reply.c_str(), COLOR_RESET);
+            std::fflush(stdout);
+            router.set_last_reply(reply);
+
+            // Wait for the pipelined audio to play out before reopening the mic.
+            if (!tts.wait_idle()) tts_ok = false;
+            if (!tts_ok)                  std::fprintf(stderr, "[tts] speak() FAILED: %s\n", tts.last_error().c_str());
+            else if (tts.is_enabled())    std::fprintf(stderr, "[tts] speak() OK\n");
+
             auto tts1 = std::chrono::steady_clock::now();
+            trace.span(turn, "tts", tts0, tts1);
+            trace.since_anchor(turn, "turn_total", tts1);
             std::fprintf(stderr, "[perf] tts_ms=%lld ok=%d\n",
                          (long long)std::chrono::duration_cast<std::chrono::milliseconds>(tts1 - tts0).count(),
                          tts_ok ? 1 : 0);
+            const PcmCache::Stats cs = tts.cache_stats();
+            std::fprintf(stderr, "[perf] tts_cache hits=%llu disk_hits=%llu misses=%llu hit_rate=%.2f entries=%zu kb=%zu evictions=%llu\n",
+                         (unsigned long long)cs.hits, (unsigned long long)cs.disk_hits,
+                         (unsigned long long)cs.misses, cs.hit_rate(), cs.entries, cs.bytes / 1024,
+                         (unsigned long long)cs.evictions);
             std::fflush(stderr);
 
+            std::fputs(GpuArbiter::for_device(gpu_device).report().c_str(), stderr);
+
+            const auto tq = text_q.metrics();
+            std::fprintf(stderr, "[perf] queue=%s depth=%zu max_depth=%zu dropped=%llu\n",
+                         text_q.name().c_str(), tq.depth, tq.max_depth,
+                         (unsigned long long)tq.dropped);
+            std::fputs(trace.report().c_str(), stderr);
+
             sm.dispatch(EdnaStateMachine::Event::TtsDone);
         }
     });
+    brain_stage.start();
 
     /* ===================== ASR Thread ===================== */
-    std::thread asr_thread([&](){
+    // Invocation pre-filter: most audio is room chatter that strip_invocation
+    // would throw away anyway. Decode just the start of the utterance with a
+    // tiny token budget and skip the full decode if there is no "edna".
+    const int    prefilter_ms       = 1500;
+    const int    prefilter_tokens   = 6;
+    const double prefilter_min_secs = 2.0;  // shorter: full decode is about as cheap
+
+    // Silence trimming: decode the voiced part of the utterance (Voiced
+    // frames from the capture loop) plus padding, not the pre-roll before
+    // the onset and the endpoint hangover after it. EDNA_ASR_TRIM=0: off.
+    const char*  trim_env      = std::getenv("EDNA_ASR_TRIM");
+    const bool   asr_trim      = !(trim_env && std::string(trim_env) == "0");
+    const int    trim_lead_ms  = 120;
+    const int    trim_trail_ms = 200;
+
+    struct PrefilterStats {
+        uint64_t passed = 0;
+        uint64_t rejected = 0;
+        uint64_t false_pass = 0;          // passed, but full transcript had no invocation
+        double   saved_ms_total = 0.0;
+        double   full_ms_per_sec = 0.0;   // EMA of full-decode cost, for the estimate
+    };
+
+    Stage asr_stage(asr_cfg, [&](){
+        uint64_t stream_utt = 0;         // utterance the streaming state belongs to
+        bool stream_active = false;
+        bool partial_invoked = false;
+        PrefilterStats pf;
+
+        // Utterance being assembled from ring frames: fixed 30 s, allocated
+        // once. Frames are converted to float straight into it as they arrive,
+        // so each sample is converted exactly once no matter how many partial
+        // decodes see it. It is cleared per utterance, so linearize() is free
+        // unless an utterance runs past 30 s (then the oldest audio goes).
+        CircularBuffer<float> audio((size_t)sr * 30);
+        VoicedSpan voiced;
+        size_t stream_lead = 0;          // samples trimmed off the front of the streamed utterance
+        uint64_t cur_utt = 0;
+        AudioFrame f;
+
         while (true) {
-            std::vector<int16_t> audio;
+            // Drain what the capture loop has produced. Stop at End so the
+            // next utterance's frames stay queued until this one is decoded;
+            // several Snapshots in one drain collapse into a single partial.
+            bool want_partial = false;
+            bool want_final = false;
+            while (audio_ring->try_pop(f)) {
+                if (f.flags & AudioFrame::Begin) {
+                    audio.clear();
+                    voiced.reset();
+                    cur_utt = f.utt;
+                }
+                if (f.utt != cur_utt) continue;   // its Begin frame was dropped
+                const bool was_full = audio.full();
+                const size_t at = audio.size();
+                audio.push_fill(f.n, [&](float* dst, size_t k, size_t at) {
+                    pcm_s16_to_f32(f.pcm + at, dst, k);
+                });
+                if (audio.size() == at + f.n) voiced.add(at, f.n, (f.flags & AudioFrame::Voiced) != 0);
+                else                          voiced.invalidate();
+                // Dropping old audio shifts sample offsets under the stream.
+                if (was_full && stream_active && stream_utt == cur_utt) stream_active = false;
+                if (f.flags & AudioFrame::Snapshot) want_partial = true;
+                if (f.flags & AudioFrame::End) { want_final = true; break; }
+            }
 
-            {
-                std::unique_lock<std::mutex> lk(q_m);
-                q_cv.wait(lk, [&]{ return !g_running.load() || !audio_q.empty(); });
-
-                if (!audio_q.empty()) {
-                    audio = std::move(audio_q.back());  // newest only
-                    audio_q.clear();
-                } else if (!g_running.load()) {
-                    break;
-                } else {
+            if (!want_partial && !want_final) {
+                if (!g_running.load()) break;
+                audio_bell.wait();
+                continue;
+            }
+
+            if (cur_utt <= asr_cancel_utt.load(std::memory_order_acquire)) {
+                if (stream_active && stream_utt == cur_utt) stream_active = false;
+                continue;
+            }
+            if (audio.empty()) continue;
+            if (want_final) trace.since_anchor(cur_utt, "asr_start", std::chrono::steady_clock::now());
+            const float* samples = audio.linearize();
+            const size_t n_pcm = audio.size();
+            size_t keep0 = 0, keep1 = n_pcm;
+            if (asr_trim) voiced.bounds(n_pcm, trim_lead_ms * 16, trim_trail_ms * 16, keep0, keep1);
+
+            if (!want_final) {
+                if (!stream_active || cur_utt != stream_utt) {
+                    asr.stream_begin();
+                    stream_utt = cur_utt;
+                    stream_active = true;
+                    partial_invoked = false;
+                    stream_lead = keep0;   // fixed for the utterance: stream offsets build on it
+                }
+
+                auto p0 = std::chrono::steady_clock::now();
+                const WhisperASR::Partial part = asr.stream_update(samples + stream_lead, n_pcm - stream_lead);
+                auto p1 = std::chrono::steady_clock::now();
+                trace.span(cur_utt, "asr_partial", p0, p1);
+
+                // Invocation matching can start on the partial transcript.
+                std::string probe = part.text();
+                const bool invoked = strip_invocation(probe);
+                if (invoked && !partial_invoked) {
+                    partial_invoked = true;
+                    std::fprintf(stderr, "[asr] invocation seen in partial at %.2fs\n",
+                                 (double)n_pcm / 16000.0);
+                }
+                // A finished-looking command lets the endpointer stop waiting.
+                if (partial_invoked && looks_complete(part.text())) ep.cue_complete(cur_utt);
+                std::fprintf(stderr, "[asr] partial secs=%.2f ms=%lld committed='%s' tentative='%s'\n",
+                             (double)n_pcm / 16000.0,
+                             (long long)std::chrono::duration_cast<std::chrono::milliseconds>(p1 - p0).count(),
+                             part.committed.c_str(), part.tentative.c_str());
+                std::fflush(stderr);
+                continue;
+            }
+
+            const bool streamed = stream_active && cur_utt == stream_utt;
+            const size_t dec0 = streamed ? stream_lead : keep0;
+            const size_t dec1 = std::max(keep1, dec0);
+            const size_t n_dec = dec1 - dec0;
+            const double utt_secs = (double)n_dec / 16000.0;
+            if (dec0 > 0 || dec1 < n_pcm) {
+                std::fprintf(stderr, "[asr] trim secs=%.2f->%.2f lead_ms=%zu trail_ms=%zu\n",
+                             (double)n_pcm / 16000.0, utt_secs, dec0 / 16, (n_pcm - dec1) / 16);
+            }
+            if (utt_secs < 0.20) {
+                stream_active = false;
+                continue;
+            }
+
+            // Skip the pre-filter if a partial already confirmed the invocation.
+            bool pf_passed = false;
+            if (!(streamed && partial_invoked) && utt_secs >= prefilter_min_secs) {
+                auto f0 = std::chrono::steady_clock::now();
+                const std::string head = asr.transcribe_prefix(samples + dec0, n_dec,
+                                                               prefilter_ms, prefilter_tokens);
+                auto f1 = std::chrono::steady_clock::now();
+                trace.span(cur_utt, "asr_prefilter", f0, f1);
+                const double f_ms = std::chrono::duration<double, std::milli>(f1 - f0).count();
+
+                if (!has_invocation(head)) {
+                    pf.rejected++;
+                    const double saved = std::max(0.0, pf.full_ms_per_sec * utt_secs - f_ms);
+                    pf.saved_ms_total += saved;
+                    std::fprintf(stderr, "[asr] prefilter reject head='%s' ms=%.1f saved_ms~%.0f "
+                                         "(passed=%llu rejected=%llu total_saved_ms~%.0f)\n",
+                                 head.c_str(), f_ms, saved,
+                                 (unsigned long long)pf.passed, (unsigned long long)pf.rejected,
+                                 pf.saved_ms_total);
+                    std::fflush(stderr);
+
+                    stream_active = false;
+                    sm.dispatch(EdnaStateMachine::Event::NoCommand, "prefilter reject");
                     continue;
                 }
+                pf.passed++;
+                pf_passed = true;
+                std::fprintf(stderr, "[asr] prefilter pass head='%s' ms=%.1f\n", head.c_str(), f_ms);
             }
 
-            if (audio.empty()) continue;
+            // Commands still waiting for the brain: the pipeline is behind,
+            // take the fast model (if any) for this one.
+            if (asr.has_fast_model()) asr.prefer_fast(text_q.metrics().depth > 0);
 
             auto asr0 = std::chrono::steady_clock::now();
-            std::string txt = asr.transcribe_16k_mono_s16(audio);
+            std::string txt;
+            if (streamed) {
+                txt = asr.stream_finalize(samples + dec0, n_dec);
+            } else {
+                txt = asr.transcribe_16k_mono_f32(samples + dec0, n_dec);
+            }
+            stream_active = false;
             auto asr1 = std::chrono::steady_clock::now();
-            std::fprintf(stderr, "[perf] asr_ms=%lld\n",
-                         (long long)std::chrono::duration_cast<std::chrono::milliseconds>(asr1 - asr0).count());
+            trace.span(cur_utt, "asr_final", asr0, asr1);
+
+            if (!streamed && utt_secs > 0.0) {
+                const double ms_per_sec =
+                    std::chrono::duration<double, std::milli>(asr1 - asr0).count() / utt_secs;
+                pf.full_ms_per_sec = (pf.full_ms_per_sec == 0.0)
+                                         ? ms_per_sec
+                                         : 0.8 * pf.full_ms_per_sec + 0.2 * ms_per_sec;
+            }
+            const WhisperASR::Stats ws = asr.last_stats();
+            std::fprintf(stderr, "[perf] asr_ms=%lld mode=%s audio_ms=%.0f audio_ctx=%d max_tok=%d encode_ms=%.1f decode_ms=%.1f model=%s\n",
+                         (long long)std::chrono::duration_cast<std::chrono::milliseconds>(asr1 - asr0).count(),
+                         streamed ? "stream_tail" : "full", ws.audio_ms, ws.audio_ctx, ws.max_tokens,
+                         ws.encode_ms, ws.decode_ms, ws.fast_model ? "fast" : "main");
             std::fflush(stderr);
 
             txt = trim_ws(txt);
-            const double asr_secs = (double)audio.size() / 16000.0;
             std::fprintf(stderr, "[asr] secs=%.2f raw='%s' norm='%s'\n",
-                         asr_secs, txt.c_str(), normalize(txt).c_str());
+                         utt_secs, txt.c_str(), normalize(txt).c_str());
             std::fflush(stderr);
 
             if (txt.size() < 2 || txt == "[BLANK_AUDIO]") {
@@ -369,6 +794,11 @@ int main() {
 
             std::string cmd = txt;
             if (!strip_invocation(cmd)) {
+                if (pf_passed) {
+                    pf.false_pass++;
+                    std::fprintf(stderr, "[asr] prefilter false_pass=%llu of passed=%llu\n",
+                                 (unsigned long long)pf.false_pass, (unsigned long long)pf.passed);
+                }
                 sm.dispatch(EdnaStateMachine::Event::NoCommand, "ignored transcript");
                 continue;
             }
@@ -380,25 +810,56 @@ int main() {
             }
 
             std::cout << COLOR_ASR << "ASR: " << txt << COLOR_RESET << std::endl;
+
+            // Fast path: a command the router knows never reaches the LLM.
+            IntentRouter::Result routed;
+            const bool is_routed = router.route(cmd, routed);
+            if (is_routed) {
+                std::fprintf(stderr, "[intent] %s match_us=%.1f reply='%s'\n",
+                             routed.intent.c_str(), routed.match_us, routed.reply.c_str());
+                if (routed.reply.empty()) {   // "stop": nothing to say
+                    sm.dispatch(EdnaStateMachine::Event::NoCommand, "intent " + routed.intent);
+                    continue;
+                }
+            }
             sm.dispatch(EdnaStateMachine::Event::TranscriptReady);
             std::fflush(stdout);
 
-            {
-                std::lock_guard<std::mutex> lk(b_m);
-                text_q.emplace_back(std::move(cmd));   // enqueue COMMAND, not raw transcript
+            const auto queued = std::chrono::steady_clock::now();
+            trace.since_anchor(cur_utt, "transcript", queued);
+            Command job;   // enqueue COMMAND, not raw transcript
+            job.turn = cur_utt;
+            job.text = std::move(cmd);
+            job.queued = queued;
+            if (is_routed) {
+                job.intent = std::move(routed.intent);
+                job.reply = std::move(routed.reply);
             }
-            b_cv.notify_one();
+            text_q.push(std::move(job));
+            sm_bell.signal();
         }
     });
+    asr_stage.start();
 
     /* ===================== Audio + VAD ===================== */
     Fvad *vad = fvad_new();
     if (!vad) die("fvad_new failed");
     if (fvad_set_sample_rate(vad, sr) != 0) die("fvad_set_sample_rate failed");
-    fvad_set_mode(vad, 2); // 0..3 higher = more aggressive
-
+    const int vad_mode = 2;  // 0..3 higher = more aggressive
+    fvad_set_mode(vad, vad_mode);
+
+    // Barge-in detector, only fed while Edna is speaking. The mic hears the
+    // speaker too, so use the most aggressive VAD mode and also require the
+    // frame to be clearly louder than the running echo level.
+    Fvad *vad_echo = fvad_new();
+    if (!vad_echo) die("fvad_new failed");
+    if (fvad_set_sample_rate(vad_echo, sr) != 0) die("fvad_set_sample_rate failed");
+    fvad_set_mode(vad_echo, 3);
+
+    // Non-blocking: the loop reads when the PCM's poll descriptors say a
+    // period is ready, so a stop or a state change never waits on the mic.
     snd_pcm_t *pcm = nullptr;
-    int err = snd_pcm_open(&pcm, device, SND_PCM_STREAM_CAPTURE, 0);
+    int err = snd_pcm_open(&pcm, device, SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK);
     if (err < 0) die("snd_pcm_open failed", err);
 
     err = snd_pcm_set_params(pcm,
@@ -412,135 +873,331 @@ int main() {
 
     std::vector<int16_t> frame(frame_samples);
 
-    std::vector<int16_t> utterance;
-    utterance.reserve(sr * 10); // ~10s max
-
     // Pre-roll (for ASR)
     const int preroll_frames = 15;
     const size_t max_preroll_samples = (size_t)preroll_frames * (size_t)frame_samples;
-    std::vector<int16_t> preroll;
-    preroll.reserve(max_preroll_samples);
-
-    bool in_speech = false;
-    int voiced_run = 0;
-    int unvoiced_run = 0;
+    CircularBuffer<int16_t> preroll(max_preroll_samples);
+    CircularBuffer<uint8_t> preroll_voiced((size_t)preroll_frames);   // one verdict per frame
 
-    const int start_trigger = 3;  // 60 ms
-    const int stop_trigger  = 20; // 400 ms
+    // Streaming ASR: snapshot the utterance for a partial decode this often.
+    const int stream_step_frames = 50; // 1 s
+    uint64_t utt_id = 0;
+    int speech_frames = 0;
 
     // Mic gate state
     int ignore_frames = 0;
-    bool last_was_speaking = false;
+    bool edna_speaking = false;              // Speaking, as delivered by on_transition
+    bool gated = false;
+    bool cooldown_open = false;              // tracing: reply finished, mic not reopened yet
+    std::chrono::steady_clock::time_point cooldown_t0{};
+
+    // Barge-in (tune against the actual speaker/mic placement)
+    const int    bargein_trigger = 12;    // 240 ms of voiced, loud frames
+    const int    bargein_guard   = 15;    // first 300 ms of playback: learn echo only
+    const double bargein_ratio   = 2.5;   // ~8 dB over the echo level
+    const double bargein_min_rms = 500.0; // absolute floor (s16 units)
+    int    barge_run = 0;
+    int    speak_frames = 0;
+    double echo_rms = 0.0;
+
+    // Ring hand-off. A full ring drops frames rather than blocking the read;
+    // the End marker is retried on later frames so the utterance still closes.
+    AudioFrame out;
+    uint64_t ring_drops = 0;
+    bool end_pending = false;
+
+    auto push_frame = [&](const int16_t* pcm, uint32_t flags) -> bool {
+        out.utt = utt_id;
+        out.flags = flags;
+        out.n = pcm ? (uint32_t)frame_samples : 0;
+        if (pcm) std::copy(pcm, pcm + frame_samples, out.pcm);
+        if (!audio_ring->try_push(out)) {
+            ring_drops++;
+            return false;
+        }
+        audio_bell.signal();
+        return true;
+    };
 
-    std::puts("Listening (Ctrl-C to stop) ...");
+    // Starts a new utterance with the pre-roll as its onset.
+    std::vector<int16_t> preroll_frame((size_t)frame_samples);
+    auto begin_utterance = [&]() {
+        utt_id++;
+        trace.set_turn(utt_id);
+        ep.start(utt_id);
+        speech_frames = 0;
+        end_pending = false;   // a stale End for the old utterance is moot now
+        for (size_t off = 0, k = 0; off + (size_t)frame_samples <= preroll.size(); off += (size_t)frame_samples, k++) {
+            preroll.copy_out(off, preroll_frame.data(), (size_t)frame_samples);
+            uint8_t voiced = 0;
+            if (k < preroll_voiced.size()) preroll_voiced.copy_out(k, &voiced, 1);
+            push_frame(preroll_frame.data(), (off == 0 ? AudioFrame::Begin : 0u) |
+                                             (voiced ? AudioFrame::Voiced : 0u));
+        }
+    };
 
-    while (g_running.load()) {
-        snd_pcm_sframes_t got = snd_pcm_readi(pcm, frame.data(), frame_samples);
-        if (got < 0) {
-            got = snd_pcm_recover(pcm, (int)got, 1);
-            if (got < 0) die("snd_pcm_readi failed", (int)got);
-            continue;
+    // Cancel the reply in flight; the utterance that interrupted it is
+    // captured as usual from here on.
+    auto barge_in = [&](const char* why) {
+        {
+            std::lock_guard<std::mutex> lk(barge_m);
+            brain.cancel();
+            tts.cancel();
         }
-        if (got != frame_samples) continue;
+        sm.dispatch(EdnaStateMachine::Event::BargeIn, why);
+        std::puts(">>> barge-in");
+        std::fflush(stdout);
+    };
 
-        const auto st = sm.state();
-        const bool speaking_now = (st == EdnaStateMachine::State::Speaking);
+    auto update_preroll = [&](bool voiced) {
+        preroll.push(frame.data(), (size_t)frame_samples);
+        const uint8_t v = voiced ? 1 : 0;
+        preroll_voiced.push(&v, 1);
+    };
 
-        // Detect transition out of Speaking -> start cooldown
-        if (last_was_speaking && !speaking_now) {
+    // Transitions, on the loop thread. Entering Speaking arms barge-in
+    // detection; leaving it starts the cooldown, unless barge_in() already
+    // reopened the mic.
+    on_transition = [&](EdnaStateMachine::State from, EdnaStateMachine::State to,
+                        EdnaStateMachine::Event /*why*/) {
+        using S = EdnaStateMachine::State;
+        if (to == S::Speaking && !edna_speaking) {
+            edna_speaking = true;
+            barge_run = 0;
+            speak_frames = 0;
+            echo_rms = 0.0;
+        } else if (from == S::Speaking && to != S::Speaking && edna_speaking) {
+            edna_speaking = false;
             ignore_frames = cooldown_frames;
+            cooldown_open = Tracer::on();
+            cooldown_t0 = std::chrono::steady_clock::now();
+            if (use_aec) {
+                const EchoCanceller::Stats as = aec.stats();
+                std::fprintf(stderr, "[aec] erle_db=%.1f active_frames=%llu dtd_frames=%llu\n",
+                             as.erle_db, (unsigned long long)as.active_frames,
+                             (unsigned long long)as.dtd_frames);
+            }
+        }
+    };
+
+    // One complete 20 ms frame in `frame`.
+    auto on_frame = [&]() {
+        if (use_aec) {
+            // Sample 0 of this frame was captured (frame + still-buffered
+            // capture frames) ago.
+            snd_pcm_sframes_t pending = 0;
+            if (snd_pcm_delay(pcm, &pending) < 0 || pending < 0) pending = 0;
+            const auto captured_at = std::chrono::steady_clock::now() -
+                std::chrono::microseconds((int64_t)(pending + frame_samples) * 1000000 / sr);
+            aec.process(frame.data(), (size_t)frame_samples, captured_at);
+        }
+
+        if (end_pending && push_frame(nullptr, AudioFrame::End)) end_pending = false;
+
+        // While speaking: watch for barge-in, otherwise ignore mic input.
+        if (edna_speaking) {
+            const double rms = frame_rms(frame.data(), (size_t)frame_samples);
+            const bool learning = speak_frames++ < bargein_guard;
+            const double alpha = learning ? 0.2 : 0.02;
+
+            const int v = fvad_process(vad_echo, frame.data(), frame_samples);
+            update_preroll(v > 0);
+            const bool loud = rms > std::max(echo_rms * bargein_ratio, bargein_min_rms);
+            if (!learning && v > 0 && loud) {
+                barge_run++;
+            } else {
+                barge_run = 0;
+            }
+            echo_rms = (1.0 - alpha) * echo_rms + alpha * rms;
+
+            if (barge_run >= bargein_trigger) {
+                barge_run = 0;
+                barge_in("VAD over echo");
+                edna_speaking = false;       // no cooldown: the user is talking
+                ignore_frames = 0;
+                gated = false;
+                begin_utterance();
+                return;
+            }
         }
-        last_was_speaking = speaking_now;
 
         // While speaking or in cooldown: keep ALSA flowing but ignore mic input.
-        if (speaking_now || ignore_frames > 0) {
+        if (edna_speaking || ignore_frames > 0) {
             if (ignore_frames > 0) ignore_frames--;
 
             // Hard reset capture-side accumulators so we don't queue nonsense later.
-            in_speech = false;
-            voiced_run = 0;
-            unvoiced_run = 0;
-            utterance.clear();
-            preroll.clear();
+            ep.reset();
+            if (!edna_speaking) {             // cooldown: echo tail only
+                preroll.clear();
+                preroll_voiced.clear();
+            }
 
             // Also drop any pending ASR audio so it doesn't "catch up" late.
-            {
-                std::lock_guard<std::mutex> lk(q_m);
-                audio_q.clear();
+            if (!gated) {
+                gated = true;
+                asr_cancel_utt.store(utt_id, std::memory_order_release);
             }
-            continue;
+            return;
         }
-
-        // Update pre-roll
-        preroll.insert(preroll.end(), frame.begin(), frame.end());
-        if (preroll.size() > max_preroll_samples) {
-            const size_t extra = preroll.size() - max_preroll_samples;
-            preroll.erase(preroll.begin(), preroll.begin() + (long)extra);
+        gated = false;
+        if (cooldown_open) {
+            cooldown_open = false;
+            trace.span(trace.turn(), "cooldown", cooldown_t0, std::chrono::steady_clock::now());
         }
 
         int is_speech = fvad_process(vad, frame.data(), frame_samples);
         if (is_speech < 0) die("fvad_process failed");
 
-        if (!in_speech) {
-            if (is_speech) voiced_run++;
-            else voiced_run = 0;
+        // Update pre-roll
+        update_preroll(is_speech > 0);
 
-            if (voiced_run >= start_trigger) {
-                in_speech = true;
-                voiced_run = 0;
-                unvoiced_run = 0;
+        const bool was_in_speech = ep.in_speech();
+        const Endpointer::Decision dec = ep.push(is_speech, frame.data(), (size_t)frame_samples);
 
-                utterance.clear();
-                utterance.insert(utterance.end(), preroll.begin(), preroll.end());
+        if (!was_in_speech) {
+            if (dec == Endpointer::Decision::Start) {
+                begin_utterance();
 
-                sm.dispatch(EdnaStateMachine::Event::SpeechStart, "VAD start_trigger");
+                // Talking over a reply that is still being generated counts
+                // as barge-in too (the mic is open while Thinking).
+                if (sm.state() == EdnaStateMachine::State::Thinking) {
+                    barge_in("speech while thinking");
+                } else {
+                    sm.dispatch(EdnaStateMachine::Event::SpeechStart, "VAD start_trigger");
+                }
 
                 std::puts(">>> speech start");
                 std::fflush(stdout);
             }
         } else {
-            utterance.insert(utterance.end(), frame.begin(), frame.end());
-
-            if (!is_speech) unvoiced_run++;
-            else unvoiced_run = 0;
-
-            if (unvoiced_run >= stop_trigger) {
-                in_speech = false;
-                unvoiced_run = 0;
-
-                sm.dispatch(EdnaStateMachine::Event::SpeechEndQueued, "VAD stop_trigger");
+            const bool end = (dec == Endpointer::Decision::End);
+
+            // Partial snapshot while the user is still talking.
+            const bool snap = (++speech_frames % stream_step_frames == 0 && !end);
+            push_frame(frame.data(), (snap ? AudioFrame::Snapshot : 0u) |
+                                     (ep.voiced() ? AudioFrame::Voiced : 0u));
+
+            if (end) {
+                sm.dispatch(EdnaStateMachine::Event::SpeechEndQueued, "endpoint");
+
+                const Endpointer::Endpoint& e = ep.last_endpoint();
+                if (Tracer::on()) {
+                    // Anchor at the end of the user's speech, not at the
+                    // decision: that is the latency the user perceives.
+                    const auto now = std::chrono::steady_clock::now();
+                    const auto speech_end = now - std::chrono::milliseconds(e.trailing_ms);
+                    trace.anchor(utt_id, speech_end);
+                    trace.span(utt_id, "endpoint", speech_end, now);
+                }
+                std::fprintf(stderr, "[perf] endpoint_ms=%d hangover_ms=%d speech_ms=%d noise_db=%.1f snr_db=%.1f pause_ms=%.0f cue=%d\n",
+                             e.trailing_ms, e.hangover_ms, speech_frames * frame_ms,
+                             e.noise_db, e.snr_db, e.pause_ms, e.cue ? 1 : 0);
 
                 std::puts("<<< speech end (queued)");
                 std::fflush(stdout);
 
-                const double secs = (double)utterance.size() / (double)sr;
-                if (secs >= 0.20) {
-                    {
-                        std::lock_guard<std::mutex> lk(q_m);
-                        audio_q.clear();
-                        audio_q.emplace_back(std::move(utterance));
-                    }
-                    q_cv.notify_one();
+                if (!push_frame(nullptr, AudioFrame::End)) end_pending = true;
+                if (ring_drops) {
+                    std::fprintf(stderr, "[audio] ring overrun: dropped %llu frames so far\n",
+                                 (unsigned long long)ring_drops);
                 }
+            }
+        }
+    };
+
+    // Mic watchdog: a frame is due every 20 ms. None for capture_stall means
+    // the device wedged without reporting an error (USB hiccup): restart it.
+    const auto capture_stall = std::chrono::milliseconds(500);
+    int watchdog = -1;
+    size_t frame_fill = 0;   // samples of the next frame read so far
+
+    auto restart_capture = [&]() {
+        (void)snd_pcm_drop(pcm);
+        const int rc = snd_pcm_prepare(pcm);
+        if (rc < 0) die("snd_pcm_prepare failed", rc);
+        // A prepared capture stream runs only once started, and with
+        // non-blocking reads nothing else starts it.
+        (void)snd_pcm_start(pcm);
+        frame_fill = 0;
+    };
 
-                utterance = std::vector<int16_t>();
-                utterance.reserve(sr * 10);
+    watchdog = loop.add_timer([&]() {
+        std::fprintf(stderr, "[audio] capture stalled: no frame for %lld ms, restarting\n",
+                     (long long)capture_stall.count());
+        restart_capture();
+        loop.arm_timer(watchdog, std::chrono::steady_clock::now() + capture_stall);
+    });
+    if (watchdog < 0) die("capture watchdog timer failed");
+
+    // Read everything the PCM has; whole frames go to on_frame, a partial
+    // one waits for the rest.
+    auto read_capture = [&]() {
+        while (!loop.stopped()) {
+            const snd_pcm_sframes_t got = snd_pcm_readi(pcm, frame.data() + frame_fill,
+                                                        (snd_pcm_uframes_t)((size_t)frame_samples - frame_fill));
+            if (got == -EAGAIN) return;
+            if (got < 0) {
+                const int rc = snd_pcm_recover(pcm, (int)got, 1);
+                if (rc < 0) die("snd_pcm_readi failed", (int)got);
+                (void)snd_pcm_start(pcm);
+                frame_fill = 0;
+                return;
             }
+            frame_fill += (size_t)got;
+            if (frame_fill < (size_t)frame_samples) continue;
+            frame_fill = 0;
+            loop.arm_timer(watchdog, std::chrono::steady_clock::now() + capture_stall);
+            on_frame();
         }
+    };
+
+    // ALSA's poll descriptors go into the loop as they are; what they mean
+    // comes from snd_pcm_poll_descriptors_revents (plugins may remap them).
+    static_assert(POLLIN == EPOLLIN && POLLOUT == EPOLLOUT && POLLERR == EPOLLERR && POLLHUP == EPOLLHUP,
+                  "poll and epoll event bits differ");
+    const int n_pfds = snd_pcm_poll_descriptors_count(pcm);
+    if (n_pfds <= 0) die("snd_pcm_poll_descriptors_count failed", n_pfds);
+    std::vector<pollfd> pfds((size_t)n_pfds);
+    err = snd_pcm_poll_descriptors(pcm, pfds.data(), (unsigned)n_pfds);
+    if (err < 0) die("snd_pcm_poll_descriptors failed", err);
+    for (size_t i = 0; i < pfds.size(); i++) {
+        const bool ok = loop.add(pfds[i].fd, (uint32_t)pfds[i].events, [&, i](uint32_t ev) {
+            pfds[i].revents = (short)ev;
+            unsigned short rev = 0;
+            (void)snd_pcm_poll_descriptors_revents(pcm, pfds.data(), (unsigned)pfds.size(), &rev);
+            pfds[i].revents = 0;
+            // POLLERR is an xrun or suspend: readi reports it and recovers.
+            if (rev & (POLLIN | POLLERR)) read_capture();
+        });
+        if (!ok) die("capture: adding ALSA poll descriptor failed");
     }
 
+    // The capture loop runs on the main thread.
+    apply_stage_config(capture_cfg);
+
+    std::puts("Listening (Ctrl-C to stop) ...");
+
+    err = snd_pcm_start(pcm);
+    if (err < 0) die("snd_pcm_start failed", err);
+    loop.arm_timer(watchdog, std::chrono::steady_clock::now() + capture_stall);
+    loop.run();
+    g_loop = nullptr;
+
     std::puts("\nStopping...");
     sm.dispatch(EdnaStateMachine::Event::Stop, "SIGINT");
 
     snd_pcm_close(pcm);
+    fvad_free(vad_echo);
     fvad_free(vad);
 
     g_running.store(false);
-    q_cv.notify_all();
-    b_cv.notify_all();
+    audio_bell.signal();
 
-    if (asr_thread.joinable()) asr_thread.join();
-    if (brain_thread.joinable()) brain_thread.join();
+    asr_stage.join();
+    text_q.close();
+    sm_bell.signal();
+    brain_stage.join();
+    trace.stop();
 
     return 0;
 }
@@ -0,0 +1,65 @@
+#include "net_frame.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+static bool read_all(int fd, void* buf, size_t n) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (n > 0) {
+        const ssize_t r = ::read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+static bool write_all(int fd, const void* buf, size_t n) {
+    const auto* p = static_cast<const uint8_t*>(buf);
+    while (n > 0) {
+        const ssize_t w = ::send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+static void put_u16(uint8_t* p, uint32_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_u32(uint8_t* p, uint32_t v) { put_u16(p, v & 0xffff); put_u16(p + 2, v >> 16); }
+
+bool net_read_frame(int fd, NetFrame& f, size_t max_payload) {
+    uint8_t h[20];
+    if (!read_all(fd, h, sizeof(h))) return false;
+    if (std::memcmp(h, "EDNA", 4) != 0) return false;
+
+    auto u16 = [&](size_t o) { return (uint32_t)h[o] | ((uint32_t)h[o + 1] << 8); };
+    auto u32 = [&](size_t o) { return u16(o) | (u16(o + 2) << 16); };
+
+    f.kind        = (NetFrameKind)u32(4);
+    f.sample_rate = u32(8);
+    f.channels    = u16(12);
+    f.bits        = u16(14);
+    const uint32_t nbytes = u32(16);
+    if (nbytes > max_payload) return false;
+
+    f.payload.resize(nbytes);
+    return nbytes == 0 || read_all(fd, &f.payload[0], nbytes);
+}
+
+bool net_write_frame(int fd, NetFrameKind kind, const void* data, size_t n,
+                     unsigned sample_rate, unsigned channels, unsigned bits) {
+    uint8_t h[20];
+    std::memcpy(h, "EDNA", 4);
+    put_u32(h + 4, (uint32_t)kind);
+    put_u32(h + 8, sample_rate);
+    put_u16(h + 12, channels);
+    put_u16(h + 14, bits);
+    put_u32(h + 16, (uint32_t)n);
+    return write_all(fd, h, sizeof(h)) && (n == 0 || write_all(fd, data, n));
+}
@@ -0,0 +1,52 @@
+// net_frame.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Framing between edna_server and its room clients (tools/edna_client.py).
+ * Same 20-byte little-endian header as the TTS worker pipe
+ * (struct.pack("<4sIIHHI", b"EDNA", kind, rate, channels, bits, nbytes))
+ * followed by nbytes of payload.
+ *
+ *   client -> server   PCM   16 kHz mono s16le microphone audio, any chunking
+ *                      TEXT  a typed command (skips VAD and ASR)
+ *                      END   no more input; the server answers what is
+ *                            pending and closes
+ *   server -> client   HEARD transcript of an utterance (UTF-8)
+ *                      TEXT  one sentence of the reply, as it is generated
+ *                      PCM   reply speech, rate/channels in the header
+ *                      END   done with an utterance or command (the reply
+ *                            is complete, or there was nothing to answer)
+ *                      ERR   message; sent before closing (e.g. admission)
+ */
+enum class NetFrameKind : uint32_t {
+    Pcm   = 1,
+    End   = 2,
+    Err   = 3,
+    Text  = 4,
+    Heard = 5,
+};
+
+struct NetFrame {
+    NetFrameKind kind = NetFrameKind::End;
+    unsigned sample_rate = 0;
+    unsigned channels = 0;
+    unsigned bits = 0;
+    std::string payload;
+};
+
+// Blocking read of one frame. False on EOF, error, bad magic or a payload
+// over max_payload bytes.
+bool net_read_frame(int fd, NetFrame& f, size_t max_payload = 1u << 20);
+
+// Blocking write of one frame (MSG_NOSIGNAL: a closed peer is an error
+// return, not SIGPIPE). Not synchronized; one writer per fd at a time.
+bool net_write_frame(int fd, NetFrameKind kind, const void* data, size_t n,
+                     unsigned sample_rate = 0, unsigned channels = 0, unsigned bits = 16);
+
+inline bool net_write_text(int fd, NetFrameKind kind, const std::string& text) {
+    return net_write_frame(fd, kind, text.data(), text.size());
+}
@@ -0,0 +1,292 @@
+// pcm_cache.cpp
+#include "pcm_cache.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// On-disk entry: header, key (to catch hash collisions), then PCM.
+static const char kMagic[8] = {'E', 'D', 'N', 'A', 'P', 'C', 'M', '1'};
+
+struct DiskHeader {
+    char     magic[8];
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t key_bytes;
+    uint32_t reserved;
+    uint64_t pcm_bytes;
+};
+
+static uint64_t fnv1a64(const std::string& s) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+PcmCache::PcmCache(const Params& p) : p_(p) {
+    if (!enabled() || p_.dir.empty()) return;
+    if (::mkdir(p_.dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::fprintf(stderr, "[tts] cache dir '%s': %s (memory only)\n",
+                     p_.dir.c_str(), std::strerror(errno));
+        p_.dir.clear();
+        return;
+    }
+    prune_disk();
+    disk_thread_ = std::thread([this] { disk_loop(); });
+}
+
+PcmCache::~PcmCache() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        disk_stop_ = true;
+    }
+    disk_cv_.notify_all();
+    if (disk_thread_.joinable()) disk_thread_.join();
+}
+
+std::string PcmCache::make_key(const std::string& text, const std::string& model,
+                               const std::string& voice) {
+    std::string k;
+    k.reserve(text.size() + model.size() + voice.size() + 2);
+    bool space = false;
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            space = !k.empty();
+            continue;
+        }
+        if (space) k.push_back(' ');
+        space = false;
+        k.push_back((char)std::tolower(c));
+    }
+    k.push_back('\x1f');
+    k += model;
+    k.push_back('\x1f');
+    k += voice;
+    return k;
+}
+
+std::shared_ptr<const PcmCache::Entry> PcmCache::get(const std::string& key) {
+    if (!enabled()) return nullptr;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            st_.hits++;
+            return it->second->second;
+        }
+        if (p_.dir.empty()) {
+            st_.misses++;
+            return nullptr;
+        }
+    }
+
+    // Disk read without the lock; a racing put() of the same key is harmless.
+    EntryPtr e = load_disk(key);
+    if (e) touch_disk(disk_path(key));
+    std::lock_guard<std::mutex> lk(m_);
+    if (!e) {
+        st_.misses++;
+        return nullptr;
+    }
+    st_.hits++;
+    st_.disk_hits++;
+    insert_locked(key, e);
+    return e;
+}
+
+void PcmCache::put(const std::string& key, Entry e) {
+    if (!enabled() || e.pcm.empty() || e.channels == 0) return;
+    if (e.bytes() > p_.max_entry_bytes || e.bytes() > p_.max_bytes) return;
+
+    auto sp = std::make_shared<const Entry>(std::move(e));
+
+    std::lock_guard<std::mutex> lk(m_);
+    // The disk copy is best effort: with the writer far behind, skip it.
+    if (!p_.dir.empty() && disk_q_.size() < kMaxPendingWrites) {
+        disk_q_.emplace_back(key, sp);
+        disk_cv_.notify_one();
+    }
+    insert_locked(key, std::move(sp));
+    st_.inserts++;
+}
+
+void PcmCache::disk_loop() {
+    std::unique_lock<std::mutex> lk(m_);
+    while (true) {
+        disk_cv_.wait(lk, [&] { return disk_stop_ || !disk_q_.empty(); });
+        if (disk_q_.empty()) break;   // stopping, all written
+        auto job = std::move(disk_q_.front());
+        disk_q_.pop_front();
+        lk.unlock();
+        store_disk(job.first, *job.second);
+        lk.lock();
+    }
+}
+
+void PcmCache::insert_locked(const std::string& key, EntryPtr e) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        st_.bytes -= it->second->second->bytes();
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    st_.bytes += e->bytes();
+    lru_.emplace_front(key, std::move(e));
+    index_[key] = lru_.begin();
+
+    while (st_.bytes > p_.max_bytes && lru_.size() > 1) {
+        auto& victim = lru_.back();
+        st_.bytes -= victim.second->bytes();
+        index_.erase(victim.first);
+        lru_.pop_back();
+        st_.evictions++;
+    }
+    st_.entries = lru_.size();
+}
+
+PcmCache::Stats PcmCache::stats() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return st_;
+}
+
+std::string PcmCache::disk_path(const std::string& key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.pcm", (unsigned long long)fnv1a64(key));
+    return p_.dir + "/" + name;
+}
+
+PcmCache::EntryPtr PcmCache::load_disk(const std::string& key) const {
+    std::FILE* f = std::fopen(disk_path(key).c_str(), "rb");
+    if (!f) return nullptr;
+
+    DiskHeader h{};
+    std::string stored;
+    auto e = std::make_shared<Entry>();
+    bool ok = std::fread(&h, sizeof(h), 1, f) == 1 &&
+              std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 &&
+              h.key_bytes == key.size() && h.channels > 0 &&
+              h.pcm_bytes <= p_.max_entry_bytes && h.pcm_bytes % sizeof(int16_t) == 0;
+    if (ok) {
+        stored.resize(h.key_bytes);
+        ok = std::fread(&stored[0], 1, stored.size(), f) == stored.size() && stored == key;
+    }
+    if (ok) {
+        e->pcm.resize(h.pcm_bytes / sizeof(int16_t));
+        ok = std::fread(e->pcm.data(), 1, h.pcm_bytes, f) == h.pcm_bytes;
+        e->sample_rate = h.sample_rate;
+        e->channels = h.channels;
+    }
+    std::fclose(f);
+    return ok ? e : nullptr;
+}
+
+void PcmCache::store_disk(const std::string& key, const Entry& e) {
+    const std::string path = disk_path(key);
+    const std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return;
+
+    DiskHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.sample_rate = e.sample_rate;
+    h.channels = e.channels;
+    h.key_bytes = (uint32_t)key.size();
+    h.pcm_bytes = e.bytes();
+
+    const bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+                    std::fwrite(key.data(), 1, key.size(), f) == key.size() &&
+                    std::fwrite(e.pcm.data(), 1, e.bytes(), f) == e.bytes();
+    const bool closed = std::fclose(f) == 0;
+    // Readers only ever see complete files.
+    if (!ok || !closed || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return;
+    }
+
+    std::vector<std::string> victims;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        victims = account_disk_locked(path, sizeof(h) + key.size() + e.bytes());
+    }
+    for (const std::string& v : victims) std::remove(v.c_str());
+}
+
+// A disk hit: most recently used now, here and (mtime) after a restart.
+void PcmCache::touch_disk(const std::string& path) {
+    (void)::utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = disk_index_.find(path);
+    if (it != disk_index_.end()) disk_lru_.splice(disk_lru_.begin(), disk_lru_, it->second);
+}
+
+// Record path (bytes on disk) as most recent and return the files to
+// delete to get back under max_disk_bytes, oldest first. The newest file
+// always stays.
+std::vector<std::string> PcmCache::account_disk_locked(const std::string& path, size_t bytes) {
+    auto it = disk_index_.find(path);
+    if (it != disk_index_.end()) {
+        disk_bytes_ -= it->second->second;
+        disk_lru_.erase(it->second);
+    }
+    disk_lru_.emplace_front(path, bytes);
+    disk_index_[path] = disk_lru_.begin();
+    disk_bytes_ += bytes;
+
+    std::vector<std::string> victims;
+    while (disk_bytes_ > p_.max_disk_bytes && disk_lru_.size() > 1) {
+        auto& victim = disk_lru_.back();
+        disk_bytes_ -= victim.second;
+        victims.push_back(victim.first);
+        disk_index_.erase(victim.first);
+        disk_lru_.pop_back();
+    }
+    return victims;
+}
+
+// Startup: index what is in dir (by mtime, which disk hits refresh) and
+// trim it to max_disk_bytes.
+void PcmCache::prune_disk() {
+    struct File { std::string path; size_t size; struct timespec mtime; };
+    std::vector<File> files;
+
+    DIR* d = opendir(p_.dir.c_str());
+    if (!d) return;
+    while (dirent* de = readdir(d)) {
+        const std::string name = de->d_name;
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".pcm") != 0) continue;
+        const std::string path = p_.dir + "/" + name;
+        struct stat sb{};
+        if (stat(path.c_str(), &sb) != 0) continue;
+        files.push_back({path, (size_t)sb.st_size, sb.st_mtim});
+    }
+    closedir(d);
+
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) {
+        return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec < b.mtime.tv_sec
+                                                : a.mtime.tv_nsec < b.mtime.tv_nsec;
+    });
+    // Oldest first, so the newest end up at the front.
+    std::vector<std::string> victims;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        for (const File& f : files) {
+            for (std::string& v : account_disk_locked(f.path, f.size)) victims.push_back(std::move(v));
+        }
+    }
+    size_t removed = 0;
+    for (const std::string& v : victims) {
+        if (std::remove(v.c_str()) == 0) removed++;
+    }
+    std::fprintf(stderr, "[tts] cache dir=%s files=%zu bytes=%zu pruned=%zu\n",
+                 p_.dir.c_str(), files.size() - victims.size(), disk_bytes_, removed);
+}
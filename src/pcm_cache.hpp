@@ -0,0 +1,118 @@
+// pcm_cache.hpp
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * PcmCache
+ *
+ * LRU cache of synthesized speech, keyed by (normalized text, TTS model,
+ * voice). Much of what Edna says repeats ("Sorry, I didn't catch that.",
+ * fallback strings, common answers); a hit skips the worker round trip and
+ * goes straight to playback.
+ *
+ * Memory is bounded by max_bytes of PCM. With dir set, every entry is also
+ * written to <dir>/<hash>.pcm and a memory miss falls back to disk, so the
+ * cache survives restarts. Files are written by a background thread (put()
+ * never waits on the disk) and the directory is kept under max_disk_bytes
+ * as it grows, least recently used first: a disk hit touches its file, so
+ * the order carries over to the next start.
+ *
+ * Thread-safe.
+ */
+class PcmCache {
+public:
+    struct Params {
+        size_t max_bytes = 8u << 20;          // PCM kept in memory (0 disables the cache)
+        size_t max_entry_bytes = 1u << 20;    // longer clips are not worth caching (~23 s @ 22 kHz)
+        std::string dir;                      // "" = memory only
+        size_t max_disk_bytes = 64u << 20;
+    };
+
+    struct Entry {
+        std::vector<int16_t> pcm;             // interleaved s16
+        unsigned sample_rate = 0;
+        unsigned channels = 0;
+
+        size_t bytes() const { return pcm.size() * sizeof(int16_t); }
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t disk_hits = 0;               // subset of hits served from dir
+        uint64_t misses = 0;
+        uint64_t inserts = 0;
+        uint64_t evictions = 0;
+        size_t   bytes = 0;
+        size_t   entries = 0;
+
+        double hit_rate() const {
+            const uint64_t n = hits + misses;
+            return n ? (double)hits / (double)n : 0.0;
+        }
+    };
+
+    explicit PcmCache(const Params& p);
+    ~PcmCache();   // finishes queued disk writes
+
+    PcmCache(const PcmCache&) = delete;
+    PcmCache& operator=(const PcmCache&) = delete;
+
+    bool enabled() const { return p_.max_bytes > 0; }
+
+    // Whitespace and case are folded; punctuation is kept because it
+    // changes the prosody ("Sure." and "Sure?" are different clips).
+    static std::string make_key(const std::string& text, const std::string& model,
+                                const std::string& voice);
+
+    // nullptr on a miss. The entry stays valid after it is evicted.
+    std::shared_ptr<const Entry> get(const std::string& key);
+
+    // Insert (or replace) key. Ignored if the clip is over max_entry_bytes.
+    void put(const std::string& key, Entry e);
+
+    Stats stats() const;
+
+private:
+    using EntryPtr = std::shared_ptr<const Entry>;
+    using Lru = std::list<std::pair<std::string, EntryPtr>>;   // front = most recent
+
+    void insert_locked(const std::string& key, EntryPtr e);
+    std::string disk_path(const std::string& key) const;
+    EntryPtr load_disk(const std::string& key) const;
+    void store_disk(const std::string& key, const Entry& e);
+    void touch_disk(const std::string& path);
+    std::vector<std::string> account_disk_locked(const std::string& path, size_t bytes);
+    void prune_disk();
+    void disk_loop();
+
+    Params p_;
+    mutable std::mutex m_;
+    Lru lru_;
+    std::unordered_map<std::string, Lru::iterator> index_;
+    Stats st_{};
+
+    // Files in dir, by path, most recently used first (m_).
+    using DiskLru = std::list<std::pair<std::string, size_t>>;
+    DiskLru disk_lru_;
+    std::unordered_map<std::string, DiskLru::iterator> disk_index_;
+    size_t disk_bytes_ = 0;
+
+    // Writes pending for the disk thread (m_).
+    static constexpr size_t kMaxPendingWrites = 16;
+    std::deque<std::pair<std::string, EntryPtr>> disk_q_;
+    std::condition_variable disk_cv_;
+    bool disk_stop_ = false;
+    std::thread disk_thread_;
+};
@@ -0,0 +1,105 @@
+// pcm_convert.cpp
+#include "pcm_convert.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define EDNA_PCM_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define EDNA_PCM_NEON 1
+#include <arm_neon.h>
+#endif
+
+static constexpr float kS16Scale = 1.0f / 32768.0f;
+
+static void s16_to_f32_scalar(const int16_t* in, float* out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = (float)in[i] * kS16Scale;
+}
+
+#if defined(EDNA_PCM_X86)
+
+// SSE2 is baseline on x86_64; AVX2 is picked at runtime so the binary does
+// not need -mavx2.
+static void s16_to_f32_sse2(const int16_t* in, float* out, size_t n) {
+    const __m128 scale = _mm_set1_ps(kS16Scale);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i v  = _mm_loadu_si128((const __m128i*)(in + i));
+        // Sign-extend by unpacking into the high half and shifting back down.
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    s16_to_f32_scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void s16_to_f32_avx2(const int16_t* in, float* out, size_t n) {
+    const __m256 scale = _mm256_set1_ps(kS16Scale);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(in + i));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(in + i + 8));
+        const __m256 fa = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a));
+        const __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b));
+        _mm256_storeu_ps(out + i,     _mm256_mul_ps(fa, scale));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(fb, scale));
+    }
+    s16_to_f32_sse2(in + i, out + i, n - i);
+}
+
+using ConvFn = void (*)(const int16_t*, float*, size_t);
+
+struct Kernel {
+    ConvFn fn;
+    const char* name;
+};
+
+static Kernel pick_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {s16_to_f32_avx2, "avx2"};
+    return {s16_to_f32_sse2, "sse2"};
+}
+
+static const Kernel& kernel() {
+    static const Kernel k = pick_kernel();
+    return k;
+}
+
+void pcm_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    kernel().fn(in, out, n);
+}
+
+const char* pcm_s16_to_f32_kernel() {
+    return kernel().name;
+}
+
+#elif defined(EDNA_PCM_NEON)
+
+// Jetson Orin (Cortex-A78AE): NEON is always present on aarch64.
+void pcm_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const int16x8_t v = vld1q_s16(in + i);
+        // s32 -> f32 with 15 fractional bits is exactly x / 32768.
+        vst1q_f32(out + i,     vcvtq_n_f32_s32(vmovl_s16(vget_low_s16(v)), 15));
+        vst1q_f32(out + i + 4, vcvtq_n_f32_s32(vmovl_s16(vget_high_s16(v)), 15));
+    }
+    s16_to_f32_scalar(in + i, out + i, n - i);
+}
+
+const char* pcm_s16_to_f32_kernel() {
+    return "neon";
+}
+
+#else
+
+void pcm_s16_to_f32(const int16_t* in, float* out, size_t n) {
+    s16_to_f32_scalar(in, out, n);
+}
+
+const char* pcm_s16_to_f32_kernel() {
+    return "scalar";
+}
+
+#endif
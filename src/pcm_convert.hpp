@@ -0,0 +1,15 @@
+// pcm_convert.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Sample format conversion for the audio paths (capture -> Whisper).
+
+// out[i] = in[i] / 32768.0f. Vectorized where the CPU allows (AVX2 or SSE2
+// on x86, NEON on aarch64); scalar otherwise. in and out must not overlap.
+void pcm_s16_to_f32(const int16_t* in, float* out, size_t n);
+
+// Name of the kernel pcm_s16_to_f32 dispatches to ("avx2", "sse2", "neon",
+// "scalar"), for startup logging.
+const char* pcm_s16_to_f32_kernel();
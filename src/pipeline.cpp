@@ -0,0 +1,102 @@
+// pipeline.cpp
+#include "pipeline.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static std::string cpu_list(const std::vector<int>& cpus) {
+    std::string s;
+    for (int c : cpus) {
+        if (!s.empty()) s += ",";
+        s += std::to_string(c);
+    }
+    return s.empty() ? "any" : s;
+}
+
+void apply_stage_config(const StageConfig& cfg) {
+    // Thread names show up in top -H / perf; the kernel limit is 15 chars.
+    if (!cfg.name.empty()) {
+        pthread_setname_np(pthread_self(), cfg.name.substr(0, 15).c_str());
+    }
+
+    if (!cfg.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c : cfg.cpus) {
+            if (c >= 0 && c < CPU_SETSIZE) CPU_SET(c, &set);
+        }
+        const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            std::fprintf(stderr, "[pipeline] %s: affinity {%s} failed: %s\n",
+                         cfg.name.c_str(), cpu_list(cfg.cpus).c_str(), std::strerror(rc));
+        }
+    }
+
+    if (cfg.rt_priority > 0) {
+        sched_param sp{};
+        sp.sched_priority = cfg.rt_priority;
+        const int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (rc != 0) {
+            std::fprintf(stderr, "[pipeline] %s: SCHED_FIFO %d failed: %s (running SCHED_OTHER)\n",
+                         cfg.name.c_str(), cfg.rt_priority, std::strerror(rc));
+        }
+    } else if (cfg.nice != 0) {
+        // setpriority() on a TID only affects that thread on Linux.
+        const pid_t tid = (pid_t)syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, (id_t)tid, cfg.nice) != 0) {
+            std::fprintf(stderr, "[pipeline] %s: nice %d failed: %s\n",
+                         cfg.name.c_str(), cfg.nice, std::strerror(errno));
+        }
+    }
+
+    std::fprintf(stderr, "[pipeline] stage=%s cpus=%s rt=%d nice=%d\n",
+                 cfg.name.c_str(), cpu_list(cfg.cpus).c_str(), cfg.rt_priority, cfg.nice);
+}
+
+std::vector<int> stage_cpus_from_env(const std::string& name, const std::vector<int>& fallback) {
+    std::string key = "EDNA_CPUS_";
+    for (char c : name) key += (char)std::toupper((unsigned char)c);
+
+    const char* v = std::getenv(key.c_str());
+    if (!v) return fallback;
+
+    std::vector<int> out;
+    const std::string s(v);
+    size_t i = 0;
+    while (i < s.size()) {
+        size_t j = s.find(',', i);
+        if (j == std::string::npos) j = s.size();
+        const std::string tok = s.substr(i, j - i);
+        const size_t dash = tok.find('-');
+        char* end = nullptr;
+        if (dash == std::string::npos) {
+            const long c = std::strtol(tok.c_str(), &end, 10);
+            if (end != tok.c_str()) out.push_back((int)c);
+        } else {
+            const long a = std::strtol(tok.substr(0, dash).c_str(), nullptr, 10);
+            const long b = std::strtol(tok.substr(dash + 1).c_str(), nullptr, 10);
+            for (long c = a; c <= b; c++) out.push_back((int)c);
+        }
+        i = j + 1;
+    }
+    return out;   // set but empty ("") = explicitly unpinned
+}
+
+int stage_threads_from_env(const std::string& name, int fallback) {
+    std::string key = "EDNA_THREADS_";
+    for (char c : name) key += (char)std::toupper((unsigned char)c);
+
+    const char* v = std::getenv(key.c_str());
+    if (!v) return fallback;
+    const long n = std::strtol(v, nullptr, 10);
+    return n > 0 ? (int)n : fallback;
+}
@@ -0,0 +1,195 @@
+// pipeline.hpp
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Pipeline building blocks: a typed bounded queue between stages and a
+ * stage thread with CPU placement.
+ *
+ * Each stage owns one thread, started with its StageConfig applied (CPU
+ * affinity, nice level or SCHED_FIFO priority). Threads a stage creates
+ * afterwards (whisper / llama worker threads) inherit its affinity, so
+ * pinning the ASR stage also keeps Whisper's compute threads off the
+ * capture core.
+ */
+
+struct StageConfig {
+    std::string name;
+    std::vector<int> cpus;      // empty = no pinning
+    int  nice = 0;              // SCHED_OTHER nice level (negative needs privileges)
+    int  rt_priority = 0;       // > 0: SCHED_FIFO at this priority (needs CAP_SYS_NICE)
+};
+
+// Apply cfg to the calling thread. Failures (no privileges, CPU offline)
+// are logged and otherwise ignored: placement is an optimization.
+void apply_stage_config(const StageConfig& cfg);
+
+// CPUs to give a stage from the EDNA_CPUS_<NAME> environment variable
+// ("2,3" or "2-5"), or fallback when unset.
+std::vector<int> stage_cpus_from_env(const std::string& name, const std::vector<int>& fallback);
+
+// Worker threads for a stage from EDNA_THREADS_<NAME>, or fallback when
+// unset or not a positive number. Independent of the stage's CPUs.
+int stage_threads_from_env(const std::string& name, int fallback);
+
+/*
+ * BoundedQueue
+ *
+ * Multi-producer / multi-consumer FIFO with a fixed depth and an explicit
+ * overflow policy:
+ *   Block      - producer waits for space (backpressure)
+ *   DropOldest - oldest queued item is discarded (freshness wins)
+ *   DropNewest - the item being pushed is discarded
+ * close() wakes everyone; pop() then drains what is left and returns false.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    enum class Overflow { Block, DropOldest, DropNewest };
+
+    struct Metrics {
+        uint64_t pushed = 0;
+        uint64_t popped = 0;
+        uint64_t dropped = 0;
+        size_t   depth = 0;
+        size_t   max_depth = 0;     // high-water mark
+    };
+
+    BoundedQueue(std::string name, size_t capacity, Overflow policy)
+        : name_(std::move(name)), cap_(capacity ? capacity : 1), policy_(policy) {}
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // False if the queue is closed or the item was dropped (DropNewest).
+    bool push(T v) {
+        std::unique_lock<std::mutex> lk(m_);
+        if (closed_) return false;
+        if (q_.size() >= cap_) {
+            switch (policy_) {
+                case Overflow::Block:
+                    not_full_.wait(lk, [&]{ return closed_ || q_.size() < cap_; });
+                    if (closed_) return false;
+                    break;
+                case Overflow::DropOldest:
+                    q_.pop_front();
+                    m_stats_.dropped++;
+                    break;
+                case Overflow::DropNewest:
+                    m_stats_.dropped++;
+                    return false;
+            }
+        }
+        q_.push_back(std::move(v));
+        m_stats_.pushed++;
+        m_stats_.max_depth = std::max(m_stats_.max_depth, q_.size());
+        lk.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Block until an item is available. False once closed and empty.
+    bool pop(T& out) {
+        std::unique_lock<std::mutex> lk(m_);
+        not_empty_.wait(lk, [&]{ return closed_ || !q_.empty(); });
+        if (q_.empty()) return false;
+        out = std::move(q_.front());
+        q_.pop_front();
+        m_stats_.popped++;
+        lk.unlock();
+        not_full_.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& out) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (q_.empty()) return false;
+        out = std::move(q_.front());
+        q_.pop_front();
+        m_stats_.popped++;
+        not_full_.notify_one();
+        return true;
+    }
+
+    // Discard everything queued (counted as dropped).
+    void clear() {
+        std::lock_guard<std::mutex> lk(m_);
+        m_stats_.dropped += q_.size();
+        q_.clear();
+        not_full_.notify_all();
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            closed_ = true;
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    Metrics metrics() const {
+        std::lock_guard<std::mutex> lk(m_);
+        Metrics m = m_stats_;
+        m.depth = q_.size();
+        return m;
+    }
+
+    const std::string& name() const { return name_; }
+    size_t capacity() const { return cap_; }
+
+private:
+    const std::string name_;
+    const size_t cap_;
+    const Overflow policy_;
+
+    mutable std::mutex m_;
+    std::condition_variable not_empty_, not_full_;
+    std::deque<T> q_;
+    bool closed_ = false;
+    Metrics m_stats_{};
+};
+
+/*
+ * Stage
+ *
+ * One pipeline worker thread: applies its StageConfig, then runs body until
+ * it returns (bodies loop on their input queue and return once it closes).
+ */
+class Stage {
+public:
+    Stage(StageConfig cfg, std::function<void()> body)
+        : cfg_(std::move(cfg)), body_(std::move(body)) {}
+    ~Stage() { join(); }
+
+    Stage(const Stage&) = delete;
+    Stage& operator=(const Stage&) = delete;
+
+    void start() {
+        th_ = std::thread([this]() {
+            apply_stage_config(cfg_);
+            body_();
+        });
+    }
+
+    void join() {
+        if (th_.joinable()) th_.join();
+    }
+
+    const StageConfig& config() const { return cfg_; }
+
+private:
+    StageConfig cfg_;
+    std::function<void()> body_;
+    std::thread th_;
+};
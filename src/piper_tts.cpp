@@ -0,0 +1,387 @@
+// piper_tts.cpp
+#include "piper_tts.hpp"
+
+#include <onnxruntime_cxx_api.h>
+#include <espeak-ng/speak_lib.h>
+#include <piper-phonemize/phonemize.hpp>
+#include <piper-phonemize/phoneme_ids.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+/*
+ * Just enough JSON for a Piper voice config (objects, arrays, numbers,
+ * strings, literals). Not a general-purpose parser.
+ */
+struct Json {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    double num = 0.0;
+    std::string str;
+    std::vector<Json> arr;
+    std::vector<std::pair<std::string, Json>> obj;
+
+    const Json* get(const char* key) const {
+        for (const auto& kv : obj) {
+            if (kv.first == key) return &kv.second;
+        }
+        return nullptr;
+    }
+
+    double number_or(const char* key, double dflt) const {
+        const Json* v = get(key);
+        return (v && v->type == Type::Number) ? v->num : dflt;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& s) : s_(s) {}
+
+    bool parse(Json& out) {
+        return value(out) && (ws(), i_ == s_.size());
+    }
+
+private:
+    void ws() {
+        while (i_ < s_.size() && std::isspace((unsigned char)s_[i_])) i_++;
+    }
+
+    bool value(Json& v) {
+        ws();
+        if (i_ >= s_.size()) return false;
+        const char c = s_[i_];
+        if (c == '{') return object(v);
+        if (c == '[') return array(v);
+        if (c == '"') {
+            v.type = Json::Type::String;
+            return string(v.str);
+        }
+        if (s_.compare(i_, 4, "true") == 0)  { v.type = Json::Type::Bool; v.num = 1; i_ += 4; return true; }
+        if (s_.compare(i_, 5, "false") == 0) { v.type = Json::Type::Bool; v.num = 0; i_ += 5; return true; }
+        if (s_.compare(i_, 4, "null") == 0)  { v.type = Json::Type::Null; i_ += 4; return true; }
+
+        const char* b = s_.c_str() + i_;
+        char* e = nullptr;
+        v.num = std::strtod(b, &e);
+        if (e == b) return false;
+        v.type = Json::Type::Number;
+        i_ += (size_t)(e - b);
+        return true;
+    }
+
+    bool object(Json& v) {
+        v.type = Json::Type::Object;
+        i_++;   // {
+        ws();
+        if (i_ < s_.size() && s_[i_] == '}') { i_++; return true; }
+        while (true) {
+            ws();
+            std::string key;
+            if (i_ >= s_.size() || s_[i_] != '"' || !string(key)) return false;
+            ws();
+            if (i_ >= s_.size() || s_[i_++] != ':') return false;
+            Json child;
+            if (!value(child)) return false;
+            v.obj.emplace_back(std::move(key), std::move(child));
+            ws();
+            if (i_ >= s_.size()) return false;
+            if (s_[i_] == ',') { i_++; continue; }
+            if (s_[i_] == '}') { i_++; return true; }
+            return false;
+        }
+    }
+
+    bool array(Json& v) {
+        v.type = Json::Type::Array;
+        i_++;   // [
+        ws();
+        if (i_ < s_.size() && s_[i_] == ']') { i_++; return true; }
+        while (true) {
+            Json child;
+            if (!value(child)) return false;
+            v.arr.push_back(std::move(child));
+            ws();
+            if (i_ >= s_.size()) return false;
+            if (s_[i_] == ',') { i_++; continue; }
+            if (s_[i_] == ']') { i_++; return true; }
+            return false;
+        }
+    }
+
+    static void put_utf8(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += (char)cp;
+        } else if (cp < 0x800) {
+            out += (char)(0xC0 | (cp >> 6));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += (char)(0xE0 | (cp >> 12));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | (cp >> 18));
+            out += (char)(0x80 | ((cp >> 12) & 0x3F));
+            out += (char)(0x80 | ((cp >> 6) & 0x3F));
+            out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool hex4(uint32_t& cp) {
+        if (i_ + 4 > s_.size()) return false;
+        cp = (uint32_t)std::strtoul(s_.substr(i_, 4).c_str(), nullptr, 16);
+        i_ += 4;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        i_++;   // opening quote
+        while (i_ < s_.size()) {
+            const char c = s_[i_++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (i_ >= s_.size()) return false;
+            const char e = s_[i_++];
+            switch (e) {
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': {
+                    uint32_t cp = 0;
+                    if (!hex4(cp)) return false;
+                    // Surrogate pair
+                    if (cp >= 0xD800 && cp < 0xDC00 && s_.compare(i_, 2, "\\u") == 0) {
+                        i_ += 2;
+                        uint32_t lo = 0;
+                        if (!hex4(lo)) return false;
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    }
+                    put_utf8(out, cp);
+                    break;
+                }
+                default: out += e; break;   // \" \\ \/
+            }
+        }
+        return false;
+    }
+
+    const std::string& s_;
+    size_t i_ = 0;
+};
+
+// First code point of a UTF-8 string (phoneme_id_map keys are single phonemes).
+char32_t first_codepoint(const std::string& s) {
+    if (s.empty()) return 0;
+    const unsigned char c = (unsigned char)s[0];
+    if (c < 0x80) return c;
+    int n = (c >= 0xF0) ? 3 : (c >= 0xE0) ? 2 : 1;
+    char32_t cp = c & (0x3F >> n);
+    for (int k = 1; k <= n && k < (int)s.size(); k++) cp = (cp << 6) | ((unsigned char)s[k] & 0x3F);
+    return cp;
+}
+
+} // namespace
+
+struct PiperTTS::Impl {
+    bool loaded = false;
+
+    unsigned sample_rate = 22050;
+    float length_scale = 1.0f;
+    float noise_scale = 0.667f;
+    float noise_w = 0.8f;
+    bool multi_speaker = false;
+
+    piper::eSpeakPhonemeConfig espeak;
+    piper::PhonemeIdConfig ids;
+
+    std::unique_ptr<Ort::Env> env;
+    std::unique_ptr<Ort::Session> session;
+    Ort::MemoryInfo mem = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+
+    bool read_config(const std::string& path, std::string& err) {
+        std::ifstream in(path);
+        if (!in) {
+            err = "cannot read voice config " + path;
+            return false;
+        }
+        std::stringstream ss;
+        ss << in.rdbuf();
+        const std::string text = ss.str();
+
+        Json cfg;
+        if (!JsonParser(text).parse(cfg) || cfg.type != Json::Type::Object) {
+            err = "bad JSON in " + path;
+            return false;
+        }
+
+        if (const Json* audio = cfg.get("audio")) {
+            sample_rate = (unsigned)audio->number_or("sample_rate", sample_rate);
+        }
+        if (const Json* inf = cfg.get("inference")) {
+            length_scale = (float)inf->number_or("length_scale", length_scale);
+            noise_scale  = (float)inf->number_or("noise_scale", noise_scale);
+            noise_w      = (float)inf->number_or("noise_w", noise_w);
+        }
+        if (const Json* es = cfg.get("espeak")) {
+            if (const Json* voice = es->get("voice")) espeak.voice = voice->str;
+        }
+        multi_speaker = cfg.number_or("num_speakers", 1) > 1;
+
+        const Json* map = cfg.get("phoneme_id_map");
+        if (!map || map->type != Json::Type::Object || map->obj.empty()) {
+            err = path + ": no phoneme_id_map";
+            return false;
+        }
+        auto id_map = std::make_shared<piper::PhonemeIdMap>();
+        for (const auto& kv : map->obj) {
+            std::vector<piper::PhonemeId> v;
+            for (const Json& id : kv.second.arr) v.push_back((piper::PhonemeId)id.num);
+            (*id_map)[first_codepoint(kv.first)] = std::move(v);
+        }
+        ids.phonemeIdMap = id_map;
+        return true;
+    }
+};
+
+PiperTTS::PiperTTS(const Params& p) : p_(p), impl_(new Impl) {
+    if (p_.config_path.empty()) p_.config_path = p_.model_path + ".json";
+}
+
+PiperTTS::~PiperTTS() {
+    if (impl_ && impl_->loaded) espeak_Terminate();
+    delete impl_;
+}
+
+std::string PiperTTS::model_id() const {
+    return "piper:" + p_.model_path + "#" + std::to_string(p_.speaker_id);
+}
+
+bool PiperTTS::load(std::string& err) {
+    if (impl_->loaded) return true;
+
+    if (!impl_->read_config(p_.config_path, err)) return false;
+    if (p_.length_scale > 0.0f) impl_->length_scale = p_.length_scale;
+    if (p_.noise_scale >= 0.0f) impl_->noise_scale = p_.noise_scale;
+    if (p_.noise_w >= 0.0f) impl_->noise_w = p_.noise_w;
+
+    const char* data = p_.espeak_data.empty() ? nullptr : p_.espeak_data.c_str();
+    if (espeak_Initialize(AUDIO_OUTPUT_SYNCHRONOUS, 0, data, 0) < 0) {
+        err = "espeak_Initialize failed (espeak-ng-data at '" + p_.espeak_data + "'?)";
+        return false;
+    }
+
+    try {
+        impl_->env.reset(new Ort::Env(ORT_LOGGING_LEVEL_WARNING, "edna-piper"));
+        Ort::SessionOptions so;
+        so.SetIntraOpNumThreads(std::max(1, p_.n_threads));
+        so.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+        // Memory-pattern planning assumes fixed shapes; phoneme sequences
+        // vary per sentence, so it only costs RAM here.
+        so.DisableMemPattern();
+        if (p_.use_cuda) {
+            OrtCUDAProviderOptions cuda{};
+            cuda.device_id = p_.cuda_device;
+            so.AppendExecutionProvider_CUDA(cuda);
+        }
+        impl_->session.reset(new Ort::Session(*impl_->env, p_.model_path.c_str(), so));
+    } catch (const Ort::Exception& e) {
+        espeak_Terminate();
+        err = std::string("onnxruntime: ") + e.what();
+        return false;
+    }
+
+    impl_->loaded = true;
+    std::fprintf(stderr, "[tts] piper voice=%s rate=%u espeak=%s speakers=%s threads=%d cuda=%d\n",
+                 p_.model_path.c_str(), impl_->sample_rate, impl_->espeak.voice.c_str(),
+                 impl_->multi_speaker ? "multi" : "single", p_.n_threads, p_.use_cuda ? 1 : 0);
+    return true;
+}
+
+bool PiperTTS::synthesize(const std::string& text, const PcmFn& on_pcm, std::string& err) {
+    if (!impl_->loaded && !load(err)) return false;
+
+    std::vector<std::vector<piper::Phoneme>> sentences;
+    piper::phonemize_eSpeak(text, impl_->espeak, sentences);
+
+    std::vector<piper::PhonemeId> ids;
+    std::map<piper::Phoneme, std::size_t> missing;
+    bool any = false;
+
+    for (auto& phonemes : sentences) {
+        if (phonemes.empty()) continue;
+        ids.clear();
+        piper::phonemes_to_ids(phonemes, impl_->ids, ids, missing);
+        if (ids.empty()) continue;
+
+        std::vector<int64_t> id_shape{1, (int64_t)ids.size()};
+        int64_t len = (int64_t)ids.size();
+        std::vector<int64_t> len_shape{1};
+        float scales[3] = {impl_->noise_scale, impl_->length_scale, impl_->noise_w};
+        std::vector<int64_t> scales_shape{3};
+        int64_t sid = std::max(0, p_.speaker_id);
+        std::vector<int64_t> sid_shape{1};
+
+        std::vector<Ort::Value> inputs;
+        inputs.push_back(Ort::Value::CreateTensor<int64_t>(impl_->mem, ids.data(), ids.size(),
+                                                           id_shape.data(), id_shape.size()));
+        inputs.push_back(Ort::Value::CreateTensor<int64_t>(impl_->mem, &len, 1,
+                                                           len_shape.data(), len_shape.size()));
+        inputs.push_back(Ort::Value::CreateTensor<float>(impl_->mem, scales, 3,
+                                                         scales_shape.data(), scales_shape.size()));
+        std::vector<const char*> in_names{"input", "input_lengths", "scales"};
+        if (impl_->multi_speaker) {
+            inputs.push_back(Ort::Value::CreateTensor<int64_t>(impl_->mem, &sid, 1,
+                                                               sid_shape.data(), sid_shape.size()));
+            in_names.push_back("sid");
+        }
+        const char* out_names[] = {"output"};
+
+        std::vector<Ort::Value> out;
+        try {
+            out = impl_->session->Run(Ort::RunOptions{nullptr}, in_names.data(), inputs.data(),
+                                      inputs.size(), out_names, 1);
+        } catch (const Ort::Exception& e) {
+            err = std::string("onnxruntime: ") + e.what();
+            return false;
+        }
+        if (out.empty() || !out[0].IsTensor()) {
+            err = "piper: no audio output";
+            return false;
+        }
+
+        const float* audio = out[0].GetTensorData<float>();
+        const size_t n = out[0].GetTensorTypeAndShapeInfo().GetElementCount();
+        std::vector<int16_t> pcm(n);
+        for (size_t i = 0; i < n; i++) {
+            const float v = std::max(-1.0f, std::min(1.0f, audio[i]));
+            pcm[i] = (int16_t)std::lrintf(v * 32767.0f);
+        }
+        on_pcm(std::move(pcm), impl_->sample_rate, 1);
+        any = true;
+    }
+
+    if (!missing.empty()) {
+        std::fprintf(stderr, "[tts] piper: %zu phoneme(s) not in the voice's id map\n", missing.size());
+    }
+    if (!any) {
+        err = "piper: nothing to say";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,58 @@
+// piper_tts.hpp
+#pragma once
+
+#include "tts_engine.hpp"
+
+#include <string>
+
+/*
+ * PiperTTS
+ *
+ * Native VITS (Piper voice) synthesis: espeak-ng phonemization through
+ * piper-phonemize, then the voice's ONNX graph in ONNX Runtime, in
+ * process. A Piper voice is a model.onnx plus model.onnx.json (sample rate,
+ * phoneme id map, default scales).
+ *
+ * Each sentence espeak finds is synthesized and handed to the pipeline on
+ * its own, so the first one plays while the rest are still rendering.
+ *
+ * Built only with -DEDNA_USE_PIPER=ON (defines EDNA_HAVE_PIPER). espeak-ng
+ * keeps global state: use one PiperTTS per process.
+ */
+class PiperTTS : public TtsEngine {
+public:
+    struct Params {
+        std::string model_path;              // voice .onnx
+        std::string config_path;             // "" = model_path + ".json"
+        std::string espeak_data;             // espeak-ng-data directory ("" = library default)
+
+        int speaker_id = -1;                 // multi-speaker voices; -1 = default
+
+        // Negative = use the voice config's values.
+        float length_scale = -1.0f;          // > 1 speaks slower
+        float noise_scale  = -1.0f;
+        float noise_w      = -1.0f;
+
+        int  n_threads = 2;                  // ONNX Runtime intra-op threads
+        bool use_cuda = false;               // CUDA execution provider
+        int  cuda_device = 0;
+    };
+
+    explicit PiperTTS(const Params& p);
+    ~PiperTTS() override;
+
+    PiperTTS(const PiperTTS&) = delete;
+    PiperTTS& operator=(const PiperTTS&) = delete;
+
+    const char* name() const override { return "piper"; }
+    std::string model_id() const override;
+    bool load(std::string& err) override;
+    bool synthesize(const std::string& text, const PcmFn& on_pcm, std::string& err) override;
+    bool uses_gpu() const override { return p_.use_cuda; }
+
+private:
+    Params p_;
+
+    struct Impl;
+    Impl* impl_;
+};
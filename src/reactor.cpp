@@ -0,0 +1,212 @@
+// reactor.cpp
+#include "reactor.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+static void fatal(const char* what) {
+    std::fprintf(stderr, "[reactor] %s: %s\n", what, std::strerror(errno));
+    std::exit(1);
+}
+
+/* ===================== EventFd ===================== */
+
+EventFd::EventFd() {
+    fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd_ < 0) fatal("eventfd");
+}
+
+EventFd::~EventFd() {
+    if (fd_ >= 0) ::close(fd_);
+}
+
+void EventFd::signal() {
+    const uint64_t one = 1;
+    // Only fails (EAGAIN) with the counter at its maximum: already signaled.
+    while (::write(fd_, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+uint64_t EventFd::drain() {
+    uint64_t n = 0;
+    while (::read(fd_, &n, sizeof(n)) < 0) {
+        if (errno != EINTR) return 0;   // EAGAIN: nothing pending
+    }
+    return n;
+}
+
+bool EventFd::wait(int timeout_ms) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true) {
+        if (drain()) return true;
+
+        int left = -1;
+        if (timeout_ms >= 0) {
+            const auto d = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (d.count() <= 0) return false;
+            left = (int)d.count();
+        }
+        pollfd p{fd_, POLLIN, 0};
+        if (::poll(&p, 1, left) < 0 && errno != EINTR) return false;
+    }
+}
+
+/* ===================== Reactor ===================== */
+
+Reactor::Reactor() {
+    ep_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (ep_ < 0) fatal("epoll_create1");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;   // key 0: the wake eventfd
+    if (::epoll_ctl(ep_, EPOLL_CTL_ADD, wake_.fd(), &ev) != 0) fatal("epoll_ctl(eventfd)");
+}
+
+Reactor::~Reactor() {
+    for (auto& kv : entries_) {
+        if (kv.second->timer) ::close(kv.second->fd);
+    }
+    if (ep_ >= 0) ::close(ep_);
+}
+
+bool Reactor::add_entry(int fd, uint32_t events, std::shared_ptr<Entry> e) {
+    if (fd < 0 || by_fd_.count(fd)) return false;
+
+    const uint64_t key = next_key_++;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = key;
+    if (::epoll_ctl(ep_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        std::fprintf(stderr, "[reactor] epoll_ctl(add fd=%d): %s\n", fd, std::strerror(errno));
+        return false;
+    }
+    entries_[key] = std::move(e);
+    by_fd_[fd] = key;
+    return true;
+}
+
+bool Reactor::add(int fd, uint32_t events, Handler h) {
+    auto e = std::make_shared<Entry>();
+    e->fd = fd;
+    e->on_ready = std::move(h);
+    return add_entry(fd, events, std::move(e));
+}
+
+void Reactor::remove(int fd) {
+    auto it = by_fd_.find(fd);
+    if (it == by_fd_.end()) return;
+    (void)::epoll_ctl(ep_, EPOLL_CTL_DEL, fd, nullptr);
+    auto e = entries_.find(it->second);
+    if (e != entries_.end()) {
+        if (e->second->timer) ::close(fd);
+        entries_.erase(e);
+    }
+    by_fd_.erase(it);
+}
+
+int Reactor::add_timer(Task fn) {
+    const int tfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        std::fprintf(stderr, "[reactor] timerfd_create: %s\n", std::strerror(errno));
+        return -1;
+    }
+    auto e = std::make_shared<Entry>();
+    e->fd = tfd;
+    e->timer = true;
+    e->on_ready = [tfd, fn = std::move(fn)](uint32_t) {
+        uint64_t expirations = 0;
+        if (::read(tfd, &expirations, sizeof(expirations)) != (ssize_t)sizeof(expirations)) return;  // re-armed meanwhile
+        fn();
+    };
+    if (!add_entry(tfd, EPOLLIN, std::move(e))) {
+        ::close(tfd);
+        return -1;
+    }
+    return tfd;
+}
+
+static timespec to_timespec(std::chrono::nanoseconds ns) {
+    timespec ts{};
+    ts.tv_sec  = (time_t)(ns.count() / 1000000000);
+    ts.tv_nsec = (long)(ns.count() % 1000000000);
+    return ts;
+}
+
+bool Reactor::arm_timer(int id, Clock::time_point at, Clock::duration period) {
+    // steady_clock is CLOCK_MONOTONIC on Linux, so its epoch is the timerfd's.
+    itimerspec its{};
+    its.it_value = to_timespec(std::chrono::duration_cast<std::chrono::nanoseconds>(at.time_since_epoch()));
+    its.it_interval = to_timespec(std::chrono::duration_cast<std::chrono::nanoseconds>(period));
+    // A zero it_value would disarm it; a deadline already passed fires now.
+    if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+    return ::timerfd_settime(id, TFD_TIMER_ABSTIME, &its, nullptr) == 0;
+}
+
+void Reactor::disarm_timer(int id) {
+    itimerspec its{};
+    (void)::timerfd_settime(id, 0, &its, nullptr);
+}
+
+void Reactor::remove_timer(int id) {
+    remove(id);
+}
+
+void Reactor::post(Task fn) {
+    {
+        std::lock_guard<std::mutex> lk(post_m_);
+        posted_.push_back(std::move(fn));
+    }
+    wake_.signal();
+}
+
+void Reactor::stop() {
+    stopped_.store(true, std::memory_order_release);
+    wake_.signal();
+}
+
+void Reactor::run_posted() {
+    std::vector<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lk(post_m_);
+        tasks.swap(posted_);
+    }
+    for (Task& t : tasks) t();
+}
+
+int Reactor::run_once(int timeout_ms) {
+    epoll_event evs[16];
+    const int n = ::epoll_wait(ep_, evs, 16, timeout_ms);
+    if (n < 0) {
+        if (errno == EINTR) return 0;
+        std::fprintf(stderr, "[reactor] epoll_wait: %s\n", std::strerror(errno));
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const uint64_t key = evs[i].data.u64;
+        if (key == 0) {
+            wake_.drain();
+            run_posted();
+            continue;
+        }
+        auto it = entries_.find(key);
+        if (it == entries_.end()) continue;   // removed by an earlier callback
+        std::shared_ptr<Entry> e = it->second;
+        e->on_ready(evs[i].events);
+    }
+    return n;
+}
+
+void Reactor::run() {
+    while (!stopped()) {
+        if (run_once(-1) < 0) break;
+    }
+}
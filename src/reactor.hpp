@@ -0,0 +1,120 @@
+// reactor.hpp
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * EventFd
+ *
+ * A counting doorbell on an eventfd. signal() never blocks and never
+ * loses a wakeup: signals before the wait are counted, not dropped, so a
+ * producer needs no mutex to pair with the consumer's wait. signal() is
+ * async-signal-safe.
+ */
+class EventFd {
+public:
+    EventFd();
+    ~EventFd();
+
+    EventFd(const EventFd&) = delete;
+    EventFd& operator=(const EventFd&) = delete;
+
+    int fd() const { return fd_; }
+
+    void signal();
+
+    // Consume pending signals without blocking; their count (0 if none).
+    uint64_t drain();
+
+    // Block until signaled (consuming it) or timeout_ms passes (-1: no
+    // timeout). False on timeout.
+    bool wait(int timeout_ms = -1);
+
+private:
+    int fd_ = -1;
+};
+
+/*
+ * Reactor
+ *
+ * One epoll set and the callbacks for it: file descriptors (pipes, sockets,
+ * ALSA poll descriptors), timers on timerfds (absolute steady_clock
+ * deadlines, so a timeout does not restart when something else wakes the
+ * loop) and functions posted from other threads through an eventfd.
+ *
+ * add/remove/timers and run belong to one thread at a time (the loop
+ * thread, or whoever holds the owner's lock); post() and stop() may be
+ * called from anywhere, stop() from a signal handler too. Callbacks run on
+ * the thread in run/run_once and may add or remove entries, themselves
+ * included.
+ */
+class Reactor {
+public:
+    using Clock   = std::chrono::steady_clock;
+    using Handler = std::function<void(uint32_t events)>;   // EPOLLIN, EPOLLERR, ...
+    using Task    = std::function<void()>;
+
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // Watch fd (not owned; remove it before closing it). Level-triggered.
+    bool add(int fd, uint32_t events, Handler h);
+    void remove(int fd);
+
+    // A disarmed timer; fn runs each time it fires. Returns its id (-1 on
+    // failure).
+    int  add_timer(Task fn);
+    // Fire at `at` and then every `period` (zero: once). Re-arming replaces
+    // the previous deadline.
+    bool arm_timer(int id, Clock::time_point at, Clock::duration period = Clock::duration::zero());
+    void disarm_timer(int id);
+    void remove_timer(int id);
+
+    // Run fn on the loop thread (any thread).
+    void post(Task fn);
+
+    // End run() (any thread, async-signal-safe). Sticky: run_once still
+    // dispatches afterwards, but stopped() stays true.
+    void stop();
+    bool stopped() const { return stopped_.load(std::memory_order_acquire); }
+
+    // Wait up to timeout_ms (-1: no limit) and dispatch what is ready.
+    // Number of events handled, 0 on timeout or EINTR, -1 on error.
+    int run_once(int timeout_ms = -1);
+
+    // Dispatch until stop().
+    void run();
+
+private:
+    struct Entry {
+        int fd = -1;
+        bool timer = false;     // fd is a timerfd we own
+        Handler on_ready;
+    };
+
+    bool add_entry(int fd, uint32_t events, std::shared_ptr<Entry> e);
+    void run_posted();
+
+    int ep_ = -1;
+    EventFd wake_;
+    std::atomic<bool> stopped_{false};
+
+    // Keyed by registration, not fd: an event still queued for a removed fd
+    // must not reach whatever reuses that number.
+    uint64_t next_key_ = 1;
+    std::unordered_map<uint64_t, std::shared_ptr<Entry>> entries_;
+    std::unordered_map<int, uint64_t> by_fd_;
+
+    std::mutex post_m_;
+    std::vector<Task> posted_;
+};
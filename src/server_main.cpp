@@ -0,0 +1,589 @@
+// server_main.cpp
+//
+// edna_server: one GPU host answering several rooms. Each room runs a thin
+// client (tools/edna_client.py) that streams its microphone over TCP and
+// plays back what comes back; everything heavy stays here:
+//
+//   client PCM -> per-session fvad + Endpointer -> WhisperPool (shared
+//   model, one decoder state per concurrent utterance) -> strip_invocation
+//   -> IntentRouter -> LlamaSessions (one KV sequence per session, decode
+//   steps of all sessions merged into shared llama_decode batches)
+//   -> reply sentences (and, with --tts, speech) back to the client.
+//
+//   edna_server [options]
+//
+// Framing is in net_frame.hpp. Admission is limited to --max-sessions
+// connections; the next one gets an ERR frame and is closed.
+#include <fvad.h>
+
+#include "asr_whisper.hpp"
+#include "llm_sessions.hpp"
+#include "tts_coqui.hpp"
+#include "intent_router.hpp"
+#include "text_util.hpp"
+#include "circular_buffer.hpp"
+#include "endpointer.hpp"
+#include "net_frame.hpp"
+#include "pipeline.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double ms_since(Clock::time_point a, Clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+
+static std::atomic<bool> g_running{true};
+static void on_sigint(int) { g_running.store(false); }
+
+struct Options {
+    int port = 7700;
+    int max_sessions = 4;
+    int asr_states = 2;
+    bool require_invocation = true;
+    bool use_tts = false;
+    bool barge_in = false;
+    std::string whisper_model;
+    std::string llama_model;
+    std::string kv_type = "f16";
+    int n_ctx = 1024;
+};
+
+static void usage() {
+    std::fprintf(stderr,
+        "usage: edna_server [options]\n"
+        "  --port N              TCP port (default 7700)\n"
+        "  --max-sessions N      admission limit, one LLM KV sequence each (default 4)\n"
+        "  --asr-states N        concurrent Whisper decodes (default 2)\n"
+        "  --no-invocation       answer every utterance, not only \"Edna, ...\"\n"
+        "  --tts                 synthesize replies and stream the PCM (one TTS worker per session)\n"
+        "  --barge-in            speech from the room cancels the reply in progress\n"
+        "  --whisper PATH        Whisper model (default: base.en under $EDNA_TOP_DIR)\n"
+        "  --llama PATH          LLM model (default: the edna model under $EDNA_TOP_DIR)\n"
+        "  --kv-type T           LLM KV cache type: f16 (default), q8_0, q4_0\n"
+        "  --n-ctx N             LLM context per session (default 1024)\n");
+}
+
+static bool parse_args(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const std::string a = argv[i];
+        auto value = [&](std::string& dst) {
+            if (i + 1 >= argc) return false;
+            dst = argv[++i];
+            return true;
+        };
+        auto number = [&](int& dst, int lo) {
+            std::string v;
+            if (!value(v)) return false;
+            dst = std::max(lo, std::atoi(v.c_str()));
+            return true;
+        };
+        if (a == "--port") { if (!number(o.port, 1)) return false; }
+        else if (a == "--max-sessions") { if (!number(o.max_sessions, 1)) return false; }
+        else if (a == "--asr-states") { if (!number(o.asr_states, 1)) return false; }
+        else if (a == "--n-ctx") { if (!number(o.n_ctx, 256)) return false; }
+        else if (a == "--no-invocation") o.require_invocation = false;
+        else if (a == "--tts") o.use_tts = true;
+        else if (a == "--barge-in") o.barge_in = true;
+        else if (a == "--whisper") { if (!value(o.whisper_model)) return false; }
+        else if (a == "--llama") { if (!value(o.llama_model)) return false; }
+        else if (a == "--kv-type") { if (!value(o.kv_type)) return false; }
+        else return false;
+    }
+    return true;
+}
+
+// What every session shares.
+struct Shared {
+    Shared(const Options& o, WhisperPool& a, LlamaSessions& l) : opt(o), asr(a), llm(l) {}
+
+    const Options& opt;
+    WhisperPool& asr;
+    LlamaSessions& llm;
+    CoquiTTS::Params tts_p;
+
+    // Open connections, so shutdown can unblock their reads, and session
+    // threads that have finished, for main to join.
+    std::mutex m;
+    std::vector<int> fds;
+    std::vector<std::thread::id> finished;
+};
+
+/*
+ * RoomSession
+ *
+ * One client connection. The connection thread reads frames and runs VAD
+ * and endpointing on the audio; finished utterances go through a small
+ * queue to the session's turn thread (ASR -> intents / LLM -> reply), so
+ * the next utterance is already being cut while a reply streams out.
+ */
+class RoomSession {
+public:
+    RoomSession(Shared& sh, int fd, int sid, std::string peer)
+        : sh_(sh), fd_(fd), sid_(sid), peer_(std::move(peer)),
+          utt_q_("utt", 2, BoundedQueue<Utterance>::Overflow::DropOldest) {}
+
+    void run();
+
+private:
+    static constexpr unsigned kRate = 16000;
+    static constexpr int kFrameMs = 20;
+    static constexpr size_t kFrameSamples = kRate * kFrameMs / 1000;
+    static constexpr int kPrerollFrames = 15;
+    // Whisper's window; an utterance still going at this length is cut here
+    // (a stuck VAD or a noisy room would otherwise grow it without bound).
+    static constexpr size_t kMaxUttSamples = (size_t)kRate * 30;
+
+    struct Utterance {
+        std::vector<int16_t> pcm;       // empty: typed
+        size_t begin = 0, end = 0;      // voiced span to decode
+        std::string text;               // typed command
+        int endpoint_ms = 0;
+        Clock::time_point t_end{};
+    };
+
+    struct Totals {
+        int turns = 0;
+        int skipped = 0;
+        double e2e_first_text_ms = 0.0;
+        int e2e_n = 0;
+    };
+
+    bool send(NetFrameKind kind, const void* data, size_t n, unsigned rate = 0, unsigned ch = 0) {
+        std::lock_guard<std::mutex> lk(send_mu_);
+        return net_write_frame(fd_, kind, data, n, rate, ch);
+    }
+    bool send_text(NetFrameKind kind, const std::string& s) { return send(kind, s.data(), s.size()); }
+
+    void feed_audio(const std::string& bytes);
+    void finish_utterance(int endpoint_ms);
+    void turn_loop();
+    void turn(Utterance& u);
+    void speak(const std::string& text, Clock::time_point t_end, int endpoint_ms, bool& first,
+               uint64_t tts_epoch);
+    void cancel_reply();
+
+    Shared& sh_;
+    const int fd_;
+    const int sid_;
+    const std::string peer_;
+    std::mutex send_mu_;
+
+    BoundedQueue<Utterance> utt_q_;
+    std::atomic<bool> replying_{false};
+    // Advanced by every barge-in; a turn that captured an older value says
+    // nothing more. cancel_m_ makes a barge-in's cancels and a turn's read
+    // of this and the TTS epoch all-or-nothing.
+    std::mutex cancel_m_;
+    std::atomic<uint64_t> cancel_gen_{0};
+    std::unique_ptr<IntentRouter> router_;
+    std::unique_ptr<CoquiTTS> tts_;
+
+    // Capture side (connection thread only).
+    Fvad* vad_ = nullptr;
+    std::unique_ptr<Endpointer> ep_;
+    std::unique_ptr<CircularBuffer<int16_t>> preroll_;
+    std::unique_ptr<CircularBuffer<uint8_t>> preroll_voiced_;
+    std::vector<int16_t> pending_;      // partial frame from the socket
+    std::vector<int16_t> utt_;
+    VoicedSpan voiced_;
+    uint64_t utt_id_ = 0;
+
+    Totals tot_{};
+};
+
+void RoomSession::feed_audio(const std::string& bytes) {
+    const size_t n = bytes.size() / 2;
+    const size_t old = pending_.size();
+    pending_.resize(old + n);
+    std::memcpy(pending_.data() + old, bytes.data(), n * 2);
+
+    size_t off = 0;
+    for (; off + kFrameSamples <= pending_.size(); off += kFrameSamples) {
+        const int16_t* frame = pending_.data() + off;
+        const int v = fvad_process(vad_, frame, kFrameSamples);
+
+        // One verdict per pre-roll frame, every frame, so the two stay
+        // aligned across utterances (main.cpp: update_preroll).
+        preroll_->push(frame, kFrameSamples);
+        const uint8_t pv = v > 0 ? 1 : 0;
+        preroll_voiced_->push(&pv, 1);
+
+        const bool was_in_speech = ep_->in_speech();
+        const Endpointer::Decision dec = ep_->push(v, frame, kFrameSamples);
+
+        if (!was_in_speech) {
+            if (dec == Endpointer::Decision::Start) {
+                ep_->start(++utt_id_);
+                utt_.resize(preroll_->size());
+                preroll_->copy_out(0, utt_.data(), preroll_->size());
+                voiced_.reset();
+                for (size_t k = 0; k < preroll_voiced_->size(); k++) {
+                    uint8_t fv = 0;
+                    preroll_voiced_->copy_out(k, &fv, 1);
+                    voiced_.add(k * kFrameSamples, kFrameSamples, fv != 0);
+                }
+                if (sh_.opt.barge_in && replying_.load()) cancel_reply();
+            }
+            continue;
+        }
+
+        voiced_.add(utt_.size(), kFrameSamples, ep_->voiced());
+        utt_.insert(utt_.end(), frame, frame + kFrameSamples);
+        if (dec == Endpointer::Decision::End) {
+            finish_utterance(ep_->last_endpoint().trailing_ms);
+        } else if (utt_.size() >= kMaxUttSamples) {
+            std::fprintf(stderr, "[server] session=%d utterance hit %zu s; cut\n",
+                         sid_, kMaxUttSamples / kRate);
+            ep_->reset();
+            finish_utterance(0);
+        }
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + (long)off);
+}
+
+void RoomSession::finish_utterance(int endpoint_ms) {
+    Utterance u;
+    u.t_end = Clock::now();
+    u.endpoint_ms = endpoint_ms;
+    // Same trimming as edna's ASR stage (trim_lead_ms / trim_trail_ms).
+    voiced_.bounds(utt_.size(), 120 * 16, 200 * 16, u.begin, u.end);
+    u.pcm.swap(utt_);
+    utt_.clear();
+    if (u.pcm.size() >= kRate / 5) utt_q_.push(std::move(u));
+}
+
+void RoomSession::cancel_reply() {
+    std::lock_guard<std::mutex> lk(cancel_m_);
+    cancel_gen_.fetch_add(1);
+    sh_.llm.cancel(sid_);
+    if (tts_) tts_->cancel();
+}
+
+// Reply text goes out sentence by sentence; with --tts the same sentences
+// are queued for synthesis and the PCM follows through the playback tap.
+// tts_epoch drops what a barge-in since the turn started would have.
+void RoomSession::speak(const std::string& text, Clock::time_point t_end, int endpoint_ms, bool& first,
+                        uint64_t tts_epoch) {
+    if (!first) {
+        first = true;
+        const double ms = endpoint_ms + ms_since(t_end, Clock::now());
+        tot_.e2e_first_text_ms += ms;
+        tot_.e2e_n++;
+    }
+    send_text(NetFrameKind::Text, text);
+    if (tts_) tts_->enqueue(text, tts_epoch);
+}
+
+void RoomSession::turn(Utterance& u) {
+    std::string txt = u.text;
+    double asr_ms = 0.0;
+    WhisperPool::Stats ws{};
+    if (!u.pcm.empty()) {
+        const auto a0 = Clock::now();
+        txt = trim_ws(sh_.asr.transcribe(u.pcm.data() + u.begin, u.end - u.begin, &ws));
+        asr_ms = ms_since(a0, Clock::now());
+        if (!txt.empty()) send_text(NetFrameKind::Heard, txt);
+    }
+
+    std::string cmd = txt;
+    const bool invoked = strip_invocation(cmd);
+    cmd = trim_ws(invoked ? cmd : normalize(cmd));
+    if (!u.pcm.empty() && (txt.size() < 2 || txt == "[BLANK_AUDIO]")) cmd.clear();
+    if (cmd.empty() || (sh_.opt.require_invocation && u.text.empty() && !invoked)) {
+        tot_.skipped++;
+        send(NetFrameKind::End, nullptr, 0);
+        return;
+    }
+    tot_.turns++;
+
+    bool first = false;
+    uint64_t gen = 0, tts_epoch = 0;
+    {
+        std::lock_guard<std::mutex> lk(cancel_m_);
+        replying_.store(true);
+        gen = cancel_gen_.load();
+        if (tts_) tts_epoch = tts_->epoch();
+    }
+    auto cancelled = [&]{ return cancel_gen_.load() != gen; };
+    IntentRouter::Result routed;
+    std::string reply;
+    LlamaSessions::Stats ls{};
+    const auto l0 = Clock::now();
+    if (router_->route(cmd, routed)) {
+        reply = routed.reply;
+        if (!reply.empty() && !cancelled()) speak(reply, u.t_end, u.endpoint_ms, first, tts_epoch);
+    } else {
+        SentenceSplitter splitter;
+        std::vector<std::string> sentences;
+        reply = sh_.llm.reply_stream(sid_, cmd, [&](const std::string& piece) {
+            // A barge-in before the request was registered had nothing to
+            // cancel yet; repeat it now that one is in flight.
+            if (cancelled()) {
+                sh_.llm.cancel(sid_);
+                return;
+            }
+            splitter.feed(piece, sentences);
+            for (const auto& s : sentences) speak(s, u.t_end, u.endpoint_ms, first, tts_epoch);
+            sentences.clear();
+        });
+        // Barged in: the tail of the cancelled reply stays unsaid.
+        if (!cancelled()) {
+            splitter.flush(sentences);
+            for (const auto& s : sentences) speak(s, u.t_end, u.endpoint_ms, first, tts_epoch);
+        }
+        ls = sh_.llm.last_stats(sid_);
+    }
+    const double llm_ms = ms_since(l0, Clock::now());
+    if (tts_) tts_->wait_idle();
+    replying_.store(false);
+    router_->set_last_reply(reply);
+    send(NetFrameKind::End, nullptr, 0);
+
+    std::fprintf(stderr, "[perf] session=%d peer=%s endpoint_ms=%d asr_wait_ms=%.1f asr_ms=%.1f audio_ctx=%d "
+                         "intent=%s llm_ms=%.1f llm_queue_ms=%.1f ttft_ms=%.1f prefill_tps=%.1f gen_tps=%.1f "
+                         "gen_tokens=%d batch_sessions=%.2f e2e_ms=%.1f\n",
+                 sid_, peer_.c_str(), u.endpoint_ms, ws.wait_ms, asr_ms, ws.asr.audio_ctx,
+                 routed.intent.empty() ? "-" : routed.intent.c_str(), llm_ms,
+                 ls.queue_ms, ls.turn.ttft_ms, ls.turn.prefill_tps(), ls.turn.gen_tps(),
+                 ls.turn.gen_tokens, ls.batch_sessions, u.endpoint_ms + ms_since(u.t_end, Clock::now()));
+}
+
+void RoomSession::turn_loop() {
+    Utterance u;
+    while (utt_q_.pop(u)) turn(u);
+}
+
+void RoomSession::run() {
+    vad_ = fvad_new();
+    if (!vad_ || fvad_set_sample_rate(vad_, (int)kRate) != 0) {
+        send_text(NetFrameKind::Err, "server: fvad init failed");
+        if (vad_) fvad_free(vad_);
+        return;
+    }
+    fvad_set_mode(vad_, 2);
+    Endpointer::Params ep_p;
+    ep_p.frame_ms = kFrameMs;
+    ep_.reset(new Endpointer(ep_p));
+    preroll_.reset(new CircularBuffer<int16_t>((size_t)kPrerollFrames * kFrameSamples));
+    preroll_voiced_.reset(new CircularBuffer<uint8_t>((size_t)kPrerollFrames));
+
+    // Timers and volume belong to the room.
+    router_.reset(new IntentRouter(IntentRouter::Params{}));
+    if (sh_.opt.use_tts) {
+        tts_.reset(new CoquiTTS(sh_.tts_p));
+        tts_->set_playback_tap([this](const int16_t* pcm, size_t frames, unsigned rate, unsigned ch,
+                                      Clock::time_point) {
+            send(NetFrameKind::Pcm, pcm, frames * ch * sizeof(int16_t), rate, ch);
+        });
+        if (!tts_->ensure_worker()) {
+            std::fprintf(stderr, "[server] session=%d TTS unavailable (%s); text only\n",
+                         sid_, tts_->last_error().c_str());
+            tts_.reset();
+        } else {
+            tts_->set_volume(router_->volume());
+            router_->set_volume_fn([this](int percent) { tts_->set_volume(percent); });
+        }
+    }
+    router_->set_announce([this](const std::string& text) {
+        send_text(NetFrameKind::Text, text);
+        if (tts_) tts_->enqueue(text);
+        send(NetFrameKind::End, nullptr, 0);
+    });
+
+    std::thread turns([this]() { turn_loop(); });
+
+    bool clean = false;
+    NetFrame f;
+    while (g_running.load() && net_read_frame(fd_, f)) {
+        if (f.kind == NetFrameKind::Pcm) {
+            if (f.bits != 16 || f.channels != 1 || f.sample_rate != kRate) {
+                send_text(NetFrameKind::Err, "server: PCM must be 16 kHz mono s16le");
+                break;
+            }
+            feed_audio(f.payload);
+        } else if (f.kind == NetFrameKind::Text) {
+            Utterance u;
+            u.text = f.payload;
+            u.t_end = Clock::now();
+            utt_q_.push(std::move(u));
+        } else if (f.kind == NetFrameKind::End) {
+            if (ep_->in_speech() && !utt_.empty()) finish_utterance(0);
+            clean = true;
+            break;
+        }
+    }
+
+    // Client gone: stop talking to it. A clean END lets pending turns finish.
+    if (!clean) {
+        utt_q_.clear();
+        cancel_reply();
+    }
+    utt_q_.close();
+    turns.join();
+    router_.reset();   // timer thread first: its announce uses tts_
+    tts_.reset();
+    fvad_free(vad_);
+
+    std::fprintf(stderr, "[perf] session=%d peer=%s closed turns=%d skipped=%d e2e_first_text_ms_mean=%.1f\n",
+                 sid_, peer_.c_str(), tot_.turns, tot_.skipped,
+                 tot_.e2e_n ? tot_.e2e_first_text_ms / tot_.e2e_n : 0.0);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+
+    const char* top_env = std::getenv("EDNA_TOP_DIR");
+    const std::string TOP = top_env ? top_env : ".";
+    if (opt.whisper_model.empty())
+        opt.whisper_model = TOP + "/third_party/whisper.cpp/models/ggml-base.en.bin";
+    if (opt.llama_model.empty())
+        opt.llama_model = TOP + "/models/Qwen2.5-2B-Instruct.Q6_K.gguf";
+
+    // No SA_RESTART: accept() has to return on SIGINT.
+    struct sigaction sa{};
+    sa.sa_handler = on_sigint;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    /* ===================== Engines (edna's settings, shared) ===================== */
+    WhisperPool::Params asr_p;
+    asr_p.asr.use_gpu = true;
+    asr_p.asr.n_threads = 4;
+    asr_p.asr.single_segment = true;
+    asr_p.asr.no_context = true;
+    asr_p.asr.language = "en";
+    asr_p.n_states = std::min(opt.asr_states, opt.max_sessions);
+    WhisperPool asr(opt.whisper_model, asr_p);
+
+    LlamaSessions::Params llm_p;
+    llm_p.llm.n_gpu_layers = 999;
+    llm_p.llm.n_ctx = opt.n_ctx;
+    llm_p.llm.kv_type = opt.kv_type;
+    llm_p.llm.n_threads = 4;
+    llm_p.llm.n_batch = 256;
+    llm_p.llm.max_new_tokens = 96;
+    llm_p.max_sessions = opt.max_sessions;
+    LlamaSessions llm(opt.llama_model, llm_p);
+    if (!llm.warmup()) std::fprintf(stderr, "[server] LLM warm-up failed\n");
+
+    Shared sh(opt, asr, llm);
+    sh.tts_p.out_device = "null";   // the room plays it; we only pace and tap
+
+    /* ===================== Listener ===================== */
+    const int lfd = ::socket(AF_INET6, SOCK_STREAM, 0);
+    if (lfd < 0) {
+        std::perror("[server] socket");
+        return 1;
+    }
+    const int one = 1, zero = 0;
+    ::setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    ::setsockopt(lfd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+    sockaddr_in6 addr{};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_any;
+    addr.sin6_port = htons((uint16_t)opt.port);
+    if (::bind(lfd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(lfd, 16) != 0) {
+        std::perror("[server] bind/listen");
+        return 1;
+    }
+    std::fprintf(stderr, "[server] listening on port %d max_sessions=%d asr_states=%d tts=%d invocation=%d\n",
+                 opt.port, opt.max_sessions, asr.size(), opt.use_tts ? 1 : 0, opt.require_invocation ? 1 : 0);
+
+    // One thread per connection, joined once it reports itself finished
+    // (on the next accept) or at shutdown.
+    std::vector<std::thread> sessions;
+    auto reap = [&]() {
+        std::vector<std::thread::id> done;
+        {
+            std::lock_guard<std::mutex> lk(sh.m);
+            done.swap(sh.finished);
+        }
+        for (const std::thread::id& id : done) {
+            auto it = std::find_if(sessions.begin(), sessions.end(),
+                                   [&](const std::thread& t) { return t.get_id() == id; });
+            if (it == sessions.end()) continue;
+            it->join();
+            sessions.erase(it);
+        }
+    };
+
+    while (g_running.load()) {
+        sockaddr_in6 peer{};
+        socklen_t plen = sizeof(peer);
+        const int fd = ::accept(lfd, (sockaddr*)&peer, &plen);
+        reap();
+        if (fd < 0) continue;   // EINTR on shutdown
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        char host[INET6_ADDRSTRLEN] = {0};
+        ::inet_ntop(AF_INET6, &peer.sin6_addr, host, sizeof(host));
+        const std::string who = std::string(host) + ":" + std::to_string(ntohs(peer.sin6_port));
+
+        const int sid = llm.open();
+        if (sid < 0) {
+            std::fprintf(stderr, "[server] reject %s: %d sessions open\n", who.c_str(), llm.max_sessions());
+            net_write_text(fd, NetFrameKind::Err, "busy: all " + std::to_string(llm.max_sessions()) +
+                                                  " sessions are in use");
+            ::close(fd);
+            continue;
+        }
+        size_t live = 0;
+        {
+            std::lock_guard<std::mutex> lk(sh.m);
+            sh.fds.push_back(fd);
+            live = sh.fds.size();
+        }
+        std::fprintf(stderr, "[server] session=%d open peer=%s live=%zu\n", sid, who.c_str(), live);
+
+        sessions.emplace_back([&sh, fd, sid, who]() {
+            {
+                RoomSession s(sh, fd, sid, who);
+                s.run();
+            }
+            sh.llm.close(sid);
+            const LlamaSessions::SchedStats st = sh.llm.sched_stats();
+            std::fprintf(stderr, "[llm] sched decodes=%llu avg_tokens=%.1f avg_sessions=%.2f peak_sessions=%d\n",
+                         (unsigned long long)st.decodes, st.avg_tokens(), st.avg_sessions(), st.peak_sessions);
+            std::lock_guard<std::mutex> lk(sh.m);
+            sh.fds.erase(std::find(sh.fds.begin(), sh.fds.end(), fd));
+            ::close(fd);
+            sh.finished.push_back(std::this_thread::get_id());
+        });
+    }
+
+    ::close(lfd);
+    // Unblock every session's read; each then cancels its reply and exits.
+    {
+        std::lock_guard<std::mutex> lk(sh.m);
+        for (int fd : sh.fds) ::shutdown(fd, SHUT_RDWR);
+    }
+    // Session threads use llm, asr and sh until they return: join them all
+    // before those go out of scope.
+    for (std::thread& t : sessions) t.join();
+    return 0;
+}
@@ -0,0 +1,92 @@
+// spsc_ring.hpp
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * SpscRing
+ *
+ * Fixed-capacity single-producer / single-consumer ring. All slots are
+ * allocated up front; push and pop never allocate, lock or block, so the
+ * producer can be a real-time loop (the ALSA capture read) and the consumer
+ * can sit in a slow decode without stalling it.
+ *
+ * N must be a power of two. head_ is written only by the consumer, tail_ only
+ * by the producer; each side caches the other's index to avoid touching the
+ * shared cache line on every call.
+ */
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+public:
+    SpscRing() = default;
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    static constexpr size_t capacity() { return N; }
+
+    // Producer side. Returns false (and leaves the ring untouched) when full.
+    bool try_push(const T& v) {
+        const size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_cache_ == N) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (t - head_cache_ == N) return false;
+        }
+        slots_[t & (N - 1)] = v;
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool try_pop(T& out) {
+        const size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (h == tail_cache_) return false;
+        }
+        out = slots_[h & (N - 1)];
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate; exact only when called from one of the two owning threads
+    // while the other is idle.
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t kLine = 64;
+
+    alignas(kLine) std::atomic<size_t> head_{0};   // consumer-owned
+    size_t tail_cache_ = 0;                        // consumer's view of tail_
+    alignas(kLine) std::atomic<size_t> tail_{0};   // producer-owned
+    size_t head_cache_ = 0;                        // producer's view of head_
+    alignas(kLine) std::array<T, N> slots_{};
+};
+
+/*
+ * AudioFrame
+ *
+ * One 20 ms capture frame plus utterance markers, the unit carried by the
+ * capture -> ASR ring. Marker-only frames use n == 0.
+ */
+struct AudioFrame {
+    static constexpr size_t kMaxSamples = 320;   // 20 ms @ 16 kHz
+
+    enum Flags : uint32_t {
+        Begin    = 1u << 0,   // first frame of a new utterance (pre-roll starts here)
+        Snapshot = 1u << 1,   // request a partial decode after this frame
+        End      = 1u << 2,   // utterance complete: run the final decode
+        Voiced   = 1u << 3,   // Endpointer verdict for this frame (speech, not silence)
+    };
+
+    uint64_t utt = 0;
+    uint32_t flags = 0;
+    uint32_t n = 0;
+    int16_t  pcm[kMaxSamples];
+};
@@ -20,7 +20,7 @@ void EdnaStateMachine::start() {
     dispatch(Event::Start, "start()");
 }
 
-void EdnaStateMachine::dispatch(Event ev, const std::string& note) {
+bool EdnaStateMachine::dispatch(Event ev, const std::string& note) {
     Observer obs_copy;
     State from, to;
     bool did = false;
@@ -37,6 +37,7 @@ void EdnaStateMachine::dispatch(Event ev, const std::string& note) {
     if (did && obs_copy) {
         obs_copy(from, to, ev, note);
     }
+    return did;
 }
 
 EdnaStateMachine::State
@@ -54,6 +55,7 @@ EdnaStateMachine::transition_locked(EdnaStateMachine::State cur,
     
         case State::AwaitSpeech:
             if (ev == Event::SpeechStart) { did_transition = true; return State::CapturingSpeech; }
+            if (ev == Event::Announce)    { did_transition = true; return State::Speaking; }
             break;
     
         case State::CapturingSpeech:
@@ -80,10 +82,12 @@ EdnaStateMachine::transition_locked(EdnaStateMachine::State cur,
                 did_transition = true;
                 return State::AwaitSpeech;
             }
+            if (ev == Event::BargeIn) { did_transition = true; return State::CapturingSpeech; }
             break;
         
         case State::Speaking:
             if (ev == Event::TtsDone) { did_transition = true; return State::AwaitSpeech; }
+            if (ev == Event::BargeIn) { did_transition = true; return State::CapturingSpeech; }
             break;
     
         case State::Error:
@@ -123,6 +127,8 @@ const char* EdnaStateMachine::event_name(Event e) {
         case Event::Stop:           return "Stop";
         case Event::NoCommand:      return "NoCommand";
         case Event::Fail:           return "Fail";
+        case Event::BargeIn:        return "BargeIn";
+        case Event::Announce:       return "Announce";
     }
     return "Unknown";
 }
@@ -32,6 +32,8 @@ public:
         Stop,
         NoCommand,
         Fail,
+        BargeIn,        // user spoke over Thinking/Speaking; reply cancelled
+        Announce,       // unprompted speech (timer expired) while idle
     };
 
     struct Config {
@@ -51,7 +53,8 @@ public:
     void start();
 
     // Dispatch an event. Optional note is for debugging/logging.
-    void dispatch(Event ev, const std::string& note = "");
+    // Returns true if the event caused a transition.
+    bool dispatch(Event ev, const std::string& note = "");
 
     // Subscribe to transitions (called on every transition).
     void set_observer(Observer obs);
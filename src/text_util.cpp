@@ -0,0 +1,124 @@
+// text_util.cpp
+#include "text_util.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+std::string trim_ws(const std::string& s) {
+    size_t a = 0, b = s.size();
+    while (a < b && std::isspace((unsigned char)s[a])) a++;
+    while (b > a && std::isspace((unsigned char)s[b - 1])) b--;
+    return s.substr(a, b - a);
+}
+
+std::string normalize(const std::string& in) {
+    std::string s;
+    s.reserve(in.size());
+    for (unsigned char c : in) {
+        if (std::isalnum(c) || std::isspace(c)) s.push_back((char)std::tolower(c));
+        else s.push_back(' ');
+    }
+    // collapse spaces
+    std::string out;
+    out.reserve(s.size());
+    bool prev_space = true;
+    for (unsigned char c : s) {
+        bool sp = std::isspace(c);
+        if (sp) {
+            if (!prev_space) out.push_back(' ');
+        } else {
+            out.push_back((char)c);
+        }
+        prev_space = sp;
+    }
+    return trim_ws(out);
+}
+
+// Longer prefixes first. Includes aliases for common Whisper mishears.
+static const char* const kInvocations[] = {
+    "hey edna",
+    "okay edna",
+    "ok edna",
+    "edna",
+    "etna",
+    "ewa",
+    "ed",
+    "ed nah",
+    "ed na",
+};
+
+bool strip_invocation(std::string& text) {
+    std::string t = normalize(text);
+
+    for (const char* pfx : kInvocations) {
+        if (t.rfind(pfx, 0) == 0) {
+            text = trim_ws(t.substr(std::char_traits<char>::length(pfx)));
+            return true;   // leave only the remainder (may be empty)
+        }
+    }
+    return false;
+}
+
+bool has_invocation(const std::string& text) {
+    std::string t = text;
+    return strip_invocation(t);
+}
+
+bool looks_complete(const std::string& text) {
+    const std::string t = trim_ws(text);
+    if (t.empty()) return false;
+    const char last = t.back();
+    if (last != '?' && last != '.' && last != '!') return false;
+    // "Edna." on its own is not a command: want at least three words.
+    const std::string n = normalize(t);
+    return std::count(n.begin(), n.end(), ' ') >= 2;
+}
+
+std::vector<std::string> split_sentences(const std::string& in) {
+    std::vector<std::string> out;
+    SentenceSplitter sp;
+    sp.feed(in, out);
+    sp.flush(out);
+    return out;
+}
+
+/* ------------------------------------------------------------ */
+/* SentenceSplitter                                             */
+/* ------------------------------------------------------------ */
+
+void SentenceSplitter::emit(size_t n, std::vector<std::string>& out) {
+    std::string s = trim_ws(buf_.substr(0, n));
+    buf_.erase(0, n);
+    scan_ = 0;
+    if (!s.empty()) out.push_back(std::move(s));
+}
+
+void SentenceSplitter::feed(const std::string& piece, std::vector<std::string>& out) {
+    buf_ += piece;
+
+    // A sentence ends at . ! ? followed by whitespace. A trailing '.' is left
+    // pending until the next piece shows what follows it ("3.5", "e.g.").
+    size_t i = scan_;
+    while (i + 1 < buf_.size()) {
+        const char c = buf_[i];
+        const bool end_punct = (c == '.' || c == '!' || c == '?');
+        if (end_punct && std::isspace((unsigned char)buf_[i + 1])) {
+            emit(i + 1, out);
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+    scan_ = i;
+
+    // No punctuation in sight: fall back to a soft wrap at the last space.
+    while (buf_.size() > soft_wrap_) {
+        size_t cut = buf_.rfind(' ', soft_wrap_);
+        if (cut == std::string::npos || cut == 0) cut = soft_wrap_;
+        emit(cut, out);
+    }
+}
+
+void SentenceSplitter::flush(std::vector<std::string>& out) {
+    emit(buf_.size(), out);
+}
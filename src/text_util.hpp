@@ -0,0 +1,55 @@
+// text_util.hpp
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Small text helpers shared by the pipeline stages (transcript cleanup,
+// invocation matching, sentence chunking for TTS).
+
+std::string trim_ws(const std::string& s);
+
+// Lowercase, replace punctuation with spaces, collapse whitespace.
+std::string normalize(const std::string& in);
+
+// If text starts with an invocation ("hey edna", "edna", ...), replace it with
+// the normalized remainder and return true.
+bool strip_invocation(std::string& text);
+
+// True if text starts with an invocation (same aliases as strip_invocation).
+bool has_invocation(const std::string& text);
+
+// True if a (partial) transcript reads like a finished command or question:
+// ends in terminal punctuation and has a few words. Used as an endpointing cue.
+bool looks_complete(const std::string& text);
+
+// Cheap splitter to reduce TTS latency by synthesizing smaller chunks.
+std::vector<std::string> split_sentences(const std::string& in);
+
+/*
+ * SentenceSplitter
+ *
+ * Incremental version of split_sentences() for streamed LLM output: feed
+ * pieces as they are decoded and complete sentences come out as soon as their
+ * terminating punctuation is followed by whitespace. Runs longer than
+ * soft_wrap bytes without punctuation are cut at the last space.
+ */
+class SentenceSplitter {
+public:
+    explicit SentenceSplitter(size_t soft_wrap = 180) : soft_wrap_(soft_wrap) {}
+
+    // Append a piece; completed sentences are appended to out.
+    void feed(const std::string& piece, std::vector<std::string>& out);
+
+    // End of stream: emit whatever is left.
+    void flush(std::vector<std::string>& out);
+
+    void reset() { buf_.clear(); scan_ = 0; }
+
+private:
+    void emit(size_t n, std::vector<std::string>& out);
+
+    std::string buf_;
+    size_t scan_ = 0;       // bytes of buf_ already checked for boundaries
+    size_t soft_wrap_;
+};
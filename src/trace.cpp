@@ -0,0 +1,261 @@
+// trace.cpp
+#include "trace.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<bool> Tracer::enabled_{false};
+
+namespace {
+
+// Rolling window of durations for one span name.
+struct Series {
+    std::vector<double> ms;      // ring, grows to the window size once
+    size_t next = 0;
+    uint64_t count = 0;
+    double max_ms = 0.0;
+};
+
+double percentile(std::vector<double>& v, double q) {
+    if (v.empty()) return 0.0;
+    const size_t k = std::min(v.size() - 1, (size_t)(q * (double)(v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + (long)k, v.end());
+    return v[k];
+}
+
+} // namespace
+
+struct Tracer::Impl {
+    Params p;
+    bool exporting = false;
+
+    mutable std::mutex m;
+    std::map<std::string, Series, std::less<>> series;
+
+    // Anchors of the last few turns; a reply can still be playing for turn
+    // N while turn N+1 has been endpointed.
+    struct Anchor { uint64_t turn = 0; Clock::time_point t{}; };
+    Anchor anchors[8];
+    size_t anchor_next = 0;
+
+    Clock::time_point last_transition{};
+    const Clock::time_point origin = Clock::now();
+
+    // Export
+    std::vector<std::string> pending;
+    std::condition_variable cv;
+    bool stop = false;
+    std::thread writer;
+    int fd = -1;
+    sockaddr_un addr{};
+    bool dgram = false;
+
+    static constexpr size_t kMaxPending = 4096;   // writer fell behind: drop
+
+    void record(uint64_t turn, const char* name, Clock::time_point t0, Clock::time_point t1) {
+        const double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+
+        std::lock_guard<std::mutex> lk(m);
+        auto it = series.find(name);
+        if (it == series.end()) it = series.emplace(name, Series{}).first;
+        Series& s = it->second;
+        if (s.ms.size() < (size_t)p.window) {
+            s.ms.push_back(ms);
+        } else {
+            s.ms[s.next] = ms;
+            s.next = (s.next + 1) % s.ms.size();
+        }
+        s.count++;
+        s.max_ms = std::max(s.max_ms, ms);
+
+        if (!exporting || pending.size() >= kMaxPending) return;
+        char line[256];
+        const long long t0_us =
+            (long long)std::chrono::duration_cast<std::chrono::microseconds>(t0 - origin).count();
+        std::snprintf(line, sizeof(line),
+                      "{\"turn\":%llu,\"span\":\"%s\",\"t0_us\":%lld,\"dur_us\":%lld}\n",
+                      (unsigned long long)turn, name, t0_us, (long long)(ms * 1000.0));
+        pending.emplace_back(line);
+    }
+
+    bool open_sink() {
+        const std::string& s = p.sink;
+        if (s.compare(0, 5, "unix:") == 0) {
+            const std::string path = s.substr(5);
+            if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+            fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (fd < 0) return false;
+            addr.sun_family = AF_UNIX;
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            dgram = true;
+            return true;
+        }
+        fd = ::open(s.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        return fd >= 0;
+    }
+
+    void write_out(const std::vector<std::string>& lines) {
+        for (const auto& l : lines) {
+            if (dgram) {
+                // No listener / full socket buffer: lose the span, never block.
+                (void)::sendto(fd, l.data(), l.size(), MSG_DONTWAIT,
+                               (const sockaddr*)&addr, sizeof(addr));
+            } else {
+                size_t off = 0;
+                while (off < l.size()) {
+                    const ssize_t n = ::write(fd, l.data() + off, l.size() - off);
+                    if (n < 0 && errno == EINTR) continue;
+                    if (n <= 0) return;
+                    off += (size_t)n;
+                }
+            }
+        }
+    }
+
+    void writer_loop() {
+        std::vector<std::string> batch;
+        std::unique_lock<std::mutex> lk(m);
+        while (true) {
+            cv.wait_for(lk, std::chrono::milliseconds(p.flush_ms), [&]{ return stop; });
+            batch.swap(pending);
+            const bool done = stop;
+            lk.unlock();
+            write_out(batch);
+            batch.clear();
+            lk.lock();
+            if (done && pending.empty()) break;
+        }
+    }
+};
+
+Tracer& Tracer::instance() {
+    static Tracer t;
+    return t;
+}
+
+Tracer::Tracer() : impl_(new Impl) {}
+
+Tracer::~Tracer() {
+    stop();
+    delete impl_;
+}
+
+bool Tracer::params_from_env(Params& out) {
+    const char* v = std::getenv("EDNA_TRACE");
+    if (!v || !*v || std::strcmp(v, "0") == 0) return false;
+    out.sink = (std::strcmp(v, "1") == 0) ? "" : v;
+    return true;
+}
+
+bool Tracer::start(const Params& p) {
+    if (on()) return true;
+    impl_->p = p;
+    impl_->p.window = std::max(1, p.window);
+    impl_->p.flush_ms = std::max(10, p.flush_ms);
+
+    if (!p.sink.empty()) {
+        if (!impl_->open_sink()) {
+            std::fprintf(stderr, "[trace] cannot open sink '%s': %s\n",
+                         p.sink.c_str(), std::strerror(errno));
+            return false;
+        }
+        impl_->exporting = true;
+        impl_->stop = false;
+        impl_->writer = std::thread([this]{ impl_->writer_loop(); });
+    }
+
+    impl_->last_transition = Clock::now();
+    enabled_.store(true, std::memory_order_relaxed);
+    std::fprintf(stderr, "[trace] enabled sink=%s window=%d\n",
+                 p.sink.empty() ? "none" : p.sink.c_str(), impl_->p.window);
+    return true;
+}
+
+void Tracer::stop() {
+    if (!on()) return;
+    enabled_.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lk(impl_->m);
+        impl_->stop = true;
+    }
+    impl_->cv.notify_all();
+    if (impl_->writer.joinable()) impl_->writer.join();
+    if (impl_->fd >= 0) {
+        ::close(impl_->fd);
+        impl_->fd = -1;
+    }
+    impl_->exporting = false;
+}
+
+void Tracer::span(uint64_t turn, const char* name, Clock::time_point t0, Clock::time_point t1) {
+    if (!on()) return;
+    impl_->record(turn, name, t0, t1);
+}
+
+void Tracer::anchor(uint64_t turn, Clock::time_point t) {
+    if (!on()) return;
+    std::lock_guard<std::mutex> lk(impl_->m);
+    impl_->anchors[impl_->anchor_next] = {turn, t};
+    impl_->anchor_next = (impl_->anchor_next + 1) % (sizeof(impl_->anchors) / sizeof(impl_->anchors[0]));
+}
+
+void Tracer::since_anchor(uint64_t turn, const char* name, Clock::time_point t) {
+    if (!on()) return;
+    Clock::time_point t0{};
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lk(impl_->m);
+        for (const auto& a : impl_->anchors) {
+            if (a.turn == turn && turn != 0) {
+                t0 = a.t;
+                found = true;
+                break;
+            }
+        }
+    }
+    if (found) impl_->record(turn, name, t0, t);
+}
+
+void Tracer::transition(const char* from_state, Clock::time_point t) {
+    if (!on()) return;
+    Clock::time_point t0;
+    {
+        std::lock_guard<std::mutex> lk(impl_->m);
+        t0 = impl_->last_transition;
+        impl_->last_transition = t;
+    }
+    impl_->record(turn(), (std::string("state:") + from_state).c_str(), t0, t);
+}
+
+std::string Tracer::report() const {
+    if (!on()) return {};
+    std::string out;
+    char line[256];
+    std::vector<double> tmp;
+    std::lock_guard<std::mutex> lk(impl_->m);
+    for (const auto& kv : impl_->series) {
+        const Series& s = kv.second;
+        tmp = s.ms;
+        const double p50 = percentile(tmp, 0.50);
+        const double p95 = percentile(tmp, 0.95);
+        const double p99 = percentile(tmp, 0.99);
+        std::snprintf(line, sizeof(line),
+                      "[perf] span=%s n=%llu p50_ms=%.1f p95_ms=%.1f p99_ms=%.1f max_ms=%.1f\n",
+                      kv.first.c_str(), (unsigned long long)s.count, p50, p95, p99, s.max_ms);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,113 @@
+// trace.hpp
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/*
+ * Tracer
+ *
+ * Per-turn latency spans. A turn is one utterance (the capture loop's
+ * utterance id); every stage records monotonic-clock spans against it:
+ * endpoint delay, ASR queue wait and decode, LLM time-to-first-token,
+ * time-to-first-audio, state dwell times, the post-reply cooldown. Each
+ * span name keeps a rolling window of durations for p50/p95/p99.
+ *
+ * Spans measured from the end of the user's speech (first token, first
+ * audio) use a per-turn anchor: anchor() where the endpoint is decided,
+ * since_anchor() wherever the milestone happens, so no stage has to hand
+ * timestamps downstream.
+ *
+ * Disabled unless EDNA_TRACE is set:
+ *   EDNA_TRACE=1            histograms only (logged with report())
+ *   EDNA_TRACE=unix:/path   also send one JSON object per span as a
+ *                           datagram to a local socket (dropped if nobody
+ *                           is listening)
+ *   EDNA_TRACE=/some/file   also append JSON lines to a file
+ * Export writes happen on a background thread. When disabled every entry
+ * point is one relaxed atomic load.
+ */
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Params {
+        std::string sink;        // "", "unix:/path" or a file path
+        int window = 512;        // samples kept per span name for percentiles
+        int flush_ms = 200;      // export thread period
+    };
+
+    // Process-wide tracer (stages record into the same histograms).
+    static Tracer& instance();
+
+    static bool on() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Params from EDNA_TRACE; false if tracing is not requested.
+    static bool params_from_env(Params& out);
+
+    // Enable tracing / flush and disable it.
+    bool start(const Params& p);
+    void stop();
+
+    // Record [t0, t1] as span `name` of `turn`. name must be a literal
+    // (or otherwise outlive the tracer).
+    void span(uint64_t turn, const char* name, Clock::time_point t0, Clock::time_point t1);
+
+    // End-of-speech time for turn; since_anchor() measures from it.
+    void anchor(uint64_t turn, Clock::time_point t);
+    void since_anchor(uint64_t turn, const char* name, Clock::time_point t);
+
+    // Turn the state machine is currently serving (set at speech start).
+    void set_turn(uint64_t turn) { turn_.store(turn, std::memory_order_relaxed); }
+    uint64_t turn() const { return turn_.load(std::memory_order_relaxed); }
+
+    // State machine hook: records the dwell time of the state being left
+    // as span "state:<from>" of the current turn.
+    void transition(const char* from_state, Clock::time_point t);
+
+    // One line per span name: [perf] span=.. n=.. p50_ms p95_ms p99_ms max_ms
+    std::string report() const;
+
+private:
+    Tracer();
+    ~Tracer();
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    static std::atomic<bool> enabled_;
+    std::atomic<uint64_t> turn_{0};
+
+    struct Impl;
+    Impl* impl_;
+};
+
+/*
+ * TraceSpan
+ *
+ * Scoped span: starts at construction, records at end() or destruction.
+ * Costs one atomic load when tracing is off.
+ */
+class TraceSpan {
+public:
+    TraceSpan(uint64_t turn, const char* name)
+        : turn_(turn), name_(Tracer::on() ? name : nullptr) {
+        if (name_) t0_ = Tracer::Clock::now();
+    }
+    ~TraceSpan() { end(); }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void end() {
+        if (!name_) return;
+        Tracer::instance().span(turn_, name_, t0_, Tracer::Clock::now());
+        name_ = nullptr;
+    }
+
+private:
+    uint64_t turn_;
+    const char* name_;
+    Tracer::Clock::time_point t0_{};
+};
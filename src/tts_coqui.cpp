@@ -1,9 +1,13 @@
 // tts_coqui.cpp
 #include "tts_coqui.hpp"
+#include "gpu_arbiter.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 
 #include <string>
 #include <vector>
@@ -11,7 +15,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
 #include <signal.h>
 
 static std::string shell_escape_single_quotes(const std::string& s) {
@@ -25,25 +30,65 @@ static std::string shell_escape_single_quotes(const std::string& s) {
     return out;
 }
 
-CoquiTTS::CoquiTTS(const Params& p)
-    : p_(p) {
-    // Lazy-start by default (start on first speak()).
+static AlsaPlayback::Params playback_params(const CoquiTTS::Params& p) {
+    AlsaPlayback::Params ap;
+    ap.device      = p.out_device;
+    ap.sample_rate = p.sample_rate;
+    ap.period_us   = p.period_us;
+    ap.buffer_us   = p.buffer_us;
+    return ap;
+}
+
+static PcmCache::Params cache_params(const CoquiTTS::Params& p) {
+    PcmCache::Params cp;
+    cp.max_bytes = p.cache_bytes;
+    cp.dir       = p.cache_dir;
+    return cp;
+}
+
+// Resident set size of a process in kB (/proc/<pid>/status VmRSS), 0 if unknown.
+static long rss_kb(pid_t pid) {
+    const std::string path = "/proc/" + (pid > 0 ? std::to_string(pid) : std::string("self")) + "/status";
+    std::FILE* f = std::fopen(path.c_str(), "r");
+    if (!f) return 0;
+    long kb = 0;
+    char line[256];
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::sscanf(line, "VmRSS: %ld kB", &kb) == 1) break;
+    }
+    std::fclose(f);
+    return kb;
+}
+
+CoquiTTS::CoquiTTS(const Params& p, std::unique_ptr<TtsEngine> engine)
+    : p_(p), out_(playback_params(p)), cache_(cache_params(p)), engine_(std::move(engine)) {
+    // Lazy-start the worker by default (start on first speak()).
+    // The pipeline threads are cheap and idle until something is queued.
+    if (p_.max_synth_ahead < 1) p_.max_synth_ahead = 1;
+    io_deadline_ = io_.add_timer([this]{ io_expired_ = true; });
+    synth_thread_ = std::thread([this]() { apply_stage_config(p_.synth_stage); synth_loop(); });
+    play_thread_  = std::thread([this]() { apply_stage_config(p_.play_stage); play_loop(); });
 }
 
 CoquiTTS::~CoquiTTS() {
+    stop_pipeline();
     shutdown();
 }
 
 bool CoquiTTS::is_enabled() const {
-    std::lock_guard<std::mutex> lk(m_);
-    return enabled_;
+    return enabled_.load();
 }
 
 std::string CoquiTTS::last_error() const {
-    std::lock_guard<std::mutex> lk(m_);
+    std::lock_guard<std::mutex> lk(err_m_);
     return last_err_;
 }
 
+void CoquiTTS::set_error(const std::string& err) {
+    std::lock_guard<std::mutex> lk(err_m_);
+    last_err_ = err;
+}
+
 void CoquiTTS::shutdown() {
     std::lock_guard<std::mutex> lk(m_);
     stop_worker_locked();
@@ -52,10 +97,42 @@ void CoquiTTS::shutdown() {
 bool CoquiTTS::ensure_worker() {
     std::lock_guard<std::mutex> lk(m_);
     if (!enabled_) return false;
+    if (engine_) return load_engine_locked();
     if (worker_.pid > 0 && worker_.ready) return true;
     return start_worker_locked();
 }
 
+bool CoquiTTS::warmup(const std::string& text) {
+    if (!ensure_worker()) return false;
+
+    const bool on_gpu = engine_ ? engine_->uses_gpu() : p_.use_cuda;
+    GpuArbiter* gpu = (on_gpu && p_.gpu_arbitrate) ? &GpuArbiter::for_device(p_.cuda_device) : nullptr;
+    GpuArbiter::Lease lease = gpu_lease(gpu, GpuArbiter::Class::TtsPrefetch);
+    return synthesize(text, [](std::vector<int16_t>&&, unsigned, unsigned) {});
+}
+
+bool CoquiTTS::load_engine_locked() {
+    if (engine_loaded_) return true;
+
+    // Same ready/RSS line as the worker so the two backends compare directly;
+    // here RSS is the growth of this process.
+    const auto t0 = Clock::now();
+    const long rss0 = rss_kb(0);
+    std::string err;
+    if (!engine_->load(err)) {
+        set_error(std::string(engine_->name()) + ": " + err);
+        enabled_ = false;
+        return false;
+    }
+    engine_loaded_ = true;
+    std::fprintf(stderr, "[perf] tts_ready engine=%s ready_ms=%.1f rss_mb=%.1f\n",
+                 engine_->name(),
+                 std::chrono::duration<double, std::milli>(Clock::now() - t0).count(),
+                 (double)(rss_kb(0) - rss0) / 1024.0);
+    set_error("");
+    return true;
+}
+
 bool CoquiTTS::start_worker_locked() {
     // If already running, don’t double-start.
     if (worker_.pid > 0) {
@@ -68,22 +145,25 @@ bool CoquiTTS::start_worker_locked() {
     int out_pipe[2] = {-1, -1};  // child writes to [1], parent reads [0]
 
     if (::pipe(in_pipe) != 0) {
-        last_err_ = "pipe(in_pipe) failed";
+        set_error("pipe(in_pipe) failed");
         enabled_ = false;
         return false;
     }
     if (::pipe(out_pipe) != 0) {
         ::close(in_pipe[0]); ::close(in_pipe[1]);
-        last_err_ = "pipe(out_pipe) failed";
+        set_error("pipe(out_pipe) failed");
         enabled_ = false;
         return false;
     }
 
+    const std::string cuda_dev = std::to_string(p_.cuda_device);
+    const auto t0 = Clock::now();
+
     pid_t pid = ::fork();
     if (pid < 0) {
         ::close(in_pipe[0]); ::close(in_pipe[1]);
         ::close(out_pipe[0]); ::close(out_pipe[1]);
-        last_err_ = "fork() failed";
+        set_error("fork() failed");
         enabled_ = false;
         return false;
     }
@@ -100,16 +180,33 @@ bool CoquiTTS::start_worker_locked() {
         ::close(out_pipe[0]);
         ::close(out_pipe[1]);
 
-        // Python worker script. Prints "READY" once model is loaded, then prints a wav path per line.
+        // Python worker script. Prints "READY" once model is loaded, then
+        // answers each text line with binary frames (see read_frame_locked):
+        // one or more PCM frames followed by END, or a single ERR frame.
         // Uses -u for unbuffered stdout.
         const std::string script =
 R"PY(
-import os, sys, time, warnings
+import os, sys, struct, warnings
 warnings.filterwarnings("ignore")
+
+# Keep a private handle on the protocol pipe and point fd 1 at stderr, so
+# library chatter on stdout can't corrupt the binary stream.
+proto = os.fdopen(os.dup(1), "wb")
+os.dup2(2, 1)
+sys.stdout = sys.stderr
+
+import numpy as np
 from TTS.api import TTS
 
+KIND_PCM, KIND_END, KIND_ERR = 1, 2, 3
+
+def send(kind, payload=b"", rate=0, channels=0):
+    proto.write(struct.pack("<4sIIHHI", b"EDNA", kind, rate, channels, 16, len(payload)))
+    proto.write(payload)
+    proto.flush()
+
 model = os.environ.get("EDNA_TTS_MODEL", "tts_models/en/ljspeech/vits")
-tmpdir = os.environ.get("EDNA_TTS_TMP", "/tmp")
+speaker = os.environ.get("EDNA_TTS_SPEAKER") or None
 use_cuda = os.environ.get("EDNA_TTS_CUDA", "0") == "1"
 
 tts = TTS(model_name=model)
@@ -118,41 +215,48 @@ if use_cuda:
         tts = tts.to("cuda")
     except Exception:
         pass
+rate = int(tts.synthesizer.output_sample_rate)
 
-print("READY", flush=True)
-
-counter = 0
-pid = os.getpid()
+proto.write(b"READY\n")
+proto.flush()
 
 for line in sys.stdin:
     line = line.strip()
     if not line:
-        print("ERR empty", flush=True)
+        send(KIND_ERR, b"empty")
         continue
     if line == "__quit__":
         break
 
-    counter += 1
-    out = os.path.join(tmpdir, f"edna_tts_{pid}_{counter}.wav")
     try:
-        tts.tts_to_file(text=line, file_path=out)
-        print(out, flush=True)
+        out = tts.tts(text=line, speaker=speaker) if speaker else tts.tts(text=line)
+        wav = np.asarray(out, dtype=np.float32)
+        pcm = (np.clip(wav, -1.0, 1.0) * 32767.0).astype("<i2").tobytes()
+        if pcm:
+            send(KIND_PCM, pcm, rate, 1)
+        send(KIND_END)
     except Exception as e:
-        print("ERR " + str(e), flush=True)
+        send(KIND_ERR, str(e).encode("utf-8", "replace"))
 )PY";
 
         // Build argv for execvp
         std::vector<const char*> argv;
         argv.push_back(p_.python_bin.c_str());
         argv.push_back("-u");
-        argv.push_back("-c");
-        argv.push_back(script.c_str());
+        if (p_.worker_script.empty()) {
+            argv.push_back("-c");
+            argv.push_back(script.c_str());
+        } else {
+            argv.push_back(p_.worker_script.c_str());
+            for (const std::string& a : p_.worker_args) argv.push_back(a.c_str());
+        }
         argv.push_back(nullptr);
 
         // Environment for worker
         ::setenv("EDNA_TTS_MODEL", p_.model_name.c_str(), 1);
-        ::setenv("EDNA_TTS_TMP", p_.tmp_dir.c_str(), 1);
+        ::setenv("EDNA_TTS_SPEAKER", p_.speaker.c_str(), 1);
         ::setenv("EDNA_TTS_CUDA", p_.use_cuda ? "1" : "0", 1);
+        if (p_.use_cuda) ::setenv("CUDA_VISIBLE_DEVICES", cuda_dev.c_str(), 1);
 
         ::execvp(argv[0], const_cast<char* const*>(argv.data()));
         _exit(127);
@@ -171,25 +275,27 @@ for line in sys.stdin:
     if (!worker_handshake_locked()) {
         stop_worker_locked();
         enabled_ = false;
-        if (last_err_.empty()) last_err_ = "TTS worker bad hello";
         return false;
     }
 
     worker_.ready = true;
     enabled_ = true;
-    last_err_.clear();
+    set_error("");
+    std::fprintf(stderr, "[perf] tts_ready engine=%s ready_ms=%.1f rss_mb=%.1f\n",
+                 p_.worker_script.empty() ? "coqui" : p_.worker_script.c_str(),
+                 std::chrono::duration<double, std::milli>(Clock::now() - t0).count(),
+                 (double)rss_kb(pid) / 1024.0);
     return true;
 }
 
 bool CoquiTTS::worker_handshake_locked() {
-    // Wait up to ~10s for READY
     std::string line;
-    if (!read_line_locked(line, 10000)) {
-        last_err_ = "TTS worker handshake timeout";
+    if (!read_line_locked(line, p_.ready_timeout_ms)) {
+        set_error("TTS worker handshake timeout");
         return false;
     }
     if (line != "READY") {
-        last_err_ = "TTS worker bad hello: '" + line + "'";
+        set_error("TTS worker bad hello: '" + line + "'");
         return false;
     }
     return true;
@@ -208,12 +314,19 @@ void CoquiTTS::stop_worker_locked() {
     if (worker_.to_child >= 0) ::close(worker_.to_child);
     if (worker_.from_child >= 0) ::close(worker_.from_child);
 
-    // Reap
+    // Reap. The worker exits on __quit__ or EOF; give it a moment (its
+    // pidfd turns readable when it does), then kill it.
     int status = 0;
     pid_t r = ::waitpid(worker_.pid, &status, WNOHANG);
     if (r == 0) {
-        // Still alive, give it a moment then kill.
-        ::usleep(200 * 1000);
+#ifdef SYS_pidfd_open
+        const int pidfd = (int)::syscall(SYS_pidfd_open, worker_.pid, 0);
+#else
+        const int pidfd = -1;  // Linux < 5.3 headers: sit out the grace period
+#endif
+        (void)wait_readable_locked(pidfd, Clock::now() + std::chrono::milliseconds(200),
+                                   /*interruptible=*/false);
+        if (pidfd >= 0) ::close(pidfd);
         r = ::waitpid(worker_.pid, &status, WNOHANG);
         if (r == 0) {
             ::kill(worker_.pid, SIGKILL);
@@ -238,146 +351,453 @@ bool CoquiTTS::write_all_locked(const char* data, size_t n) {
     return true;
 }
 
-bool CoquiTTS::read_line_locked(std::string& out_line, int timeout_ms) {
-    out_line.clear();
-    if (worker_.from_child < 0) return false;
+// Wait on io_ until fd is readable (true) or the absolute deadline passes.
+// fd < 0 waits out the deadline. interruptible: also give up once
+// stop_pipeline() has stopped io_.
+bool CoquiTTS::wait_readable_locked(int fd, Clock::time_point deadline, bool interruptible) {
+    if (Clock::now() >= deadline) return false;
 
-    std::string buf;
-    buf.reserve(256);
+    bool readable = false;
+    if (fd >= 0 && !io_.add(fd, EPOLLIN, [&](uint32_t) { readable = true; })) return false;
+    io_expired_ = false;
+    io_.arm_timer(io_deadline_, deadline);
 
-    const int fd = worker_.from_child;
-    auto deadline_ms = timeout_ms;
+    while (!readable && !io_expired_ && !(interruptible && io_.stopped())) {
+        if (io_.run_once(-1) < 0) break;
+    }
 
-    while (true) {
-        fd_set rfds;
-        FD_ZERO(&rfds);
-        FD_SET(fd, &rfds);
+    io_.disarm_timer(io_deadline_);
+    if (fd >= 0) io_.remove(fd);
+    return readable;
+}
 
-        struct timeval tv;
-        tv.tv_sec = deadline_ms / 1000;
-        tv.tv_usec = (deadline_ms % 1000) * 1000;
+// Pull more bytes from the worker into worker_.rx, waiting until the absolute
+// deadline. Returns false on timeout, EOF, error or pipeline stop.
+bool CoquiTTS::fill_rx_locked(Clock::time_point deadline) {
+    const int fd = worker_.from_child;
+    if (fd < 0) return false;
 
-        int rc = ::select(fd + 1, &rfds, nullptr, nullptr, &tv);
-        if (rc < 0) {
-            if (errno == EINTR) continue;
-            return false;
-        }
-        if (rc == 0) {
-            return false; // timeout
-        }
+    while (true) {
+        if (!wait_readable_locked(fd, deadline, /*interruptible=*/true)) return false;
 
-        char tmp[256];
+        char tmp[16384];
         ssize_t r = ::read(fd, tmp, sizeof(tmp));
         if (r < 0) {
-            if (errno == EINTR) continue;
+            if (errno == EINTR || errno == EAGAIN) continue;
             return false;
         }
         if (r == 0) return false; // EOF
 
-        buf.append(tmp, tmp + r);
+        worker_.rx.append(tmp, tmp + r);
+        return true;
+    }
+}
+
+bool CoquiTTS::read_line_locked(std::string& out_line, int timeout_ms) {
+    out_line.clear();
+    const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
 
-        // Look for newline
-        size_t pos = buf.find('\n');
+    while (true) {
+        // Look for newline. Bytes after it stay in rx for the next read.
+        size_t pos = worker_.rx.find('\n');
         if (pos != std::string::npos) {
-            out_line = buf.substr(0, pos);
+            out_line = worker_.rx.substr(0, pos);
+            worker_.rx.erase(0, pos + 1);
             // trim CR
             if (!out_line.empty() && out_line.back() == '\r') out_line.pop_back();
             return true;
         }
+        if (!fill_rx_locked(deadline)) return false;
+    }
+}
 
-        // Keep waiting; subtracting exact elapsed is overkill here.
-        // If you care, measure time properly. Humans rarely do.
-        deadline_ms = timeout_ms;
+bool CoquiTTS::read_exact_locked(std::string& out, size_t n, Clock::time_point deadline) {
+    while (worker_.rx.size() < n) {
+        if (!fill_rx_locked(deadline)) return false;
     }
+    out.assign(worker_.rx, 0, n);
+    worker_.rx.erase(0, n);
+    return true;
 }
 
-bool CoquiTTS::play_wav_locked(const std::string& wav_path) {
-    // Use aplay -D <device> <wav>
-    std::vector<std::string> args;
-    args.push_back(p_.aplay_bin);
-    if (!p_.out_device.empty()) {
-        args.push_back("-D");
-        args.push_back(p_.out_device);
+// Worker -> parent frame: 20-byte little-endian header + payload.
+//   char     magic[4] = "EDNA"
+//   uint32_t kind     (1 = PCM, 2 = END, 3 = ERR)
+//   uint32_t sample_rate
+//   uint16_t channels
+//   uint16_t bits     (16: PCM payload is interleaved s16le)
+//   uint32_t nbytes
+// Must match struct.pack("<4sIIHHI", ...) in the worker script.
+bool CoquiTTS::read_frame_locked(Frame& f, Clock::time_point deadline) {
+    static constexpr size_t kHeader = 20;
+    static constexpr uint32_t kMaxPayload = 64u << 20;
+
+    std::string hdr;
+    if (!read_exact_locked(hdr, kHeader, deadline)) {
+        set_error("TTS worker timeout");
+        return false;
     }
 
-    // Optional extra args (space-separated)
-    if (!p_.aplay_extra_args.empty()) {
-        // naive split, good enough for your own config strings
-        std::string s = p_.aplay_extra_args;
-        std::string cur;
-        for (char c : s) {
-            if (c == ' ') {
-                if (!cur.empty()) { args.push_back(cur); cur.clear(); }
-            } else cur.push_back(c);
-        }
-        if (!cur.empty()) args.push_back(cur);
+    const auto* h = reinterpret_cast<const uint8_t*>(hdr.data());
+    auto u16 = [&](size_t o) { return (uint32_t)h[o] | ((uint32_t)h[o + 1] << 8); };
+    auto u32 = [&](size_t o) { return u16(o) | (u16(o + 2) << 16); };
+
+    if (std::memcmp(h, "EDNA", 4) != 0) {
+        set_error("TTS worker protocol desync");
+        return false;
+    }
+    f.kind        = u32(4);
+    f.sample_rate = u32(8);
+    f.channels    = u16(12);
+    const uint32_t bits   = u16(14);
+    const uint32_t nbytes = u32(16);
+
+    if (nbytes > kMaxPayload || (f.kind == kFramePcm && (bits != 16 || f.channels == 0))) {
+        set_error("TTS worker sent a bad frame");
+        return false;
     }
 
-    args.push_back(wav_path);
+    std::string payload;
+    if (!read_exact_locked(payload, nbytes, deadline)) {
+        set_error("TTS worker timeout");
+        return false;
+    }
+
+    if (f.kind == kFramePcm) {
+        f.pcm.resize(nbytes / 2);
+        std::memcpy(f.pcm.data(), payload.data(), f.pcm.size() * 2);
+        f.text.clear();
+    } else {
+        f.pcm.clear();
+        f.text = std::move(payload);
+    }
+    return true;
+}
 
-    std::vector<char*> argv;
-    argv.reserve(args.size() + 1);
-    for (auto& a : args) argv.push_back(a.data());
-    argv.push_back(nullptr);
+// Runs on the playback thread without m_ held (playback takes seconds).
+bool CoquiTTS::play_pcm(const AudioItem& item) {
+    if (item.channels == 0 || item.pcm.empty()) return true;
 
-    pid_t pid = ::fork();
-    if (pid < 0) {
-        last_err_ = "fork() failed for aplay";
+    if (!out_.write(item.pcm.data(), item.pcm.size() / item.channels,
+                    item.sample_rate, item.channels)) {
+        set_error("playback: " + out_.last_error());
         return false;
     }
-    if (pid == 0) {
-        ::execvp(argv[0], argv.data());
-        _exit(127);
+    return true;
+}
+
+// Send one text line and stream the worker's PCM frames to on_pcm until END.
+// With an engine, synthesize in process instead.
+bool CoquiTTS::synthesize(const std::string& text, const PcmFn& on_pcm) {
+    std::lock_guard<std::mutex> lk(m_);
+
+    if (!enabled_) return false;
+
+    if (engine_) {
+        if (!load_engine_locked()) return false;
+        std::string err;
+        if (!engine_->synthesize(text, on_pcm, err)) {
+            // Per-text failure; the engine itself stays usable.
+            set_error(std::string(engine_->name()) + ": " + err);
+            return false;
+        }
+        return true;
     }
-    int status = 0;
-    if (::waitpid(pid, &status, 0) < 0) {
-        last_err_ = "waitpid() failed for aplay";
+
+    if (worker_.pid <= 0 || !worker_.ready) {
+        if (!start_worker_locked()) return false;
+    }
+
+    // One request per line: embedded newlines would desync the protocol.
+    std::string line = text;
+    std::replace(line.begin(), line.end(), '\n', ' ');
+    std::replace(line.begin(), line.end(), '\r', ' ');
+    line.push_back('\n');
+    if (!write_all_locked(line.c_str(), line.size())) {
+        set_error("Failed writing to TTS worker");
+        enabled_ = false;
+        stop_worker_locked();
         return false;
     }
-    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
-        last_err_ = "aplay failed";
+
+    // The timeout applies per frame: a streaming worker may take longer than
+    // that for a whole item, but should never go quiet for that long.
+    auto deadline = Clock::now() + std::chrono::milliseconds(30000);
+    Frame f;
+    while (true) {
+        if (!read_frame_locked(f, deadline)) {
+            enabled_ = false;
+            stop_worker_locked();
+            return false;
+        }
+        if (f.kind == kFramePcm) {
+            on_pcm(std::move(f.pcm), f.sample_rate, f.channels);
+            deadline = Clock::now() + std::chrono::milliseconds(30000);
+            continue;
+        }
+        if (f.kind == kFrameEnd) return true;
+
+        set_error("TTS worker: ERR " + f.text);
         return false;
     }
-    return true;
 }
 
 bool CoquiTTS::speak(const std::string& text) {
-    std::string wav_path;
+    if (!enqueue(text)) return false;
+    return wait_idle();
+}
+
+bool CoquiTTS::enqueue(const std::string& text) {
+    return enqueue(text, epoch());
+}
+
+bool CoquiTTS::enqueue(const std::string& text, uint64_t epoch) {
+    if (!is_enabled()) return false;
 
     {
-        std::lock_guard<std::mutex> lk(m_);
+        std::lock_guard<std::mutex> lk(pq_m_);
+        if (stopping_) return false;
+        if (epoch != epoch_) return true;   // cancelled since the caller looked
+        text_q_.push_back(TextItem{text, Clock::now(), epoch_});
+        in_flight_++;
+    }
+    pq_cv_.notify_all();
+    return true;
+}
+
+uint64_t CoquiTTS::epoch() const {
+    std::lock_guard<std::mutex> lk(pq_m_);
+    return epoch_;
+}
+
+bool CoquiTTS::wait_idle() {
+    std::unique_lock<std::mutex> lk(pq_m_);
+    pq_cv_.wait(lk, [&]{ return in_flight_ == 0 || stopping_; });
+    const bool ok = pipeline_ok_;
+    pipeline_ok_ = true;
+    return ok;
+}
+
+void CoquiTTS::cancel() {
+    size_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lk(pq_m_);
+        epoch_++;
+        dropped = text_q_.size();
+        in_flight_ -= (int)text_q_.size();
+        text_q_.clear();
+        // Keep end markers: play_loop retires in_flight_ on them.
+        audio_q_.erase(std::remove_if(audio_q_.begin(), audio_q_.end(),
+                                      [](const AudioItem& a) { return !a.last; }),
+                       audio_q_.end());
+    }
+    out_.abort();
+    pq_cv_.notify_all();
+    std::fprintf(stderr, "[tts] cancel: dropped %zu queued chunks\n", dropped);
+}
 
-        if (!enabled_) return false;
+void CoquiTTS::stop_pipeline() {
+    {
+        std::lock_guard<std::mutex> lk(pq_m_);
+        stopping_ = true;
+    }
+    io_.stop();   // a synthesis waiting on the worker gives up now
+    pq_cv_.notify_all();
+    if (synth_thread_.joinable()) synth_thread_.join();
+    if (play_thread_.joinable())  play_thread_.join();
+}
 
-        if (worker_.pid <= 0 || !worker_.ready) {
-            if (!start_worker_locked()) return false;
+// Synthesis runs ahead of playback by up to max_synth_ahead chunks, so the
+// worker is already rendering the next sentence while the current one plays.
+void CoquiTTS::synth_loop() {
+    while (true) {
+        TextItem item;
+        bool urgent = false;
+        {
+            std::unique_lock<std::mutex> lk(pq_m_);
+            pq_cv_.wait(lk, [&]{
+                return stopping_ ||
+                       (!text_q_.empty() && (int)audio_q_.size() < p_.max_synth_ahead);
+            });
+            if (stopping_) break;
+
+            item = std::move(text_q_.front());
+            text_q_.pop_front();
+            // Nothing left to play: the speaker is waiting on this chunk.
+            urgent = audio_q_.empty();
+
+            // After a failure, drop the rest of this burst (like the old
+            // sentence loop did) until wait_idle() collects the result.
+            if (!pipeline_ok_) {
+                in_flight_--;
+                pq_cv_.notify_all();
+                continue;
+            }
         }
 
-        std::string line = text;
-        line.push_back('\n');
-        if (!write_all_locked(line.c_str(), line.size())) {
-            last_err_ = "Failed writing to TTS worker";
-            enabled_ = false;
-            stop_worker_locked();
-            return false;
+        // PCM frames go into the bounded playback queue as they arrive (a
+        // streaming worker may send several per text item; a cache hit is
+        // one). An empty last=true marker closes the item so in_flight_
+        // drops once everything before it has played.
+        //
+        // A GPU lease, when synthesis holds one, is dropped before blocking
+        // on a full playback queue so the GPU isn't held while we just wait,
+        // and taken back before the rest of the item renders.
+        const bool on_gpu = engine_ ? engine_->uses_gpu() : p_.use_cuda;
+        GpuArbiter* gpu = (on_gpu && p_.gpu_arbitrate) ? &GpuArbiter::for_device(p_.cuda_device) : nullptr;
+        GpuArbiter::Lease lease;
+
+        auto push_audio = [&](AudioItem&& a) {
+            std::unique_lock<std::mutex> lk(pq_m_);
+            // Cancelled mid-synthesis: the remaining PCM is unwanted.
+            if (!a.last && a.epoch != epoch_) return;
+            const bool waited = (int)audio_q_.size() >= p_.max_synth_ahead;
+            const bool had_gpu = lease.held();
+            if (waited) lease.release();
+            pq_cv_.wait(lk, [&]{ return stopping_ || (int)audio_q_.size() < p_.max_synth_ahead; });
+            const bool more = !a.last && !stopping_;
+            audio_q_.push_back(std::move(a));
+            lk.unlock();
+            pq_cv_.notify_all();
+            // Playback has audio queued now, so the rest is prefetch.
+            if (waited && more && had_gpu) lease = gpu_lease(gpu, GpuArbiter::Class::TtsPrefetch);
+        };
+
+        // Repeated phrase: play the cached clip, no worker round trip.
+        const std::string key = !cache_.enabled() ? std::string()
+            : engine_ ? PcmCache::make_key(item.text, engine_->model_id(), "")
+                      : PcmCache::make_key(item.text, p_.model_name, p_.speaker);
+        if (cache_.enabled()) {
+            if (auto hit = cache_.get(key)) {
+                AudioItem a;
+                a.pcm = hit->pcm;
+                a.sample_rate = hit->sample_rate;
+                a.channels = hit->channels;
+                a.queued_at = item.queued_at;
+                a.epoch = item.epoch;
+                a.cached = true;
+                push_audio(std::move(a));
+                AudioItem end;
+                end.last = true;
+                end.queued_at = item.queued_at;
+                end.epoch = item.epoch;
+                push_audio(std::move(end));
+                continue;
+            }
         }
 
-        std::string resp;
-        if (!read_line_locked(resp, 30000)) {
-            last_err_ = "TTS worker timeout";
-            enabled_ = false;
-            stop_worker_locked();
-            return false;
+        // The GPU lease covers the render.
+        const auto s0 = Clock::now();
+        lease = gpu_lease(gpu, urgent ? GpuArbiter::Class::LlmDecode : GpuArbiter::Class::TtsPrefetch);
+
+        // The clip is also collected for the cache (a copy; synthesis costs
+        // orders of magnitude more).
+        PcmCache::Entry clip;
+        bool cacheable = cache_.enabled();
+
+        const bool ok = synthesize(item.text, [&](std::vector<int16_t>&& pcm, unsigned rate, unsigned ch) {
+            // Nothing to play (e.g. punctuation-only text); only the end
+            // marker below may close the item.
+            if (pcm.empty()) return;
+            if (cacheable) {
+                if (clip.channels == 0) {
+                    clip.sample_rate = rate;
+                    clip.channels = ch;
+                }
+                if (clip.sample_rate == rate && clip.channels == ch) {
+                    clip.pcm.insert(clip.pcm.end(), pcm.begin(), pcm.end());
+                } else {
+                    cacheable = false;
+                }
+            }
+            AudioItem a;
+            a.pcm = std::move(pcm);
+            a.sample_rate = rate;
+            a.channels = ch;
+            a.queued_at = item.queued_at;
+            a.epoch = item.epoch;
+            a.synth_ms = std::chrono::duration<double, std::milli>(Clock::now() - s0).count();
+            push_audio(std::move(a));
+        });
+
+        lease.release();
+        if (!ok) {
+            std::lock_guard<std::mutex> lk(pq_m_);
+            pipeline_ok_ = false;
+        } else if (cacheable && !clip.pcm.empty()) {
+            cache_.put(key, std::move(clip));
         }
+        AudioItem end;
+        end.last = true;
+        end.queued_at = item.queued_at;
+        end.epoch = item.epoch;
+        push_audio(std::move(end));
+    }
+}
 
-        if (resp.rfind("ERR", 0) == 0) {
-            last_err_ = "TTS worker: " + resp;
-            return false;
+void CoquiTTS::play_loop() {
+    while (true) {
+        AudioItem item;
+        bool stale = false;
+        {
+            std::unique_lock<std::mutex> lk(pq_m_);
+            pq_cv_.wait(lk, [&]{ return stopping_ || !audio_q_.empty(); });
+            if (stopping_) break;
+
+            item = std::move(audio_q_.front());
+            audio_q_.pop_front();
+            stale = item.epoch != epoch_;
+        }
+        // A slot opened up: let the synth thread render the next chunk.
+        pq_cv_.notify_all();
+
+        if (item.last) {
+            // End-of-item marker: drain if nothing else is coming.
+            bool idle;
+            {
+                std::lock_guard<std::mutex> lk(pq_m_);
+                idle = in_flight_ <= 1 && audio_q_.empty();
+            }
+            if (idle && !stale) {
+                out_.drain();
+                last_play_end_ = Clock::now();
+            }
+            {
+                std::lock_guard<std::mutex> lk(pq_m_);
+                in_flight_--;
+            }
+            pq_cv_.notify_all();
+            continue;
         }
 
-        wav_path = std::move(resp);
-    } // unlock before playing audio
+        if (stale) continue;
 
-    // Playback can take seconds. Do not hold the mutex for it.
-    return play_wav_locked(wav_path);  // make this non-locked version
+        const auto p0 = Clock::now();
+        const int seq = ++chunk_seq_;
+
+        // Gap = playback silence between consecutive chunks of one burst.
+        // A chunk queued after the previous one finished starts a new burst;
+        // for those, report first-audio latency (queue -> playback) instead.
+        const bool continues_burst = item.queued_at < last_play_end_;
+        const double wait_ms = std::chrono::duration<double, std::milli>(
+            p0 - (continues_burst ? last_play_end_ : item.queued_at)).count();
+
+        const bool ok = play_pcm(item);
+
+        last_play_end_ = Clock::now();
+        const double play_ms = std::chrono::duration<double, std::milli>(last_play_end_ - p0).count();
+
+        const AlsaPlayback::Stats ps = out_.stats();
+        std::fprintf(stderr, "[perf] tts_chunk=%d cached=%d synth_ms=%.1f play_ms=%.1f %s=%.1f underruns=%llu ok=%d\n",
+                     seq, item.cached ? 1 : 0, item.synth_ms, play_ms,
+                     continues_burst ? "gap_ms" : "first_audio_ms", wait_ms,
+                     (unsigned long long)ps.underruns, ok ? 1 : 0);
+        std::fflush(stderr);
+
+        {
+            std::lock_guard<std::mutex> lk(pq_m_);
+            if (!ok) pipeline_ok_ = false;
+        }
+        pq_cv_.notify_all();
+    }
 }
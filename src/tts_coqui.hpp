@@ -1,36 +1,89 @@
 // tts_coqui.hpp
 #pragma once
 
+#include "audio_out.hpp"
+#include "pcm_cache.hpp"
+#include "pipeline.hpp"
+#include "reactor.hpp"
+#include "tts_engine.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <string>
 #include <mutex>
-
+#include <thread>
+#include <vector>
+
+/*
+ * CoquiTTS
+ *
+ * TTS pipeline: text queue -> synth thread -> bounded PCM queue -> ALSA
+ * playback, with the PCM cache and barge-in cancel around it. Synthesis
+ * runs in a Coqui TTS Python worker by default; passing a TtsEngine
+ * (e.g. PiperTTS) runs it in process instead and no worker is started.
+ */
 class CoquiTTS {
 public:
     struct Params {
-        // Playback device (aplay -D <device>)
+        // ALSA playback device (kept open for the life of the process)
         std::string out_device = "default";
 
+        // Playback buffering (see AlsaPlayback::Params). sample_rate is only
+        // the initial guess; the device follows the worker's WAV rate.
+        unsigned sample_rate = 22050;
+        unsigned period_us   = 20000;
+        unsigned buffer_us   = 120000;
+
         // Python executable to run the worker (e.g. "python3")
         std::string python_bin = "python3";
 
+        // External worker script speaking the same frame protocol (e.g.
+        // tools/xtts_worker.py) and its arguments; "" = the embedded Coqui
+        // script. Model load can take much longer than for VITS, hence the
+        // separate READY timeout.
+        std::string worker_script;
+        std::vector<std::string> worker_args;
+        int ready_timeout_ms = 10000;
+
         // Coqui TTS model name
         // Example: "tts_models/en/ljspeech/vits"
         std::string model_name = "tts_models/en/ljspeech/vits";
 
+        // Speaker for multi-speaker models ("" = model default). Exported to
+        // the worker as EDNA_TTS_SPEAKER; for XTTS a reference wav or a
+        // built-in speaker name.
+        std::string speaker;
+
         // Try to use CUDA in the worker (best effort)
         bool use_cuda = false;
+        int  cuda_device = 0;         // exported to the worker as CUDA_VISIBLE_DEVICES
+        bool gpu_arbitrate = true;    // hold a GpuArbiter lease while a chunk renders
 
-        // Directory for temporary wav files
-        std::string tmp_dir = "/tmp";
 
-        // aplay binary (or "paplay" if you swap implementation)
-        std::string aplay_bin = "aplay";
+        // Pipelining: how many synthesized chunks may wait for playback.
+        // The worker renders chunk N+1 while chunk N plays; this bounds how
+        // far ahead it runs.
+        int max_synth_ahead = 2;
 
-        // Extra aplay args (optional)
-        std::string aplay_extra_args = "";
+        // Synthesized-audio cache: repeated phrases skip the worker and go
+        // straight to playback. 0 bytes disables it; cache_dir keeps it
+        // across restarts.
+        size_t cache_bytes = 8u << 20;
+        std::string cache_dir;
+
+        // Thread placement for the two pipeline threads. The worker process
+        // is forked from the synth thread and inherits its CPU mask.
+        StageConfig synth_stage{"tts-synth", {}, 0, 0};
+        StageConfig play_stage{"tts-play", {}, 0, 0};
     };
 
-    explicit CoquiTTS(const Params& p);
+    // engine == nullptr: synthesize in the Python worker.
+    explicit CoquiTTS(const Params& p, std::unique_ptr<TtsEngine> engine = nullptr);
     ~CoquiTTS();
 
     bool is_enabled() const;
@@ -39,9 +92,49 @@ public:
     // Synthesize and play. Returns true if it *played* audio.
     bool speak(const std::string& text);
 
-    // Optional: explicitly (re)start the worker.
+    // Pipelined path: queue a chunk for synthesis + playback and return
+    // immediately. Chunks play in order, back to back.
+    bool enqueue(const std::string& text);
+    // As enqueue(), unless cancel() ran since epoch() returned `epoch`: then
+    // the chunk is dropped (true, as if cancel() had dropped it). Checked
+    // under the queue lock, so no cancel() can fall between check and push.
+    bool enqueue(const std::string& text, uint64_t epoch);
+    uint64_t epoch() const;
+
+    // Block until everything queued so far has played. Returns false if any
+    // chunk since the previous wait_idle() failed.
+    bool wait_idle();
+
+    // Barge-in: drop everything queued, cut off the chunk that is playing,
+    // and discard the rest of the chunk being synthesized. wait_idle()
+    // returns once the synth thread is done with its current item.
+    void cancel();
+
+    // Playback device counters (frames written, underruns, reconfigs).
+    AlsaPlayback::Stats playback_stats() const { return out_.stats(); }
+
+    // PCM cache counters (hits, misses, bytes resident).
+    PcmCache::Stats cache_stats() const { return cache_.stats(); }
+
+    // Everything played is also handed to tap (echo canceller reference).
+    // Install once, before the first enqueue().
+    void set_playback_tap(AlsaPlayback::TapFn tap) { out_.set_tap(std::move(tap)); }
+
+    // Output volume, 0..100 percent. Applied as a squared gain so equal
+    // steps sound roughly equal. Cached PCM is stored at full scale.
+    void set_volume(int percent) {
+        const float v = percent < 0 ? 0.0f : (percent > 100 ? 1.0f : percent / 100.0f);
+        out_.set_gain(v * v);
+    }
+
+    // Optional: explicitly (re)start the worker (or load the engine).
     bool ensure_worker();
 
+    // Startup warm-up: ensure_worker(), then synthesize text once and throw
+    // the audio away (not played, not cached), so model load and kernel
+    // compilation are done before the first reply.
+    bool warmup(const std::string& text = "Edna is online.");
+
     // Optional: stop worker now.
     void shutdown();
 
@@ -51,6 +144,22 @@ private:
         int   from_child = -1;   // child -> parent (stdout)
         pid_t pid        = -1;
         bool  ready      = false;
+        std::string rx;          // bytes read from the child but not consumed yet
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    // Binary frame from the worker (see read_frame_locked).
+    static constexpr uint32_t kFramePcm = 1;
+    static constexpr uint32_t kFrameEnd = 2;
+    static constexpr uint32_t kFrameErr = 3;
+
+    struct Frame {
+        uint32_t kind = 0;
+        unsigned sample_rate = 0;
+        unsigned channels = 0;
+        std::vector<int16_t> pcm;   // kind == PCM
+        std::string text;           // kind == ERR
     };
 
     bool start_worker_locked();
@@ -58,13 +167,69 @@ private:
     bool worker_handshake_locked();
     bool write_all_locked(const char* data, size_t n);
     bool read_line_locked(std::string& out_line, int timeout_ms);
+    bool wait_readable_locked(int fd, Clock::time_point deadline, bool interruptible);
+    bool fill_rx_locked(Clock::time_point deadline);
+    bool read_exact_locked(std::string& out, size_t n, Clock::time_point deadline);
+    bool read_frame_locked(Frame& f, Clock::time_point deadline);
+
+    struct TextItem {
+        std::string text;
+        Clock::time_point queued_at;
+        uint64_t epoch = 0;
+    };
 
-    bool play_wav_locked(const std::string& wav_path);
+    // Raw PCM straight from the worker pipe; no temp files, no WAV parsing.
+    struct AudioItem {
+        std::vector<int16_t> pcm;   // interleaved s16
+        unsigned sample_rate = 0;
+        unsigned channels = 0;
+        bool last = false;          // empty end-of-item marker
+        Clock::time_point queued_at;
+        double synth_ms = 0.0;      // text queued -> this frame received
+        bool cached = false;        // served from cache_, no synthesis
+        uint64_t epoch = 0;         // stale after cancel()
+    };
+
+    using PcmFn = TtsEngine::PcmFn;
+    bool load_engine_locked();
+    bool synthesize(const std::string& text, const PcmFn& on_pcm);
+    bool play_pcm(const AudioItem& item);
+    void set_error(const std::string& err);
+    void synth_loop();
+    void play_loop();
+    void stop_pipeline();
 
     Params p_;
+    AlsaPlayback out_;
+    PcmCache cache_;
+    // m_ guards the worker and is held for a whole synthesis round trip.
+    // enabled_ / last_err_ are readable without it so the brain thread never
+    // stalls behind the worker.
     mutable std::mutex m_;
     Worker worker_;
-    bool enabled_ = true;
+    // Worker I/O waits (pipe, exit via pidfd) against a timerfd deadline;
+    // stop_pipeline() stops it so a blocked read returns at once.
+    Reactor io_;
+    int io_deadline_ = -1;        // timerfd: fires at the current wait's deadline
+    bool io_expired_ = false;
+    std::unique_ptr<TtsEngine> engine_;
+    bool engine_loaded_ = false;
+    std::atomic<bool> enabled_{true};
+    mutable std::mutex err_m_;
     std::string last_err_;
+
+    // Pipeline: text_q_ -> synth thread -> audio_q_ (bounded) -> play thread.
+    mutable std::mutex pq_m_;
+    std::condition_variable pq_cv_;
+    std::deque<TextItem>  text_q_;
+    std::deque<AudioItem> audio_q_;
+    int  in_flight_ = 0;          // queued but not yet played (or failed)
+    bool pipeline_ok_ = true;
+    bool stopping_ = false;
+    int  chunk_seq_ = 0;
+    uint64_t epoch_ = 0;          // bumped by cancel(); older items are dropped
+    Clock::time_point last_play_end_{};
+    std::thread synth_thread_;
+    std::thread play_thread_;
 };
 
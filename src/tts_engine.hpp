@@ -0,0 +1,43 @@
+// tts_engine.hpp
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * TtsEngine
+ *
+ * In-process speech synthesis backend. CoquiTTS owns the pipeline around
+ * it (queueing, PCM cache, cancel, playback) and by default synthesizes in
+ * its Python worker; handing it a TtsEngine replaces the worker with a
+ * native model that produces PCM buffers directly, without a Python +
+ * PyTorch runtime alongside edna.
+ *
+ * load() and synthesize() are called from CoquiTTS's synth thread only.
+ */
+class TtsEngine {
+public:
+    using PcmFn = std::function<void(std::vector<int16_t>&& pcm, unsigned sample_rate, unsigned channels)>;
+
+    virtual ~TtsEngine() = default;
+
+    // Short backend name for logs ("piper").
+    virtual const char* name() const = 0;
+
+    // Identifies model + voice; part of the PCM cache key.
+    virtual std::string model_id() const = 0;
+
+    // Heavy initialization (model load). Called once before the first
+    // synthesize(); false + err if the engine cannot run.
+    virtual bool load(std::string& err) = 0;
+
+    // Synthesize text, calling on_pcm as soon as each piece is ready (an
+    // engine may split the text and hand over a buffer per sentence).
+    virtual bool synthesize(const std::string& text, const PcmFn& on_pcm, std::string& err) = 0;
+
+    // True if synthesis runs on the GPU (CoquiTTS then takes GpuArbiter
+    // leases around it).
+    virtual bool uses_gpu() const { return false; }
+};
@@ -0,0 +1,161 @@
+// wav_io.cpp
+#include "wav_io.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+static uint32_t rd_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t rd_u16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void wr_u32(unsigned char* p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void wr_u16(unsigned char* p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+bool read_wav(const std::string& path, WavData& out, std::string& err) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        err = "cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    unsigned char hdr[12];
+    if (std::fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) ||
+        std::memcmp(hdr, "RIFF", 4) != 0 || std::memcmp(hdr + 8, "WAVE", 4) != 0) {
+        std::fclose(f);
+        err = path + ": not a RIFF/WAVE file";
+        return false;
+    }
+
+    bool have_fmt = false;
+    out = WavData{};
+    unsigned char ch[8];
+    while (std::fread(ch, 1, sizeof(ch), f) == sizeof(ch)) {
+        const uint32_t size = rd_u32(ch + 4);
+        if (std::memcmp(ch, "fmt ", 4) == 0) {
+            unsigned char fmt[16];
+            if (size < sizeof(fmt) || std::fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt)) break;
+            const uint16_t format = rd_u16(fmt);
+            const uint16_t bits = rd_u16(fmt + 14);
+            // 1 = PCM, 0xFFFE = WAVE_FORMAT_EXTENSIBLE (assume PCM subformat)
+            if ((format != 1 && format != 0xFFFE) || bits != 16) {
+                std::fclose(f);
+                err = path + ": only 16-bit PCM is supported";
+                return false;
+            }
+            out.channels = rd_u16(fmt + 2);
+            out.sample_rate = rd_u32(fmt + 4);
+            have_fmt = true;
+            std::fseek(f, (long)(size - sizeof(fmt) + (size & 1)), SEEK_CUR);
+        } else if (std::memcmp(ch, "data", 4) == 0) {
+            if (!have_fmt || out.channels == 0) break;
+            out.pcm.resize(size / sizeof(int16_t));
+            const size_t got = std::fread(out.pcm.data(), sizeof(int16_t), out.pcm.size(), f);
+            out.pcm.resize(got - got % out.channels);   // tolerate truncated files
+            std::fclose(f);
+            return true;
+        } else {
+            std::fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+
+    std::fclose(f);
+    err = path + ": missing fmt or data chunk";
+    return false;
+}
+
+std::vector<int16_t> wav_to_mono(const WavData& in, unsigned rate) {
+    const size_t n = in.frames();
+    std::vector<float> mono(n);
+    for (size_t i = 0; i < n; i++) {
+        int acc = 0;
+        for (unsigned c = 0; c < in.channels; c++) acc += in.pcm[i * in.channels + c];
+        mono[i] = (float)acc / (float)in.channels;
+    }
+
+    if (in.sample_rate == rate || n == 0) {
+        std::vector<int16_t> out(n);
+        for (size_t i = 0; i < n; i++) out[i] = (int16_t)mono[i];
+        return out;
+    }
+
+    const double step = (double)in.sample_rate / (double)rate;
+    const size_t m = (size_t)((double)n / step);
+    std::vector<int16_t> out(m);
+    for (size_t i = 0; i < m; i++) {
+        const double x = (double)i * step;
+        const size_t j = (size_t)x;
+        const double a = x - (double)j;
+        const float s0 = mono[j];
+        const float s1 = mono[std::min(j + 1, n - 1)];
+        const double v = (1.0 - a) * s0 + a * s1;
+        out[i] = (int16_t)std::max(-32768.0, std::min(32767.0, v));
+    }
+    return out;
+}
+
+bool WavWriter::open(const std::string& path, unsigned sample_rate, unsigned channels) {
+    close();
+    f_ = std::fopen(path.c_str(), "wb");
+    if (!f_) return false;
+    rate_ = sample_rate;
+    channels_ = channels;
+    data_bytes_ = 0;
+    write_header();
+    return true;
+}
+
+void WavWriter::write_header() {
+    unsigned char h[44];
+    const uint32_t data = (uint32_t)std::min<uint64_t>(data_bytes_, 0xFFFFFFFFu - 36);
+    std::memcpy(h, "RIFF", 4);
+    wr_u32(h + 4, 36 + data);
+    std::memcpy(h + 8, "WAVEfmt ", 8);
+    wr_u32(h + 16, 16);
+    wr_u16(h + 20, 1);
+    wr_u16(h + 22, (uint16_t)channels_);
+    wr_u32(h + 24, rate_);
+    wr_u32(h + 28, rate_ * channels_ * 2);
+    wr_u16(h + 32, (uint16_t)(channels_ * 2));
+    wr_u16(h + 34, 16);
+    std::memcpy(h + 36, "data", 4);
+    wr_u32(h + 40, data);
+
+    std::fseek(f_, 0, SEEK_SET);
+    std::fwrite(h, 1, sizeof(h), f_);
+    std::fseek(f_, 0, SEEK_END);
+}
+
+bool WavWriter::write(const int16_t* pcm, size_t frames) {
+    if (!f_) return false;
+    const size_t n = frames * channels_;
+    if (std::fwrite(pcm, sizeof(int16_t), n, f_) != n) return false;
+    data_bytes_ += n * sizeof(int16_t);
+    return true;
+}
+
+void WavWriter::flush() {
+    if (!f_) return;
+    write_header();
+    std::fflush(f_);
+}
+
+void WavWriter::close() {
+    if (!f_) return;
+    write_header();
+    std::fclose(f_);
+    f_ = nullptr;
+}
@@ -0,0 +1,63 @@
+// wav_io.hpp
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Minimal RIFF/WAVE support for offline work (benchmark corpora, recorded
+ * TTS output). Only uncompressed 16-bit PCM is read or written; that is all
+ * the pipeline ever produces or consumes.
+ */
+
+struct WavData {
+    unsigned sample_rate = 0;
+    unsigned channels = 0;
+    std::vector<int16_t> pcm;    // interleaved
+
+    size_t frames() const { return channels ? pcm.size() / channels : 0; }
+    double seconds() const { return sample_rate ? (double)frames() / sample_rate : 0.0; }
+};
+
+// Read a 16-bit PCM WAV file. On failure returns false and sets err.
+bool read_wav(const std::string& path, WavData& out, std::string& err);
+
+// Downmix to mono and resample (linear) to rate. The ASR side wants 16 kHz
+// mono; corpora recorded at 44.1/48 kHz are converted on load.
+std::vector<int16_t> wav_to_mono(const WavData& in, unsigned rate);
+
+/*
+ * WavWriter
+ *
+ * Streams 16-bit PCM to a WAV file. The header sizes are patched on flush()
+ * and close(), so the file is valid after every flush even if the process
+ * dies later.
+ */
+class WavWriter {
+public:
+    WavWriter() = default;
+    ~WavWriter() { close(); }
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    bool open(const std::string& path, unsigned sample_rate, unsigned channels);
+    bool write(const int16_t* pcm, size_t frames);
+    void flush();
+    void close();
+
+    bool is_open() const { return f_ != nullptr; }
+    unsigned sample_rate() const { return rate_; }
+    unsigned channels() const { return channels_; }
+
+private:
+    void write_header();
+
+    std::FILE* f_ = nullptr;
+    unsigned rate_ = 0;
+    unsigned channels_ = 0;
+    uint64_t data_bytes_ = 0;
+};
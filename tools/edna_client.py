@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Room client for edna_server.
+
+Streams 16 kHz mono microphone audio (arecord) to the server and prints
+what comes back; with --play the reply speech goes to aplay. Framing is
+described in src/net_frame.hpp.
+
+    tools/edna_client.py --host gpu-box                 # live microphone
+    tools/edna_client.py --wav turn.wav                 # replay a recording, then exit
+    tools/edna_client.py --text "what time is it"       # typed command, no ASR
+"""
+import argparse
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+import wave
+
+KIND_PCM, KIND_END, KIND_ERR, KIND_TEXT, KIND_HEARD = 1, 2, 3, 4, 5
+HEADER = struct.Struct("<4sIIHHI")
+RATE = 16000
+CHUNK = 640  # 20 ms of s16 mono
+
+
+def send(sock, kind, payload=b"", rate=0, channels=0):
+    sock.sendall(HEADER.pack(b"EDNA", kind, rate, channels, 16, len(payload)) + payload)
+
+
+def recv_exact(sock, n):
+    buf = b""
+    while len(buf) < n:
+        chunk = sock.recv(n - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return buf
+
+
+def reader(sock, play, done, replies):
+    """Print server frames until the connection closes."""
+    player = None
+    while True:
+        h = recv_exact(sock, HEADER.size)
+        if h is None:
+            break
+        magic, kind, rate, channels, bits, n = HEADER.unpack(h)
+        if magic != b"EDNA":
+            print("[client] protocol desync", file=sys.stderr)
+            break
+        payload = recv_exact(sock, n) if n else b""
+        if payload is None:
+            break
+        if kind == KIND_HEARD:
+            print("heard: " + payload.decode("utf-8", "replace"), flush=True)
+        elif kind == KIND_TEXT:
+            print("edna:  " + payload.decode("utf-8", "replace"), flush=True)
+        elif kind == KIND_PCM and play:
+            if player is None:
+                player = subprocess.Popen(["aplay", "-q", "-t", "raw", "-f", "S16_LE", "-r", str(rate),
+                                           "-c", str(channels)], stdin=subprocess.PIPE)
+            player.stdin.write(payload)
+            player.stdin.flush()
+        elif kind == KIND_END:
+            replies.release()
+        elif kind == KIND_ERR:
+            print("[client] server: " + payload.decode("utf-8", "replace"), file=sys.stderr, flush=True)
+    done.set()
+    replies.release()
+
+
+def stream_wav(sock, path, realtime):
+    with wave.open(path, "rb") as w:
+        if w.getframerate() != RATE or w.getnchannels() != 1 or w.getsampwidth() != 2:
+            sys.exit("[client] %s: need 16 kHz mono 16-bit" % path)
+        pcm = w.readframes(w.getnframes())
+    # Trailing silence so the server's endpointer closes the utterance.
+    pcm += b"\0" * (RATE * 2)
+    for off in range(0, len(pcm), CHUNK):
+        send(sock, KIND_PCM, pcm[off:off + CHUNK], RATE, 1)
+        if realtime:
+            time.sleep(0.02)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=7700)
+    ap.add_argument("--device", default="default", help="arecord capture device")
+    ap.add_argument("--play", action="store_true", help="play reply speech with aplay (server --tts)")
+    ap.add_argument("--wav", action="append", default=[], help="replay a 16 kHz mono WAV (repeatable)")
+    ap.add_argument("--text", action="append", default=[], help="send a typed command (repeatable)")
+    ap.add_argument("--fast", action="store_true", help="--wav: send as fast as possible, not at 1x")
+    args = ap.parse_args()
+
+    sock = socket.create_connection((args.host, args.port))
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    done = threading.Event()
+    replies = threading.Semaphore(0)
+    threading.Thread(target=reader, args=(sock, args.play, done, replies), daemon=True).start()
+
+    try:
+        if args.text or args.wav:
+            # One turn at a time: wait for each reply's END before the next.
+            for t in args.text:
+                send(sock, KIND_TEXT, t.encode("utf-8"))
+                replies.acquire()
+            for path in args.wav:
+                stream_wav(sock, path, not args.fast)
+                replies.acquire()
+            send(sock, KIND_END)
+        else:
+            mic = subprocess.Popen(["arecord", "-q", "-D", args.device, "-t", "raw", "-f", "S16_LE",
+                                    "-r", str(RATE), "-c", "1"], stdout=subprocess.PIPE)
+            while not done.is_set():
+                chunk = mic.stdout.read(CHUNK)
+                if not chunk:
+                    break
+                send(sock, KIND_PCM, chunk, RATE, 1)
+            send(sock, KIND_END)
+    except (BrokenPipeError, ConnectionResetError, KeyboardInterrupt):
+        pass
+    done.wait(5.0)
+    sock.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -1,27 +1,126 @@
 #!/usr/bin/env python3
+"""Long-lived XTTS v2 worker for CoquiTTS (CoquiTTS::Params::worker_script).
+
+Speaks the same protocol as the worker script embedded in tts_coqui.cpp:
+prints "READY" once the model is loaded, then answers each text line on
+stdin with binary frames on stdout (one or more PCM frames, then END; or a
+single ERR frame). "__quit__" exits.
+
+The model and the speaker conditioning (GPT latents + speaker embedding)
+are computed once at startup. Each line is rendered with XTTS's streaming
+inference, so PCM chunks go back while the rest of the sentence is still
+being generated.
+
+Standalone test:
+    echo "Edna is online." | tools/xtts_worker.py --speaker me.wav > /dev/null
+"""
 import argparse
+import os
+import struct
 import sys
+import warnings
+
+warnings.filterwarnings("ignore")
+
+# Keep a private handle on the protocol pipe and point fd 1 at stderr, so
+# library chatter on stdout can't corrupt the binary stream.
+proto = os.fdopen(os.dup(1), "wb")
+os.dup2(2, 1)
+sys.stdout = sys.stderr
+
+KIND_PCM, KIND_END, KIND_ERR = 1, 2, 3
+
+
+def send(kind, payload=b"", rate=0, channels=0):
+    # Must match read_frame_locked() in tts_coqui.cpp.
+    proto.write(struct.pack("<4sIIHHI", b"EDNA", kind, rate, channels, 16, len(payload)))
+    proto.write(payload)
+    proto.flush()
+
+
+def log(msg):
+    print("[xtts] " + msg, file=sys.stderr, flush=True)
+
+
+def conditioning(model, speaker, cache_path):
+    """(gpt_cond_latent, speaker_embedding) for a reference wav or a built-in speaker name."""
+    import torch
+
+    if cache_path and os.path.exists(cache_path):
+        c = torch.load(cache_path, map_location=model.device)
+        if c.get("speaker") == speaker:
+            log("speaker latents from " + cache_path)
+            return c["gpt_cond_latent"], c["speaker_embedding"]
+
+    if speaker and os.path.isfile(speaker):
+        latent, emb = model.get_conditioning_latents(audio_path=[speaker])
+    else:
+        speakers = getattr(getattr(model, "speaker_manager", None), "speakers", None) or {}
+        if not speakers:
+            raise RuntimeError("no --speaker wav and the model has no built-in speakers")
+        name = speaker or next(iter(speakers))
+        if name not in speakers:
+            raise RuntimeError("unknown speaker '%s' (not a file or built-in name)" % name)
+        latent = speakers[name]["gpt_cond_latent"]
+        emb = speakers[name]["speaker_embedding"]
+
+    if cache_path:
+        torch.save({"speaker": speaker, "gpt_cond_latent": latent,
+                    "speaker_embedding": emb}, cache_path)
+    return latent, emb
+
 
 def main():
     ap = argparse.ArgumentParser()
-    ap.add_argument("--text", required=True)
-    ap.add_argument("--out", required=True)
+    ap.add_argument("--model", default="tts_models/multilingual/multi-dataset/xtts_v2")
     ap.add_argument("--lang", default="en")
-    ap.add_argument("--speaker", default="")
+    ap.add_argument("--speaker", default=os.environ.get("EDNA_TTS_SPEAKER", ""),
+                    help="reference wav or built-in speaker name (default: $EDNA_TTS_SPEAKER)")
+    ap.add_argument("--latents-cache", default="",
+                    help="keep the speaker conditioning here across restarts")
+    ap.add_argument("--chunk-size", type=int, default=20,
+                    help="GPT tokens per streamed chunk (smaller = earlier first audio)")
+    ap.add_argument("--cpu", action="store_true")
     args = ap.parse_args()
 
-    # Lazy import so you get a clean error if not installed
+    import numpy as np
+    import torch
     from TTS.api import TTS
 
-    # Load model (yes, this is heavy per call; we’ll optimize after it works)
-    tts = TTS("tts_models/multilingual/multi-dataset/xtts_v2", gpu=True)
+    use_cuda = not args.cpu and os.environ.get("EDNA_TTS_CUDA", "1") == "1" and torch.cuda.is_available()
+    model = TTS(args.model).to("cuda" if use_cuda else "cpu").synthesizer.tts_model
+    if not hasattr(model, "inference_stream"):
+        raise SystemExit("%s has no streaming inference (not an XTTS model?)" % args.model)
+    rate = int(model.config.audio.output_sample_rate)
+
+    latent, emb = conditioning(model, args.speaker, args.latents_cache)
+    log("model=%s lang=%s speaker=%s rate=%d cuda=%d"
+        % (args.model, args.lang, args.speaker or "(default)", rate, int(use_cuda)))
+
+    proto.write(b"READY\n")
+    proto.flush()
 
-    kwargs = dict(text=args.text, file_path=args.out, language=args.lang)
-    if args.speaker:
-        kwargs["speaker_wav"] = args.speaker
+    for line in sys.stdin:
+        line = line.strip()
+        if not line:
+            send(KIND_ERR, b"empty")
+            continue
+        if line == "__quit__":
+            break
+
+        try:
+            with torch.inference_mode():
+                for chunk in model.inference_stream(line, args.lang, latent, emb,
+                                                    stream_chunk_size=args.chunk_size,
+                                                    enable_text_splitting=True):
+                    wav = chunk.squeeze().float().cpu().numpy()
+                    pcm = (np.clip(wav, -1.0, 1.0) * 32767.0).astype("<i2").tobytes()
+                    if pcm:
+                        send(KIND_PCM, pcm, rate, 1)
+            send(KIND_END)
+        except Exception as e:
+            send(KIND_ERR, str(e).encode("utf-8", "replace"))
 
-    tts.tts_to_file(**kwargs)
 
 if __name__ == "__main__":
     main()
-